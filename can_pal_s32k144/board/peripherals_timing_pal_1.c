@@ -0,0 +1,84 @@
+/***********************************************************************************************************************
+ * This file was generated by the S32 Configuration Tools. Any manual edits made to this file
+ * will be overwritten if the respective S32 Configuration Tools is used to update this file.
+ **********************************************************************************************************************/
+
+/* clang-format off */
+/* TEXT BELOW IS USED AS SETTING FOR TOOLS *************************************
+!!GlobalInfo
+product: Peripherals v14.0
+processor: S32K144
+package_id: S32K144_LQFP100
+mcu_data: s32sdk_s32k1xx_rtm_401
+processor_version: 0.0.0
+functionalGroups:
+- name: BOARD_InitPeripherals
+  UUID: eae3375a-b4e1-467a-9ee1-fd1b1e14d641
+  called_from_default_init: true
+  selectedCore: core0
+ * BE CAREFUL MODIFYING THIS COMMENT - IT IS YAML SETTINGS FOR TOOLS **********/
+/* clang-format on */
+
+/*******************************************************************************
+ * Included files 
+ ******************************************************************************/
+#include "peripherals_timing_pal_1.h"
+
+/*******************************************************************************
+ * timing_pal_1 initialization code
+ ******************************************************************************/
+/* clang-format off */
+/* TEXT BELOW IS USED AS SETTING FOR TOOLS *************************************
+instance:
+- name: 'timing_pal_1'
+- type: 'timing_pal_config'
+- mode: 'general'
+- custom_name_enabled: 'false'
+- type_id: 'timing_pal'
+- functional_group: 'BOARD_InitPeripherals'
+- peripheral: 'LPIT_0'
+- config_sets:
+  - timing_pal:
+    - timingPalConfig:
+      - name: 'timing_pal_1_InitConfig'
+      - readOnly: 'true'
+      - chanConfigArrayName: 'timing_pal_1_channelConfig'
+      - chanConfigArray:
+        - 0:
+          - channel: '0'
+          - chanType: 'TIMER_CHAN_TYPE_CONTINUOUS'
+          - callback: 'PERIODIC_OnTimer'
+          - callbackParam: 'NULL'
+    - quick_selection: 'defaultConfig'
+ * BE CAREFUL MODIFYING THIS COMMENT - IT IS YAML SETTINGS FOR TOOLS **********/
+/* clang-format on */
+
+/**
+ * @page misra_violations MISRA-C:2012 violations
+ *
+ * @section [global]
+ * Violates MISRA 2012 Advisory Rule 8.7, External variable could be made static.
+ * The external variables will be used in other source files in application code.
+ *
+ */
+
+/*! @brief PAL instance information */
+const timing_instance_t timing_pal_1_instance = { TIMING_INST_TYPE_LPIT, 0u };
+
+/*! @brief Channel configuration array */
+const timer_chan_config_t timing_pal_1_channelConfig[1u] = {
+	{
+		.channel       = 0u,
+		.chanType      = TIMER_CHAN_TYPE_CONTINUOUS,
+		.callback      = PERIODIC_OnTimer,
+		.callbackParam = NULL
+	},
+};
+
+/*! @brief configuration structure */
+const timer_config_t timing_pal_1_InitConfig = {
+	.chanConfigArray = timing_pal_1_channelConfig,
+	.numChan         = 1u,
+	.extension       = NULL
+};
+
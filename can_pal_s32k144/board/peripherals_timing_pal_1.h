@@ -0,0 +1,40 @@
+/***********************************************************************************************************************
+ * This file was generated by the S32 Config Tools. Any manual edits made to this file
+ * will be overwritten if the respective S32 Config Tools is used to update this file.
+ **********************************************************************************************************************/
+
+#ifndef timing_pal_1_H
+#define timing_pal_1_H
+
+/**
+ * @page misra_violations MISRA-C:2012 violations
+ *
+ * @section [global]
+ * Violates MISRA 2012 Advisory Rule 2.5, Global macro not referenced.
+ * The global macro will be used in function call of the module.
+ *
+ */
+/*******************************************************************************
+ * Included files 
+ ******************************************************************************/
+#include "timing_pal.h"
+
+/*******************************************************************************
+ * Definitions 
+ ******************************************************************************/
+
+/*! @brief PAL instance information */
+extern const timing_instance_t timing_pal_1_instance;
+
+/*! @brief Channel configuration array */
+extern const timer_chan_config_t timing_pal_1_channelConfig[1u];
+
+/*! @brief configuration structure */
+extern const timer_config_t timing_pal_1_InitConfig;
+
+/*! @brief Channel 0 notification callback */
+extern void PERIODIC_OnTimer(void * userData);
+
+
+
+#endif /* timing_pal_1_H */
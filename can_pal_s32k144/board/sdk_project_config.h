@@ -22,6 +22,7 @@
 #include "peripherals_osif1.h"
 #include "peripherals_adc_config_1.h"
 #include "peripherals_adc_pal_1.h"
+#include "peripherals_timing_pal_1.h"
 
 
 #endif /* SDK_PROJECT_CONFIG_H_ */
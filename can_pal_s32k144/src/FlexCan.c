@@ -1,81 +1,1151 @@
 #include "sdk_project_config.h"
 #include <FlexCan.h>
 #include <stdint.h>
-void FLEXCAN0_init(void) {
+#include "interrupt_manager.h"
+
+#define MB_CODE_RX_EMPTY    0x4UL
+#define MB_CODE_TX_INACTIVE 0x8UL
+#define MB_CODE_TX_DATA     0xCUL
+#define MB_CODE_TX_ABORT    0x9UL
+#define MB_CS_CODE_MASK     (0xFUL << 24)
+#define MB_CS_EDL           (1UL << 31)
+#define MB_CS_BRS           (1UL << 30)
+#define MB_CS_SRR           (1UL << 22)
+#define MB_CS_IDE           (1UL << 21)
+#define MB_ID_STD_SHIFT     18
+#define MB_ID_STD_MASK      0x7FFUL
+#define MB_ID_EXT_MASK      0x1FFFFFFFUL
+#define MB_ID_PRIO_SHIFT    29
+
+#define TX_POOL_MASK        ((1UL << TX_MB_COUNT) - 1UL)
+#define TX_QUEUE_MASK       (TX_QUEUE_SIZE - 1UL)
+
+#if CAN_FD_ENABLE
+#define FD_RX_MB_MASK       (((1UL << FD_RX_MB_COUNT) - 1UL) << FD_RX_MB_INDEX)
+
+#define FD_MBDSR            (CAN_FD_PAYLOAD_SIZE == 8UL ? 0UL : CAN_FD_PAYLOAD_SIZE == 16UL ? 1UL : \
+                             CAN_FD_PAYLOAD_SIZE == 32UL ? 2UL : 3UL)
+
+#define MCR_FD_MODE_BITS    (CAN_MCR_FDEN_MASK | CAN_MCR_IRMQ_MASK | CAN_MCR_LPRIOEN_MASK | \
+                             CAN_MCR_AEN_MASK | CAN_MCR_WRNEN_MASK)
+#endif
+
+#define RX_FIFO_MB          0UL           // Rx FIFO output mailbox
+#define RX_FIFO_RFFN        (RX_FIFO_FILTER_COUNT / 8UL - 1UL)
+#define RX_FIFO_TABLE_WORD  (4UL * 6UL)   // Filter table starts at MB6
+#define RX_FIFO_IMR_COUNT   ((6UL + 2UL * (RX_FIFO_RFFN + 1UL)) < RX_FIFO_FILTER_COUNT ? \
+                             (6UL + 2UL * (RX_FIFO_RFFN + 1UL)) : RX_FIFO_FILTER_COUNT)
+
+#define RX_FIFO_FRAME_AVAILABLE (1UL << 5)
+#define RX_FIFO_WARNING         (1UL << 6)
+#define RX_FIFO_OVERFLOW        (1UL << 7)
+
+// Format A filter element / mask: RTR in bit 31, IDE in bit 30, then the
+// standard ID in bits 29..19 or the extended ID in bits 29..1
+#define RX_FIFO_FILTER_A(id, ext)   ((ext) ? ((1UL << 30) | (((uint32_t)(id) & MB_ID_EXT_MASK) << 1)) \
+                                           : (((uint32_t)(id) & 0x7FFUL) << 19))
+#define RX_FIFO_MASK_A(mask, ext)   ((3UL << 30) | (((ext) ? ((uint32_t)(mask) & MB_ID_EXT_MASK) << 1 \
+                                                           : ((uint32_t)(mask) & 0x7FFUL) << 19)))
+
+#define MCR_FIFO_MODE_BITS  (CAN_MCR_RFEN_MASK | CAN_MCR_IRMQ_MASK | CAN_MCR_LPRIOEN_MASK | \
+                             CAN_MCR_AEN_MASK | CAN_MCR_WRNEN_MASK)
+
+#define RX_FILTER_SLOTS_MAX RX_FIFO_FILTER_COUNT
+#define RX_RING_MASK        (RX_RING_SIZE - 1UL)
+
+#define CTRL1_TIMING_MASK   (CAN_CTRL1_PRESDIV_MASK | CAN_CTRL1_RJW_MASK | CAN_CTRL1_PSEG1_MASK | \
+                             CAN_CTRL1_PSEG2_MASK | CAN_CTRL1_PROPSEG_MASK)
+#define ESR1_RX_ERRORS      (CAN_ESR1_STFERR_MASK | CAN_ESR1_FRMERR_MASK | CAN_ESR1_CRCERR_MASK)
+#define ESR1_INT_FLAGS      (CAN_ESR1_ERRINT_MASK | CAN_ESR1_ERRINT_FAST_MASK | CAN_ESR1_BOFFINT_MASK | \
+                             CAN_ESR1_BOFFDONEINT_MASK | CAN_ESR1_RWRNINT_MASK | CAN_ESR1_TWRNINT_MASK)
+#define CTRL1_ERROR_MASKS   (CAN_CTRL1_ERRMSK_MASK | CAN_CTRL1_BOFFMSK_MASK | \
+                             CAN_CTRL1_TWRNMSK_MASK | CAN_CTRL1_RWRNMSK_MASK)
+
+// IFLAG1 is write-1-to-clear; clearing the Rx FIFO frame-available flag pops the
+// FIFO. Freeze requests in MCR are acknowledged in MCR[FRZACK]. Host tests (test/)
+// supply a register model with the same side effects.
+#ifndef FLEXCAN_IFLAG1_CLEAR
+#define FLEXCAN_IFLAG1_CLEAR(base, mask)  ((base)->IFLAG1 = (mask))
+#endif
+#ifndef FLEXCAN_MCR_WRITE
+#define FLEXCAN_MCR_WRITE(base, value)    ((base)->MCR = (value))
+#endif
+
+#if CAN_CYCLE_STATS
+// DWT cycle counter of the Cortex-M4 core; host tests substitute their own clock
+#ifndef FLEXCAN_CYCLE_COUNT
+#define DWT_CTRL_REG        (*(volatile uint32_t *)0xE0001000UL)
+#define DWT_CYCCNT_REG      (*(volatile uint32_t *)0xE0001004UL)
+#define DEMCR_REG           (*(volatile uint32_t *)0xE000EDFCUL)
+#define FLEXCAN_CYCLE_INIT()  do { DEMCR_REG |= (1UL << 24); DWT_CTRL_REG |= 1UL; } while (0)
+#define FLEXCAN_CYCLE_COUNT() (DWT_CYCCNT_REG)
+#endif
+#endif
+
+// Keeps the compiler from moving ring stores past the index publish
+#define COMPILER_BARRIER()  __asm volatile ("" : : : "memory")
+
+typedef struct {
+    CAN_Message_t msg;
+    uint8_t prio;
+    CAN_TxCallback_t callback;
+    void *context;
+} CAN_TxRequest_t;
+
+struct CAN_Instance {
+    // Fixed per module, set by CAN_INSTANCE_INIT
+    CAN_Type *base;
+    IRQn_Type mbIrq;            // MB0..15; every mailbox the driver uses lives there
+    IRQn_Type busOffIrq;        // Bus off, TX/RX warning, bus-off done
+    IRQn_Type errorIrq;
+    uint8_t pccIndex;
+    uint8_t fd;                 // CAN FD with mailbox RX instead of the Rx FIFO
+    uint8_t maxMb;              // Hardware mailboxes at 8-byte payload (32 or 16)
+    uint8_t mbStride;           // Words per mailbox
+    uint8_t mbCount;            // Mailboxes at the configured payload size, MCR[MAXMB] + 1
+    uint8_t txMbIndex;
+    uint32_t txMbMask;
+    uint32_t filterSlots;
+
+    // Single-producer (RX ISR) / single-consumer (main loop) frame ring.
+    // Indices run freely and are masked on access; each side writes only its own index.
+    CAN_Message_t rxRing[RX_RING_SIZE];
+    volatile uint32_t rxHead;
+    volatile uint32_t rxTail;
+    volatile CAN_RxStats_t rxStats;
+
+    // Frames waiting for a mailbox, and the frame currently owned by each pool mailbox.
+    // Both are only touched with the MB interrupt masked or from the ISR itself.
+    CAN_TxRequest_t txQueue[TX_QUEUE_SIZE];
+    uint32_t txQueueHead;
+    uint32_t txQueueTail;
+    CAN_TxRequest_t txInFlight[TX_MB_COUNT];
+    uint32_t txBusyMask;
+    uint32_t txAbortMask;           // Pool slots with an abort request pending
+    uint32_t txStart[TX_MB_COUNT];  // Time each slot was loaded, for the TX timeout
+
+    // 32-bit extension of the 16-bit TIMER register. The upper half advances whenever
+    // a read sees the counter wrap, so FLEXCAN_get_time() must run at least once per
+    // 65536 bit times (131 ms at 500 kbit/s); the main loop does that.
+    uint32_t timerHigh;
+    uint16_t timerLast;
+    uint32_t nominalBitrate;
+
+    CAN_RxFilter_t activeFilters[RX_FILTER_SLOTS_MAX];
+    uint32_t activeFilterCount;
+
+    // Error state, updated from both error vectors and FLEXCAN_error_tick().
+    // esr1Seen accumulates every ESR1 snapshot since it was last cleared, because
+    // reading ESR1 clears its error bits for everyone else.
+    volatile CAN_ErrorStats_t errStats;
+    volatile uint32_t esr1Seen;
+    volatile uint8_t busOffPending;     // Set by the ISR, consumed by the tick
+    CAN_BusOffPolicy_t busOffPolicy;
+    uint32_t busOffDelayMs;
+    uint32_t busOffStart;
+    uint8_t busOffWaiting;
+
+#if CAN_CYCLE_STATS
+    volatile CAN_CycleStats_t cycleStats;
+#endif
+};
+
+// Mailbox layout: FD instances keep FD_RX_MB_COUNT RX mailboxes in front of the
+// TX pool; classic instances put the pool behind the Rx FIFO and its filter table.
+#define CAN_INSTANCE_INIT(n, isFd) {                                                \
+    .base = CAN##n,                                                                 \
+    .mbIrq = CAN##n##_ORed_0_15_MB_IRQn,                                            \
+    .busOffIrq = CAN##n##_ORed_IRQn,                                                \
+    .errorIrq = CAN##n##_Error_IRQn,                                                \
+    .pccIndex = PCC_FlexCAN##n##_INDEX,                                             \
+    .fd = (isFd),                                                                   \
+    .maxMb = FEATURE_CAN##n##_MAX_MB_NUM,                                           \
+    .mbStride = (isFd) ? MSG_BUF_SIZE : CLASSIC_MSG_BUF_SIZE,                       \
+    .mbCount = (isFd) ? MB_COUNT : FEATURE_CAN##n##_MAX_MB_NUM,                     \
+    .txMbIndex = (isFd) ? FD_TX_MB_INDEX : RX_FIFO_TX_MB_INDEX,                     \
+    .txMbMask = TX_POOL_MASK << ((isFd) ? FD_TX_MB_INDEX : RX_FIFO_TX_MB_INDEX),    \
+    .filterSlots = (isFd) ? FD_RX_MB_COUNT : RX_FIFO_FILTER_COUNT,                  \
+}
+
+CAN_Instance_t can0Instance = CAN_INSTANCE_INIT(0, CAN_FD_ENABLE);
+#if CAN1_ENABLE
+CAN_Instance_t can1Instance = CAN_INSTANCE_INIT(1, 0);
+#endif
+#if CAN2_ENABLE
+CAN_Instance_t can2Instance = CAN_INSTANCE_INIT(2, 0);
+#endif
+
+// Register field ranges per timing format, all in time quanta / prescaler steps
+typedef struct {
+    uint16_t presdivMax;
+    uint8_t tqMin;
+    uint8_t tqMax;
+    uint8_t propSegMin;
+    uint8_t propSegMax;
+    uint8_t pseg1Max;
+    uint8_t pseg2Max;
+    uint8_t rjwMax;
+} CAN_TimingLimits_t;
+
+static const CAN_TimingLimits_t timingLimits[] = {
+    [CAN_TIMING_CTRL1] = { 256,  8, 25, 1,  8,  8,  8,  4 },
+    [CAN_TIMING_CBT]   = { 1024, 8, 129, 1, 64, 32, 32, 32 },
+    [CAN_TIMING_FDCBT] = { 1024, 5, 48, 0, 31,  8,  8,  8 },
+};
+
+static const uint8_t dlcToLen[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64 };
+
+static const CAN_RxFilter_t defaultRxFilters[] = {
+    { RX_MSG_ID,      0x7FF,          0 },
+    { RX_FUNC_MSG_ID, 0x7FF,          0 },
+    { RX_GW_MSG_ID,   RX_GW_MSG_MASK, 0 },
+};
+
+uint8_t FLEXCAN_dlc_to_len(uint8_t dlc) {
+    return dlcToLen[dlc & 0xF];
+}
+
+uint8_t FLEXCAN_len_to_dlc(uint8_t len) {
+    uint8_t dlc = 0;
+
+    while (dlc < 15 && dlcToLen[dlc] < len) dlc++;
+    return dlc;
+}
+
+// Reading TIMER releases a locked mailbox, so callers sample it before locking one
+static uint32_t FLEXCAN_extend_timer(CAN_Instance_t *can) {
+    uint16_t raw = (uint16_t)can->base->TIMER;
+
+    if (raw < can->timerLast) {
+        can->timerHigh += 0x10000UL;
+    }
+    can->timerLast = raw;
+    return can->timerHigh | raw;
+}
+
+// Places a 16-bit mailbox TIMESTAMP on the 32-bit time line just before 'now'
+static uint32_t FLEXCAN_stamp_to_time(uint32_t now, uint32_t stamp) {
+    return now - (((uint32_t)(uint16_t)now - stamp) & 0xFFFFUL);
+}
+
+uint32_t FLEXCAN_get_time(CAN_Instance_t *can) {
+    uint32_t now;
+
+    INT_SYS_DisableIRQ(can->mbIrq);
+    now = FLEXCAN_extend_timer(can);
+    INT_SYS_EnableIRQ(can->mbIrq);
+    return now;
+}
+
+uint32_t FLEXCAN_ticks_to_us(CAN_Instance_t *can, uint32_t ticks) {
+    return (uint32_t)(((uint64_t)ticks * 1000000ULL) / can->nominalBitrate);
+}
+
+static uint32_t FLEXCAN_ms_to_ticks(CAN_Instance_t *can, uint32_t ms) {
+    return (uint32_t)(((uint64_t)can->nominalBitrate * ms) / 1000UL);
+}
+
+static void FLEXCAN_error_irq_disable(CAN_Instance_t *can) {
+    INT_SYS_DisableIRQ(can->busOffIrq);
+    INT_SYS_DisableIRQ(can->errorIrq);
+}
+
+static void FLEXCAN_error_irq_enable(CAN_Instance_t *can) {
+    INT_SYS_EnableIRQ(can->busOffIrq);
+    INT_SYS_EnableIRQ(can->errorIrq);
+}
+
+// Folds one ESR1/ECR snapshot into errStats. Called with the error vectors masked
+// or from one of them. Error bits report "at least one since the last read", so
+// the per-type counters count error interrupts, not individual error frames.
+static void FLEXCAN_service_esr1(CAN_Instance_t *can) {
+    volatile CAN_ErrorStats_t *st = &can->errStats;
+    uint32_t esr = can->base->ESR1;
+    uint32_t ecr = can->base->ECR;
+    uint32_t fltconf = (esr & CAN_ESR1_FLTCONF_MASK) >> CAN_ESR1_FLTCONF_SHIFT;
+    uint8_t state = (fltconf == 0) ? CAN_STATE_ERROR_ACTIVE :
+                    (fltconf == 1) ? CAN_STATE_ERROR_PASSIVE : CAN_STATE_BUS_OFF;
+
+    can->base->ESR1 = esr & ESR1_INT_FLAGS;
+    can->esr1Seen |= esr;
+
+    if (esr & (CAN_ESR1_STFERR_MASK | CAN_ESR1_STFERR_FAST_MASK)) st->stuffErrors++;
+    if (esr & (CAN_ESR1_FRMERR_MASK | CAN_ESR1_FRMERR_FAST_MASK)) st->formErrors++;
+    if (esr & (CAN_ESR1_CRCERR_MASK | CAN_ESR1_CRCERR_FAST_MASK)) st->crcErrors++;
+    if (esr & CAN_ESR1_ACKERR_MASK) st->ackErrors++;
+    if (esr & (CAN_ESR1_BIT0ERR_MASK | CAN_ESR1_BIT0ERR_FAST_MASK)) st->bit0Errors++;
+    if (esr & (CAN_ESR1_BIT1ERR_MASK | CAN_ESR1_BIT1ERR_FAST_MASK)) st->bit1Errors++;
+
+    st->tec = (uint8_t)(ecr & CAN_ECR_TXERRCNT_MASK);
+    st->rec = (uint8_t)((ecr & CAN_ECR_RXERRCNT_MASK) >> CAN_ECR_RXERRCNT_SHIFT);
+    if (state == CAN_STATE_ERROR_PASSIVE && st->state != CAN_STATE_ERROR_PASSIVE) {
+        st->errorPassiveCount++;
+    }
+    st->state = state;
+
+    // BOFFINT/BOFFDONEINT latch, so short bus-off episodes are not missed
+    if (esr & CAN_ESR1_BOFFINT_MASK) {
+        st->busOffCount++;
+        can->busOffPending = 1;
+    }
+    if (esr & CAN_ESR1_BOFFDONEINT_MASK) {
+        st->busOffRecoveries++;
+        if (can->busOffPolicy != CAN_BUSOFF_RECOVER_AUTO) {
+            can->base->CTRL1 |= CAN_CTRL1_BOFFREC_MASK;
+        }
+    }
+}
+
+static void FLEXCAN_reset_error_stats(CAN_Instance_t *can) {
+    can->errStats.errorPassiveCount = 0;
+    can->errStats.busOffCount = 0;
+    can->errStats.busOffRecoveries = 0;
+    can->errStats.stuffErrors = 0;
+    can->errStats.formErrors = 0;
+    can->errStats.crcErrors = 0;
+    can->errStats.ackErrors = 0;
+    can->errStats.bit0Errors = 0;
+    can->errStats.bit1Errors = 0;
+    can->errStats.txTimeouts = 0;
+}
+
+// Same search as the SDK's FLEXCAN_BitrateToTimeSeg: walk the prescaler, keep the
+// exact-bit-rate split whose sample point is closest to the target. Ties go to the
+// smallest prescaler, i.e. the most time quanta per bit.
+int FLEXCAN_calc_bit_timing(uint32_t clkHz, uint32_t bitrate, uint32_t samplePoint,
+                            CAN_TimingFormat_t format, CAN_BitTiming_t *timing) {
+    const CAN_TimingLimits_t *lim = &timingLimits[format];
+    uint32_t bestError = 1000;
+    uint32_t presdiv;
+
+    if (bitrate == 0 || timing == NULL) {
+        return -1;
+    }
+
+    for (presdiv = 1; presdiv <= lim->presdivMax; presdiv++) {
+        uint32_t numTq, tSeg1, pseg1, pseg2, propSeg, sp, err;
+
+        if (clkHz % (presdiv * bitrate) != 0) continue;
+        numTq = clkHz / (presdiv * bitrate);
+        if (numTq < lim->tqMin) break;
+        if (numTq > lim->tqMax) continue;
+
+        // tSeg1 = propSeg + pseg1, rounded to the nearest quantum of the target
+        tSeg1 = (numTq * samplePoint + 500) / 1000 - 1;
+        if (tSeg1 > numTq - 3) tSeg1 = numTq - 3;
+        pseg2 = numTq - 1 - tSeg1;
+        if (pseg2 > lim->pseg2Max) {
+            pseg2 = lim->pseg2Max;
+            tSeg1 = numTq - 1 - pseg2;
+        }
+
+        pseg1 = (pseg2 < lim->pseg1Max) ? pseg2 : lim->pseg1Max;
+        if (pseg1 > tSeg1 - lim->propSegMin) pseg1 = tSeg1 - lim->propSegMin;
+        propSeg = tSeg1 - pseg1;
+        if (propSeg > lim->propSegMax) {
+            pseg1 += propSeg - lim->propSegMax;
+            propSeg = lim->propSegMax;
+        }
+        if (pseg1 < 1 || pseg1 > lim->pseg1Max) continue;
+
+        sp = (1 + tSeg1) * 1000 / numTq;
+        err = (sp > samplePoint) ? sp - samplePoint : samplePoint - sp;
+        if (err < bestError) {
+            bestError = err;
+            timing->presdiv = presdiv;
+            timing->propSeg = propSeg;
+            timing->pseg1 = pseg1;
+            timing->pseg2 = pseg2;
+            timing->rjw = (pseg1 < pseg2 ? pseg1 : pseg2) < lim->rjwMax ?
+                          (pseg1 < pseg2 ? pseg1 : pseg2) : lim->rjwMax;
+        }
+    }
+    return (bestError < 1000) ? 0 : -1;
+}
+
+// All instances run from the oscillator (CTRL1[CLKSRC] = 0)
+static uint32_t FLEXCAN_pe_clock(void) {
+    uint32_t clkHz = 0;
+
+    (void)CLOCK_SYS_GetFreq(FEATURE_CAN_PE_OSC_CLK_NAME, &clkHz);
+    return clkHz;
+}
+
+// Must be called in freeze mode
+static int FLEXCAN_apply_nominal_timing(CAN_Instance_t *can, uint32_t bitrate, uint32_t samplePoint) {
+    CAN_Type *base = can->base;
+    CAN_BitTiming_t t;
+
+#if CAN_FD_ENABLE
+    if (can->fd) {
+        if (FLEXCAN_calc_bit_timing(FLEXCAN_pe_clock(), bitrate, samplePoint, CAN_TIMING_CBT, &t) != 0) {
+            return -1;
+        }
+        base->CBT = CAN_CBT_BTF_MASK | CAN_CBT_EPRESDIV(t.presdiv - 1) | CAN_CBT_ERJW(t.rjw - 1) |
+                    CAN_CBT_EPROPSEG(t.propSeg - 1) | CAN_CBT_EPSEG1(t.pseg1 - 1) | CAN_CBT_EPSEG2(t.pseg2 - 1);
+        can->nominalBitrate = bitrate;
+        return 0;
+    }
+#endif
+    if (FLEXCAN_calc_bit_timing(FLEXCAN_pe_clock(), bitrate, samplePoint, CAN_TIMING_CTRL1, &t) != 0) {
+        return -1;
+    }
+    base->CTRL1 = (base->CTRL1 & ~CTRL1_TIMING_MASK) |
+                  CAN_CTRL1_PRESDIV(t.presdiv - 1) | CAN_CTRL1_RJW(t.rjw - 1) |
+                  CAN_CTRL1_PSEG1(t.pseg1 - 1) | CAN_CTRL1_PSEG2(t.pseg2 - 1) |
+                  CAN_CTRL1_PROPSEG(t.propSeg - 1);
+    can->nominalBitrate = bitrate;
+    return 0;
+}
+
+#if CAN_FD_ENABLE
+// Must be called in freeze mode. TDC offset = FPROPSEG + FPSEG1 + 2 data quanta, scaled by the prescaler.
+static int FLEXCAN_apply_data_timing(CAN_Instance_t *can, uint32_t bitrate, uint32_t samplePoint) {
+    CAN_Type *base = can->base;
+    CAN_BitTiming_t t;
+
+    if (FLEXCAN_calc_bit_timing(FLEXCAN_pe_clock(), bitrate, samplePoint, CAN_TIMING_FDCBT, &t) != 0) {
+        return -1;
+    }
+    base->FDCBT = CAN_FDCBT_FPRESDIV(t.presdiv - 1) | CAN_FDCBT_FRJW(t.rjw - 1) |
+                  CAN_FDCBT_FPROPSEG(t.propSeg) | CAN_FDCBT_FPSEG1(t.pseg1 - 1) | CAN_FDCBT_FPSEG2(t.pseg2 - 1);
+    base->FDCTRL = (base->FDCTRL & ~CAN_FDCTRL_TDCOFF_MASK) |
+                   CAN_FDCTRL_TDCOFF((t.propSeg + t.pseg1 + 1) * t.presdiv);
+    return 0;
+}
+#endif
+
+static void FLEXCAN_enter_freeze(CAN_Instance_t *can) {
+    FLEXCAN_MCR_WRITE(can->base, can->base->MCR | CAN_MCR_FRZ_MASK | CAN_MCR_HALT_MASK);
+    while (!(can->base->MCR & CAN_MCR_FRZACK_MASK)) {}
+}
+
+static void FLEXCAN_exit_freeze(CAN_Instance_t *can) {
+    FLEXCAN_MCR_WRITE(can->base, can->base->MCR & ~(CAN_MCR_FRZ_MASK | CAN_MCR_HALT_MASK));
+    while (can->base->MCR & CAN_MCR_FRZACK_MASK) {}
+    while (can->base->MCR & CAN_MCR_NOTRDY_MASK) {}
+}
+
+// Must be called in freeze mode. Unused filter slots repeat filter 0.
+static void FLEXCAN_write_rx_filters(CAN_Instance_t *can, const CAN_RxFilter_t *filters, uint32_t count) {
+    CAN_Type *base = can->base;
     uint32_t i;
 
-    PCC->PCCn[PCC_FlexCAN0_INDEX] |= PCC_PCCn_CGC_MASK;
-    CAN0->MCR |= CAN_MCR_MDIS_MASK;
-    CAN0->CTRL1 &= ~CAN_CTRL1_CLKSRC_MASK;
-    CAN0->MCR &= ~CAN_MCR_MDIS_MASK;
-    while (!(CAN0->MCR & CAN_MCR_FRZACK_MASK)) {}
+    for (i = 0; i < can->filterSlots; i++) {
+        const CAN_RxFilter_t *f = (i < count) ? &filters[i] : &filters[0];
+        uint32_t ext = f->flags & CAN_MSG_EXT;
+#if CAN_FD_ENABLE
+        if (can->fd) {
+            uint32_t mb = FD_RX_MB_INDEX + i;
+
+            base->RAMn[MSG_BUF_SIZE * mb] = 0;
+            if (ext) {
+                base->RAMn[MSG_BUF_SIZE * mb + 1] = f->id & MB_ID_EXT_MASK;
+                base->RXIMR[mb] = f->mask & MB_ID_EXT_MASK;
+            } else {
+                base->RAMn[MSG_BUF_SIZE * mb + 1] = (f->id & 0x7FF) << MB_ID_STD_SHIFT;
+                base->RXIMR[mb] = (f->mask & 0x7FF) << MB_ID_STD_SHIFT;
+            }
+            base->RAMn[MSG_BUF_SIZE * mb] = (MB_CODE_RX_EMPTY << 24) | (ext ? MB_CS_IDE : 0);
+            continue;
+        }
+#endif
+        // Entries past RX_FIFO_IMR_COUNT share RXFGMASK and therefore match exactly
+        base->RAMn[RX_FIFO_TABLE_WORD + i] = RX_FIFO_FILTER_A(f->id, ext);
+        if (i < RX_FIFO_IMR_COUNT) {
+            base->RXIMR[i] = RX_FIFO_MASK_A(f->mask, ext);
+        }
+    }
+    if (!can->fd) {
+        base->RXFGMASK = RX_FIFO_MASK_A(MB_ID_EXT_MASK, 1);
+    }
+}
 
-    CAN0->CTRL1 = 0x00DB0006;
+// Brings one FlexCAN module up with CAN_NOMINAL_BITRATE and the UDS filter set.
+// Other buses override both with FLEXCAN_set_bitrate() / FLEXCAN_set_rx_filters().
+void FLEXCAN_init(CAN_Instance_t *can) {
+    CAN_Type *base = can->base;
+    uint32_t modeBits = MCR_FIFO_MODE_BITS;
+    uint32_t i;
 
-    for (i = 0; i < 128; i++) CAN0->RAMn[i] = 0;
-    for (i = 0; i < 16; i++) CAN0->RXIMR[i] = 0xFFFFFFFF;
-    CAN0->RXMGMASK = 0x7FF << 18;
+    PCC->PCCn[can->pccIndex] |= PCC_PCCn_CGC_MASK;
+    base->MCR |= CAN_MCR_MDIS_MASK;
+    base->CTRL1 &= ~CAN_CTRL1_CLKSRC_MASK;
+    base->MCR &= ~CAN_MCR_MDIS_MASK;
+    while (!(base->MCR & CAN_MCR_FRZACK_MASK)) {}
 
-    CAN0->RAMn[4*RX_MB_INDEX + 1] = RX_MSG_ID << 18;
-    CAN0->RAMn[4*RX_MB_INDEX] = 0x04000000 | (8 << 16);  // Ready to receive, DLC=8
+    // Legacy 500 kbit/s timing for an 8 MHz clock, kept if the solver finds no split
+    base->CTRL1 = 0x00DB0006;
+    can->nominalBitrate = CAN_NOMINAL_BITRATE;
+    (void)FLEXCAN_apply_nominal_timing(can, CAN_NOMINAL_BITRATE, CAN_NOMINAL_SAMPLE_POINT);
 
-    CAN0->MCR = 0x0000001F;
-    while (CAN0->MCR & CAN_MCR_FRZACK_MASK) {}
-    while (CAN0->MCR & CAN_MCR_NOTRDY_MASK) {}
+#if CAN_FD_ENABLE
+    if (can->fd) {
+        modeBits = MCR_FD_MODE_BITS;
+        base->MCR |= modeBits;
+        // CBT/FDCBT take over from the CTRL1 time segments once CBT[BTF] is set
+        base->FDCTRL = CAN_FDCTRL_FDRATE_MASK | CAN_FDCTRL_MBDSR0(FD_MBDSR) | CAN_FDCTRL_TDCEN_MASK;
+        (void)FLEXCAN_apply_data_timing(can, CAN_DATA_BITRATE, CAN_DATA_SAMPLE_POINT);
+        base->CTRL2 |= CAN_CTRL2_ISOCANFDEN_MASK;
+    } else
+#endif
+    {
+        base->MCR |= modeBits;
+        // 6-deep Rx FIFO with a hardware ID filter table in front of it
+        base->CTRL2 = (base->CTRL2 & ~CAN_CTRL2_RFFN_MASK) | CAN_CTRL2_RFFN(RX_FIFO_RFFN);
+    }
+
+    // Error, bus-off and warning interrupts; bus-off recovery follows busOffPolicy
+    can->busOffPolicy = CAN_BUSOFF_POLICY;
+    can->busOffDelayMs = CAN_BUSOFF_DELAY_MS;
+    base->CTRL1 |= CTRL1_ERROR_MASKS;
+    if (can->busOffPolicy != CAN_BUSOFF_RECOVER_AUTO) {
+        base->CTRL1 |= CAN_CTRL1_BOFFREC_MASK;
+    }
+    base->CTRL2 |= CAN_CTRL2_BOFFDONEMSK_MASK;
+
+    for (i = 0; i < CLASSIC_MSG_BUF_SIZE * can->maxMb; i++) base->RAMn[i] = 0;
+    for (i = 0; i < can->maxMb; i++) base->RXIMR[i] = 0xFFFFFFFF;
+    base->RXMGMASK = MB_ID_EXT_MASK;
+
+    FLEXCAN_write_rx_filters(can, defaultRxFilters,
+                             sizeof(defaultRxFilters) / sizeof(defaultRxFilters[0]));
+    for (can->activeFilterCount = 0;
+         can->activeFilterCount < sizeof(defaultRxFilters) / sizeof(defaultRxFilters[0]);
+         can->activeFilterCount++) {
+        can->activeFilters[can->activeFilterCount] = defaultRxFilters[can->activeFilterCount];
+    }
+
+    for (i = 0; i < TX_MB_COUNT; i++) {
+        base->RAMn[can->mbStride * (can->txMbIndex + i)] = MB_CODE_TX_INACTIVE << 24;
+    }
+    // CTRL1[LBUF] stays 0: lowest ID (plus local priority) wins among pending TX mailboxes
+    can->txQueueHead = 0;
+    can->txQueueTail = 0;
+    can->txBusyMask = 0;
+    can->txAbortMask = 0;
+
+    can->errStats.state = CAN_STATE_ERROR_ACTIVE;
+    can->errStats.tec = 0;
+    can->errStats.rec = 0;
+    FLEXCAN_reset_error_stats(can);
+    can->esr1Seen = 0;
+    can->busOffPending = 0;
+    can->busOffWaiting = 0;
+
+    can->timerHigh = 0;
+    can->timerLast = 0;
+
+    can->rxHead = 0;
+    can->rxTail = 0;
+    can->rxStats.rxFrames = 0;
+    can->rxStats.ringOverruns = 0;
+    can->rxStats.fifoWarnings = 0;
+    can->rxStats.fifoOverflows = 0;
+#if CAN_CYCLE_STATS
+    FLEXCAN_CYCLE_INIT();
+    can->cycleStats.rxFrames = 0;
+    can->cycleStats.rxCycles = 0;
+    can->cycleStats.rxMaxCycles = 0;
+    can->cycleStats.txFrames = 0;
+    can->cycleStats.txCycles = 0;
+    can->cycleStats.txMaxCycles = 0;
+#endif
+
+    FLEXCAN_IFLAG1_CLEAR(base, 0xFFFFFFFF);
+#if CAN_FD_ENABLE
+    if (can->fd) {
+        base->IMASK1 = FD_RX_MB_MASK | can->txMbMask;
+    } else
+#endif
+    {
+        base->IMASK1 = RX_FIFO_FRAME_AVAILABLE | RX_FIFO_WARNING | RX_FIFO_OVERFLOW | can->txMbMask;
+    }
+    INT_SYS_EnableIRQ(can->mbIrq);
+    base->ESR1 = ESR1_INT_FLAGS;
+    FLEXCAN_error_irq_enable(can);
+
+    base->MCR = modeBits | CAN_MCR_MAXMB(can->mbCount - 1UL);
+    while (base->MCR & CAN_MCR_FRZACK_MASK) {}
+    while (base->MCR & CAN_MCR_NOTRDY_MASK) {}
 }
 
-void FLEXCAN0_transmit_msg(const CAN_Message_t *msg) {
-    CAN0->RAMn[MSG_BUF_SIZE * TX_MB_INDEX] = 0x08000000;
+int FLEXCAN_set_rx_filters(CAN_Instance_t *can, const CAN_RxFilter_t *filters, uint32_t count) {
+    if (filters == NULL || count == 0 || count > can->filterSlots) {
+        return -1;
+    }
+
+    FLEXCAN_enter_freeze(can);
+    FLEXCAN_write_rx_filters(can, filters, count);
+    FLEXCAN_exit_freeze(can);
+
+    for (can->activeFilterCount = 0; can->activeFilterCount < count; can->activeFilterCount++) {
+        can->activeFilters[can->activeFilterCount] = filters[can->activeFilterCount];
+    }
+    return 0;
+}
+
+int FLEXCAN_set_bitrate(CAN_Instance_t *can, uint32_t bitrate, uint32_t samplePoint) {
+    int result;
+
+    FLEXCAN_enter_freeze(can);
+    result = FLEXCAN_apply_nominal_timing(can, bitrate, samplePoint);
+    FLEXCAN_exit_freeze(can);
+    return result;
+}
+
+#if CAN_FD_ENABLE
+int FLEXCAN_set_data_bitrate(CAN_Instance_t *can, uint32_t bitrate, uint32_t samplePoint) {
+    int result;
+
+    if (!can->fd) {
+        return -1;
+    }
+    FLEXCAN_enter_freeze(can);
+    result = FLEXCAN_apply_data_timing(can, bitrate, samplePoint);
+    FLEXCAN_exit_freeze(can);
+    return result;
+}
+#endif
+
+// Tries each candidate rate in listen-only mode with an accept-all filter and
+// locks onto the first one that receives a frame without stuff/form/CRC errors.
+// Each candidate gets windowMs, measured in TIMER ticks, so the whole search is
+// bounded by count * windowMs. Returns the locked rate, or 0 with the previous
+// timing restored. Frames and error counts from probing are discarded.
+uint32_t FLEXCAN_autobaud(CAN_Instance_t *can, const uint32_t *rates, uint32_t count, uint32_t windowMs) {
+    static const CAN_RxFilter_t acceptAll[] = {
+        { 0, 0, 0 },
+        { 0, 0, CAN_MSG_EXT },
+    };
+    CAN_RxFilter_t savedFilters[RX_FILTER_SLOTS_MAX];
+    uint32_t savedCount = can->activeFilterCount;
+    uint32_t savedBitrate = can->nominalBitrate;
+    uint32_t locked = 0;
+    uint32_t i;
+
+    for (i = 0; i < savedCount; i++) savedFilters[i] = can->activeFilters[i];
+
+    INT_SYS_DisableIRQ(can->mbIrq);
+    can->rxTail = can->rxHead;
+    INT_SYS_EnableIRQ(can->mbIrq);
 
-    CAN0->RAMn[MSG_BUF_SIZE * TX_MB_INDEX + 1] = (msg->canID << 18);
+    for (i = 0; i < count && locked == 0; i++) {
+        uint32_t start, window, errors, frames;
 
-    uint32_t dataWord0 = ((uint32_t)msg->data[0] << 24) |
-                         ((uint32_t)msg->data[1] << 16) |
-                         ((uint32_t)msg->data[2] << 8)  |
-                         ((uint32_t)msg->data[3]);
-    uint32_t dataWord1 = ((uint32_t)msg->data[4] << 24) |
-                         ((uint32_t)msg->data[5] << 16) |
-                         ((uint32_t)msg->data[6] << 8)  |
-                         ((uint32_t)msg->data[7]);
-    CAN0->RAMn[4 * TX_MB_INDEX + 2] = dataWord0;
-    CAN0->RAMn[4 * TX_MB_INDEX + 3] = dataWord1;
+        FLEXCAN_enter_freeze(can);
+        if (FLEXCAN_apply_nominal_timing(can, rates[i], CAN_NOMINAL_SAMPLE_POINT) != 0) {
+            FLEXCAN_exit_freeze(can);
+            continue;
+        }
+        FLEXCAN_write_rx_filters(can, acceptAll, sizeof(acceptAll) / sizeof(acceptAll[0]));
+        can->base->CTRL1 |= CAN_CTRL1_LOM_MASK;
+        FLEXCAN_exit_freeze(can);
 
-    CAN0->IFLAG1 = (1 << TX_MB_INDEX);
+        FLEXCAN_error_irq_disable(can);
+        FLEXCAN_service_esr1(can);
+        can->esr1Seen = 0;
+        FLEXCAN_error_irq_enable(can);
+        frames = can->rxStats.rxFrames;
+        window = FLEXCAN_ms_to_ticks(can, windowMs);
+        start = FLEXCAN_get_time(can);
 
-    CAN0->RAMn[MSG_BUF_SIZE * TX_MB_INDEX] = 0x0C400000 | ((msg->dlc & 0xF) << 16);
+        while ((FLEXCAN_get_time(can) - start) < window) {
+            if (can->rxStats.rxFrames != frames) {
+                FLEXCAN_error_irq_disable(can);
+                FLEXCAN_service_esr1(can);
+                errors = can->esr1Seen & ESR1_RX_ERRORS;
+                FLEXCAN_error_irq_enable(can);
+                if (errors == 0) locked = rates[i];
+                break;
+            }
+        }
+    }
+
+    FLEXCAN_enter_freeze(can);
+    can->base->CTRL1 &= ~CAN_CTRL1_LOM_MASK;
+    if (locked == 0) {
+        (void)FLEXCAN_apply_nominal_timing(can, savedBitrate, CAN_NOMINAL_SAMPLE_POINT);
+    }
+    FLEXCAN_write_rx_filters(can, savedFilters, savedCount);
+    FLEXCAN_exit_freeze(can);
+
+    INT_SYS_DisableIRQ(can->mbIrq);
+    can->rxTail = can->rxHead;
+    INT_SYS_EnableIRQ(can->mbIrq);
 
-    while (!(CAN0->IFLAG1 & (1 << TX_MB_INDEX))) {}
-    CAN0->IFLAG1 = (1 << TX_MB_INDEX);
+    FLEXCAN_error_irq_disable(can);
+    FLEXCAN_service_esr1(can);
+    FLEXCAN_reset_error_stats(can);
+    FLEXCAN_error_irq_enable(can);
+    return locked;
 }
 
-int FLEXCAN0_receive_msg(CAN_Message_t *msg) {
-    if (CAN0->IFLAG1 & (1 << RX_MB_INDEX)) {
-        // Clear interrupt flag for RX mailbox
-        CAN0->IFLAG1 = (1 << RX_MB_INDEX);
+#if CAN_CYCLE_STATS
+static void FLEXCAN_count_cycles(volatile uint32_t *frames, volatile uint32_t *total,
+                                 volatile uint32_t *max, uint32_t cycles) {
+    (*frames)++;
+    *total += cycles;
+    if (cycles > *max) {
+        *max = cycles;
+    }
+}
+#endif
+
+static void FLEXCAN_write_tx_mb(CAN_Instance_t *can, uint32_t mb, const CAN_Message_t *msg, uint8_t prio) {
+    volatile uint32_t *ram = &can->base->RAMn[can->mbStride * mb];
+    uint32_t cs = (MB_CODE_TX_DATA << 24) | MB_CS_SRR | ((msg->dlc & 0xF) << 16);
+    uint32_t len = FLEXCAN_dlc_to_len(msg->dlc);
+    uint32_t w;
+#if CAN_CYCLE_STATS
+    uint32_t start = FLEXCAN_CYCLE_COUNT();
+#endif
+
+#if CAN_FD_ENABLE
+    if (can->fd && (msg->flags & CAN_MSG_FD)) {
+        cs |= MB_CS_EDL | ((msg->flags & CAN_MSG_BRS) ? MB_CS_BRS : 0);
+    } else if (len > 8) {
+        len = 8;
+    }
+#else
+    if (len > 8) len = 8;
+#endif
 
-        uint32_t word0 = CAN0->RAMn[4 * RX_MB_INDEX];
-        uint32_t word1 = CAN0->RAMn[4 * RX_MB_INDEX + 1];
+    ram[0] = MB_CODE_TX_INACTIVE << 24;
 
-        msg->canID = (word1 >> 18) & 0x7FF;
-        msg->dlc = (word0 >> 16) & 0xF;
+    if (msg->flags & CAN_MSG_EXT) {
+        cs |= MB_CS_IDE;
+        ram[1] = ((uint32_t)(prio & 0x7) << MB_ID_PRIO_SHIFT) | (msg->canID & MB_ID_EXT_MASK);
+    } else {
+        ram[1] = ((uint32_t)(prio & 0x7) << MB_ID_PRIO_SHIFT) | ((msg->canID & MB_ID_STD_MASK) << MB_ID_STD_SHIFT);
+    }
 
-        uint32_t dataWord0 = CAN0->RAMn[4 * RX_MB_INDEX + 2];
-        uint32_t dataWord1 = CAN0->RAMn[4 * RX_MB_INDEX + 3];
+    // Mailbox payload is big-endian: one REV per word instead of four shifts and ORs
+    for (w = 0; w < (len + 3) / 4; w++) {
+        uint32_t dataWord;
 
-        msg->data[0] = (dataWord0 >> 24) & 0xFF;
-        msg->data[1] = (dataWord0 >> 16) & 0xFF;
-        msg->data[2] = (dataWord0 >> 8)  & 0xFF;
-        msg->data[3] = (dataWord0 >> 0)  & 0xFF;
+        REV_BYTES_32(msg->words[w], dataWord);
+        ram[2 + w] = dataWord;
+    }
 
-        msg->data[4] = (dataWord1 >> 24) & 0xFF;
-        msg->data[5] = (dataWord1 >> 16) & 0xFF;
-        msg->data[6] = (dataWord1 >> 8)  & 0xFF;
-        msg->data[7] = (dataWord1 >> 0)  & 0xFF;
+    ram[0] = cs;
+#if CAN_CYCLE_STATS
+    FLEXCAN_count_cycles(&can->cycleStats.txFrames, &can->cycleStats.txCycles,
+                         &can->cycleStats.txMaxCycles, FLEXCAN_CYCLE_COUNT() - start);
+#endif
+}
 
-        // Ready to receive next message, reset RX mailbox
-        CAN0->RAMn[4 * RX_MB_INDEX] = 0x04000000 | ((msg->dlc & 0xF) << 16);
+static int FLEXCAN_id_in_flight(const CAN_Instance_t *can, const CAN_Message_t *msg) {
+    uint32_t i;
 
-        return 1;
+    for (i = 0; i < TX_MB_COUNT; i++) {
+        if ((can->txBusyMask & (1UL << i)) && can->txInFlight[i].msg.canID == msg->canID &&
+            ((can->txInFlight[i].msg.flags ^ msg->flags) & CAN_MSG_EXT) == 0) {
+            return 1;
+        }
     }
     return 0;
-}
\ No newline at end of file
+}
+
+// Moves queued frames into free pool mailboxes. Frames sharing an ID are never
+// in flight together, so arbitration cannot reorder e.g. ISO-TP consecutive frames.
+// A frame whose ID is in flight is skipped, not waited for: frames with other IDs
+// behind it still get the free mailboxes. Skipped frames all have an ID in flight,
+// so per-ID order is kept; they move up behind the tail to close the gap.
+static void FLEXCAN_load_tx_mbs(CAN_Instance_t *can) {
+    uint32_t pos = can->txQueueTail;
+
+    while (pos != can->txQueueHead && can->txBusyMask != TX_POOL_MASK) {
+        CAN_TxRequest_t *req = &can->txQueue[pos & TX_QUEUE_MASK];
+        uint32_t slot = 0;
+        uint32_t i;
+
+        if (FLEXCAN_id_in_flight(can, &req->msg)) {
+            pos++;
+            continue;
+        }
+        while (can->txBusyMask & (1UL << slot)) slot++;
+
+        can->txInFlight[slot] = *req;
+        can->txBusyMask |= (1UL << slot);
+        can->txStart[slot] = FLEXCAN_extend_timer(can);
+        for (i = pos; i != can->txQueueTail; i--) {
+            can->txQueue[i & TX_QUEUE_MASK] = can->txQueue[(i - 1) & TX_QUEUE_MASK];
+        }
+        can->txQueueTail++;
+        pos++;
+        FLEXCAN_write_tx_mb(can, can->txMbIndex + slot, &can->txInFlight[slot].msg,
+                            can->txInFlight[slot].prio);
+    }
+}
+
+int FLEXCAN_transmit_async(CAN_Instance_t *can, const CAN_Message_t *msg, uint8_t prio,
+                           CAN_TxCallback_t callback, void *context) {
+    int result = -1;
+
+    INT_SYS_DisableIRQ(can->mbIrq);
+    if ((can->txQueueHead - can->txQueueTail) < TX_QUEUE_SIZE) {
+        CAN_TxRequest_t *req = &can->txQueue[can->txQueueHead & TX_QUEUE_MASK];
+
+        req->msg = *msg;
+        req->prio = prio;
+        req->callback = callback;
+        req->context = context;
+        can->txQueueHead++;
+        FLEXCAN_load_tx_mbs(can);
+        result = 0;
+    }
+    INT_SYS_EnableIRQ(can->mbIrq);
+    return result;
+}
+
+int FLEXCAN_transmit_msg(CAN_Instance_t *can, const CAN_Message_t *msg) {
+    return FLEXCAN_transmit_async(can, msg, TX_PRIO_DEFAULT, NULL, NULL);
+}
+
+static void FLEXCAN_complete_tx(CAN_Instance_t *can, uint32_t flags) {
+    CAN_TxRequest_t done[TX_MB_COUNT];
+    int status[TX_MB_COUNT];
+    uint32_t doneCount = 0;
+    uint32_t now = FLEXCAN_extend_timer(can);
+    uint32_t i;
+
+    FLEXCAN_IFLAG1_CLEAR(can->base, flags & can->txMbMask);
+    for (i = 0; i < TX_MB_COUNT; i++) {
+        if (flags & (1UL << (can->txMbIndex + i))) {
+            uint32_t cs = can->base->RAMn[can->mbStride * (can->txMbIndex + i)];
+
+            // An abort that lost the race against transmission completes as INACTIVE
+            status[doneCount] = ((cs & MB_CS_CODE_MASK) == (MB_CODE_TX_ABORT << 24)) ?
+                                CAN_TX_ABORTED : CAN_TX_OK;
+            done[doneCount] = can->txInFlight[i];
+            done[doneCount++].msg.timestamp = FLEXCAN_stamp_to_time(now, cs & 0xFFFFUL);
+            can->txBusyMask &= ~(1UL << i);
+            can->txAbortMask &= ~(1UL << i);
+        }
+    }
+
+    // Refill the pool before running callbacks so the bus stays busy
+    FLEXCAN_load_tx_mbs(can);
+
+    for (i = 0; i < doneCount; i++) {
+        if (done[i].callback != NULL) {
+            done[i].callback(&done[i].msg, status[i], done[i].context);
+        }
+    }
+}
+
+static void FLEXCAN_read_rx_mb(const volatile uint32_t *ram, CAN_Message_t *msg, uint32_t now) {
+    uint32_t word0 = ram[0];
+    uint32_t word1 = ram[1];
+    uint32_t len;
+    uint32_t w;
+
+    if (word0 & MB_CS_IDE) {
+        msg->canID = word1 & MB_ID_EXT_MASK;
+        msg->flags = CAN_MSG_EXT;
+    } else {
+        msg->canID = (word1 >> MB_ID_STD_SHIFT) & 0x7FF;
+        msg->flags = 0;
+    }
+    msg->dlc = (word0 >> 16) & 0xF;
+    msg->timestamp = FLEXCAN_stamp_to_time(now, word0 & 0xFFFFUL);
+    len = FLEXCAN_dlc_to_len(msg->dlc);
+
+#if CAN_FD_ENABLE
+    if (word0 & MB_CS_EDL) {
+        msg->flags |= CAN_MSG_FD | ((word0 & MB_CS_BRS) ? CAN_MSG_BRS : 0);
+    } else if (len > 8) {
+        len = 8;
+    }
+#else
+    if (len > 8) len = 8;
+#endif
+
+    for (w = 0; w < (len + 3) / 4; w++) {
+        uint32_t dataWord = ram[2 + w];
+
+        REV_BYTES_32(dataWord, msg->words[w]);
+    }
+}
+
+// Stores one received frame from the mailbox at 'ram' in the ring, or counts the drop
+static void FLEXCAN_push_rx(CAN_Instance_t *can, const volatile uint32_t *ram, uint32_t now) {
+    uint32_t head = can->rxHead;
+
+    if ((head - can->rxTail) < RX_RING_SIZE) {
+#if CAN_CYCLE_STATS
+        uint32_t start = FLEXCAN_CYCLE_COUNT();
+
+        FLEXCAN_read_rx_mb(ram, &can->rxRing[head & RX_RING_MASK], now);
+        FLEXCAN_count_cycles(&can->cycleStats.rxFrames, &can->cycleStats.rxCycles,
+                             &can->cycleStats.rxMaxCycles, FLEXCAN_CYCLE_COUNT() - start);
+#else
+        FLEXCAN_read_rx_mb(ram, &can->rxRing[head & RX_RING_MASK], now);
+#endif
+        COMPILER_BARRIER();
+        can->rxHead = head + 1;
+        can->rxStats.rxFrames++;
+    } else {
+        can->rxStats.ringOverruns++;
+    }
+}
+
+#if CAN_FD_ENABLE
+static void FLEXCAN_rx_mb_irq(CAN_Instance_t *can, uint32_t flags) {
+    CAN_Type *base = can->base;
+
+    flags &= FD_RX_MB_MASK;
+    while (flags) {
+        uint32_t mb = 0;
+        uint32_t now = FLEXCAN_extend_timer(can);
+
+        while (!(flags & (1UL << mb))) mb++;
+        flags &= ~(1UL << mb);
+
+        // CODE reads back OVERRUN (0x6) when a frame was overwritten unread
+        if (((base->RAMn[MSG_BUF_SIZE * mb] >> 24) & 0xF) == 0x6UL) {
+            can->rxStats.fifoOverflows++;
+        }
+        FLEXCAN_push_rx(can, &base->RAMn[MSG_BUF_SIZE * mb], now);
+
+        // Re-arm the mailbox, then read TIMER to release the lock taken by the CS read
+        base->RAMn[MSG_BUF_SIZE * mb] = MB_CODE_RX_EMPTY << 24;
+        FLEXCAN_IFLAG1_CLEAR(base, 1UL << mb);
+        (void)base->TIMER;
+    }
+}
+#endif
+
+static void FLEXCAN_rx_fifo_irq(CAN_Instance_t *can, uint32_t flags) {
+    CAN_Type *base = can->base;
+
+    if (flags & RX_FIFO_WARNING) {
+        can->rxStats.fifoWarnings++;
+    }
+    if (flags & RX_FIFO_OVERFLOW) {
+        can->rxStats.fifoOverflows++;
+    }
+    FLEXCAN_IFLAG1_CLEAR(base, flags & (RX_FIFO_WARNING | RX_FIFO_OVERFLOW));
+
+    // Drain every frame the FIFO holds; clearing the available flag pops the next one
+    while (base->IFLAG1 & RX_FIFO_FRAME_AVAILABLE) {
+        FLEXCAN_push_rx(can, &base->RAMn[CLASSIC_MSG_BUF_SIZE * RX_FIFO_MB], FLEXCAN_extend_timer(can));
+        FLEXCAN_IFLAG1_CLEAR(base, RX_FIFO_FRAME_AVAILABLE);
+    }
+}
+
+static void FLEXCAN_mb_irq(CAN_Instance_t *can) {
+    uint32_t flags = can->base->IFLAG1;
+
+    if (flags & can->txMbMask) {
+        FLEXCAN_complete_tx(can, flags);
+    }
+#if CAN_FD_ENABLE
+    if (can->fd) {
+        FLEXCAN_rx_mb_irq(can, flags);
+        return;
+    }
+#endif
+    FLEXCAN_rx_fifo_irq(can, flags);
+}
+
+void CAN0_ORed_0_15_MB_IRQHandler(void) {
+    FLEXCAN_mb_irq(&can0Instance);
+}
+
+void CAN0_ORed_IRQHandler(void) {
+    FLEXCAN_service_esr1(&can0Instance);
+}
+
+void CAN0_Error_IRQHandler(void) {
+    FLEXCAN_service_esr1(&can0Instance);
+}
+
+#if CAN1_ENABLE
+void CAN1_ORed_0_15_MB_IRQHandler(void) {
+    FLEXCAN_mb_irq(&can1Instance);
+}
+
+void CAN1_ORed_IRQHandler(void) {
+    FLEXCAN_service_esr1(&can1Instance);
+}
+
+void CAN1_Error_IRQHandler(void) {
+    FLEXCAN_service_esr1(&can1Instance);
+}
+#endif
+
+#if CAN2_ENABLE
+void CAN2_ORed_0_15_MB_IRQHandler(void) {
+    FLEXCAN_mb_irq(&can2Instance);
+}
+
+void CAN2_ORed_IRQHandler(void) {
+    FLEXCAN_service_esr1(&can2Instance);
+}
+
+void CAN2_Error_IRQHandler(void) {
+    FLEXCAN_service_esr1(&can2Instance);
+}
+#endif
+
+uint32_t FLEXCAN_receive_batch(CAN_Instance_t *can, CAN_Message_t *msgs, uint32_t maxMsgs) {
+    uint32_t tail = can->rxTail;
+    uint32_t count = can->rxHead - tail;
+    uint32_t i;
+
+    if (count > maxMsgs) count = maxMsgs;
+    COMPILER_BARRIER();
+
+    for (i = 0; i < count; i++) {
+        msgs[i] = can->rxRing[(tail + i) & RX_RING_MASK];
+    }
+
+    COMPILER_BARRIER();
+    can->rxTail = tail + count;
+    return count;
+}
+
+int FLEXCAN_receive_msg(CAN_Instance_t *can, CAN_Message_t *msg) {
+    return (int)FLEXCAN_receive_batch(can, msg, 1);
+}
+
+// Frames waiting in the ring; lets protocol layers size their flow control
+uint32_t FLEXCAN_rx_pending(CAN_Instance_t *can) {
+    return can->rxHead - can->rxTail;
+}
+
+// Zero-copy access to the oldest received frame. The slot stays owned by the
+// caller, and the ISR will not reuse it, until FLEXCAN_rx_release().
+const CAN_Message_t *FLEXCAN_rx_peek(CAN_Instance_t *can) {
+    uint32_t tail = can->rxTail;
+
+    if (can->rxHead == tail) {
+        return NULL;
+    }
+    COMPILER_BARRIER();
+    return &can->rxRing[tail & RX_RING_MASK];
+}
+
+void FLEXCAN_rx_release(CAN_Instance_t *can) {
+    COMPILER_BARRIER();
+    if (can->rxHead != can->rxTail) {
+        can->rxTail = can->rxTail + 1;
+    }
+}
+
+void FLEXCAN_get_rx_stats(CAN_Instance_t *can, CAN_RxStats_t *stats) {
+    INT_SYS_DisableIRQ(can->mbIrq);
+    stats->rxFrames = can->rxStats.rxFrames;
+    stats->ringOverruns = can->rxStats.ringOverruns;
+    stats->fifoWarnings = can->rxStats.fifoWarnings;
+    stats->fifoOverflows = can->rxStats.fifoOverflows;
+    INT_SYS_EnableIRQ(can->mbIrq);
+}
+
+void FLEXCAN_get_error_stats(CAN_Instance_t *can, CAN_ErrorStats_t *stats) {
+    FLEXCAN_error_irq_disable(can);
+    FLEXCAN_service_esr1(can);
+    stats->state = can->errStats.state;
+    stats->tec = can->errStats.tec;
+    stats->rec = can->errStats.rec;
+    stats->errorPassiveCount = can->errStats.errorPassiveCount;
+    stats->busOffCount = can->errStats.busOffCount;
+    stats->busOffRecoveries = can->errStats.busOffRecoveries;
+    stats->stuffErrors = can->errStats.stuffErrors;
+    stats->formErrors = can->errStats.formErrors;
+    stats->crcErrors = can->errStats.crcErrors;
+    stats->ackErrors = can->errStats.ackErrors;
+    stats->bit0Errors = can->errStats.bit0Errors;
+    stats->bit1Errors = can->errStats.bit1Errors;
+    stats->txTimeouts = can->errStats.txTimeouts;
+    FLEXCAN_error_irq_enable(can);
+}
+
+#if CAN_CYCLE_STATS
+// Copies and clears the counters, so each call reports the frames since the last one
+void FLEXCAN_get_cycle_stats(CAN_Instance_t *can, CAN_CycleStats_t *stats) {
+    INT_SYS_DisableIRQ(can->mbIrq);
+    stats->rxFrames = can->cycleStats.rxFrames;
+    stats->rxCycles = can->cycleStats.rxCycles;
+    stats->rxMaxCycles = can->cycleStats.rxMaxCycles;
+    stats->txFrames = can->cycleStats.txFrames;
+    stats->txCycles = can->cycleStats.txCycles;
+    stats->txMaxCycles = can->cycleStats.txMaxCycles;
+    can->cycleStats.rxFrames = 0;
+    can->cycleStats.rxCycles = 0;
+    can->cycleStats.rxMaxCycles = 0;
+    can->cycleStats.txFrames = 0;
+    can->cycleStats.txCycles = 0;
+    can->cycleStats.txMaxCycles = 0;
+    INT_SYS_EnableIRQ(can->mbIrq);
+}
+
+#endif
+// delayMs only applies to CAN_BUSOFF_RECOVER_DELAYED. Switching to AUTO while
+// bus-off starts the hardware recovery right away.
+void FLEXCAN_set_bus_off_policy(CAN_Instance_t *can, CAN_BusOffPolicy_t policy, uint32_t delayMs) {
+    FLEXCAN_error_irq_disable(can);
+    can->busOffPolicy = policy;
+    can->busOffDelayMs = delayMs;
+    can->busOffWaiting = 0;
+    if (policy == CAN_BUSOFF_RECOVER_AUTO) {
+        can->base->CTRL1 &= ~CAN_CTRL1_BOFFREC_MASK;
+    } else {
+        can->base->CTRL1 |= CAN_CTRL1_BOFFREC_MASK;
+        if (can->errStats.state == CAN_STATE_BUS_OFF) {
+            can->busOffPending = 1;
+        }
+    }
+    FLEXCAN_error_irq_enable(can);
+}
+
+// Starts the ISO 11898 recovery sequence (128 x 11 recessive bits) if bus-off
+void FLEXCAN_recover_bus_off(CAN_Instance_t *can) {
+    FLEXCAN_error_irq_disable(can);
+    can->busOffWaiting = 0;
+    can->base->CTRL1 &= ~CAN_CTRL1_BOFFREC_MASK;
+    FLEXCAN_error_irq_enable(can);
+}
+
+// Main-loop housekeeping: refreshes TEC/REC and the fault state, runs the delayed
+// bus-off recovery and aborts TX mailboxes pending longer than CAN_TX_TIMEOUT_MS,
+// so a silent or bus-off controller cannot hold the TX pool forever. Aborted
+// frames reach their callback with CAN_TX_ABORTED.
+void FLEXCAN_error_tick(CAN_Instance_t *can) {
+    uint32_t timeout;
+    uint32_t now;
+    uint32_t i;
+
+    INT_SYS_DisableIRQ(can->mbIrq);
+    FLEXCAN_error_irq_disable(can);
+    FLEXCAN_service_esr1(can);
+    now = FLEXCAN_extend_timer(can);
+
+    if (can->busOffPending) {
+        can->busOffPending = 0;
+        can->busOffWaiting = (can->busOffPolicy == CAN_BUSOFF_RECOVER_DELAYED);
+        can->busOffStart = now;
+    }
+    if (can->busOffWaiting && (now - can->busOffStart) >= FLEXCAN_ms_to_ticks(can, can->busOffDelayMs)) {
+        can->busOffWaiting = 0;
+        can->base->CTRL1 &= ~CAN_CTRL1_BOFFREC_MASK;
+    }
+
+    timeout = FLEXCAN_ms_to_ticks(can, CAN_TX_TIMEOUT_MS);
+    for (i = 0; i < TX_MB_COUNT; i++) {
+        uint32_t bit = 1UL << i;
+
+        if ((can->txBusyMask & bit) && !(can->txAbortMask & bit) && (now - can->txStart[i]) >= timeout) {
+            volatile uint32_t *cs = &can->base->RAMn[can->mbStride * (can->txMbIndex + i)];
+
+            // MCR[AEN]: the mailbox answers with ABORT, or INACTIVE if it was already sent
+            *cs = (*cs & ~MB_CS_CODE_MASK) | (MB_CODE_TX_ABORT << 24);
+            can->txAbortMask |= bit;
+            can->errStats.txTimeouts++;
+        }
+    }
+    FLEXCAN_error_irq_enable(can);
+    INT_SYS_EnableIRQ(can->mbIrq);
+}
@@ -1,22 +1,191 @@
 #ifndef FLEXCAN_H
 #define FLEXCAN_H
 
+#include <stdint.h>
 
-#define RX_MB_INDEX  0UL
-#define TX_MB_INDEX  1UL
+#ifndef CAN1_ENABLE
+#define CAN1_ENABLE          0      // 1 = driver state and vectors for FlexCAN1 (classic CAN only)
+#endif
+#ifndef CAN2_ENABLE
+#define CAN2_ENABLE          0      // 1 = driver state and vectors for FlexCAN2 (classic CAN only)
+#endif
+#define CAN_FD_ENABLE        0      // 1 = FlexCAN0 runs CAN FD with bit-rate switching; RX then uses mailboxes
+#define CAN_FD_PAYLOAD_SIZE  64UL   // FD mailbox payload: 8, 16, 32 or 64 bytes
+#ifndef CAN_CYCLE_STATS
+#define CAN_CYCLE_STATS      0      // 1 = count core cycles per mailbox copy (DWT CYCCNT), see FLEXCAN_get_cycle_stats()
+#endif
+
+#if CAN_FD_ENABLE
+#define CAN_PAYLOAD_MAX      CAN_FD_PAYLOAD_SIZE
+#else
+#define CAN_PAYLOAD_MAX      8UL
+#endif
+
+#define MSG_BUF_SIZE (2UL + CAN_PAYLOAD_MAX / 4UL)  // FlexCAN0 mailbox stride in words: CS + ID + payload
+#define MB_COUNT     (128UL / MSG_BUF_SIZE)         // FlexCAN0 mailboxes in the 512-byte message RAM
+#define CLASSIC_MSG_BUF_SIZE 4UL                    // Stride of classic mailboxes (FlexCAN1/2, FlexCAN0 without FD)
+
+#define RX_FIFO_FILTER_COUNT 16UL   // Rx FIFO ID filter table size, 8 or 16 (CTRL2[RFFN])
+#define RX_FIFO_TX_MB_INDEX  (6UL + RX_FIFO_FILTER_COUNT / 4UL)  // First MB of the TX pool, after the filter table
+
+#define FD_RX_MB_INDEX  0UL         // First FD RX mailbox, one per acceptance filter
+#define FD_RX_MB_COUNT  3UL
+#define FD_TX_MB_INDEX  (FD_RX_MB_INDEX + FD_RX_MB_COUNT)
+
+#define TX_MB_COUNT  4UL            // TX mailbox pool size per instance, pool must stay within MB0..15
 #define RX_MSG_ID    0x769
+#define RX_FUNC_MSG_ID  0x7DF       // OBD/UDS functional request
+#define RX_GW_MSG_ID    0x7E0       // Gateway-forwarded physical requests 0x7E0..0x7EF
+#define RX_GW_MSG_MASK  0x7F0
 #define TX_MSG_ID    0x768
-#define MSG_BUF_SIZE 4
+
+#define CAN_NOMINAL_BITRATE      500000UL   // Nominal bit rate programmed by FLEXCAN_init
+#define CAN_NOMINAL_SAMPLE_POINT 875UL      // Sample point in 1/1000 of the bit time
+#define CAN_DATA_BITRATE         1000000UL  // FD data-phase bit rate
+#define CAN_DATA_SAMPLE_POINT    750UL
+#define CAN_AUTOBAUD_ENABLE      0          // 1 = detect the bus rate in listen-only mode at start-up
+#define CAN_AUTOBAUD_WINDOW_MS   200UL      // Listening time per candidate rate
+#define CAN_TX_TIMEOUT_MS        100UL      // A TX mailbox still pending after this is aborted
+#define CAN_BUSOFF_POLICY        CAN_BUSOFF_RECOVER_DELAYED
+#define CAN_BUSOFF_DELAY_MS      100UL      // Hold-off before a delayed bus-off recovery starts
+
+#define CAN_MSG_FD   0x01U          // FD frame format (EDL)
+#define CAN_MSG_BRS  0x02U          // Switch to the data bit rate for the payload
+#define CAN_MSG_EXT  0x04U          // 29-bit extended identifier (IDE)
+
+#define RX_RING_SIZE 32UL   // Frames buffered between RX ISR and main loop, power of two
+#define RX_BATCH_MAX 8UL    // Frames the main loop drains per iteration
+#define TX_QUEUE_SIZE 16UL  // Frames waiting for a free TX mailbox, power of two
+#define TX_PRIO_DEFAULT 4U  // Local priority (0 = highest .. 7), MCR[LPRIOEN]
 
 typedef struct {
-    uint32_t canID;
-    uint8_t dlc;
-    uint8_t data[8];
+    uint32_t canID;     // 11-bit, or 29-bit with CAN_MSG_EXT
+    uint8_t dlc;        // DLC code; equals the byte count for classic frames
+    uint8_t flags;      // CAN_MSG_EXT, CAN_MSG_FD / CAN_MSG_BRS (FD ignored unless CAN_FD_ENABLE)
+    union {
+        uint8_t data[CAN_PAYLOAD_MAX];
+        uint32_t words[CAN_PAYLOAD_MAX / 4UL];  // Same payload, word-aligned for mailbox copies
+    };
+    uint32_t timestamp; // Free-running timer at start of frame, extended to 32 bits (nominal bit times)
 } CAN_Message_t;
 
-void FLEXCAN0_init(void);
-void FLEXCAN0_transmit_msg(const CAN_Message_t *msg);
-int FLEXCAN0_receive_msg(CAN_Message_t *msg);
+typedef enum {
+    CAN_TIMING_CTRL1 = 0,   // Classic CTRL1 segments
+    CAN_TIMING_CBT,         // Extended nominal segments (CBT, BTF=1)
+    CAN_TIMING_FDCBT        // FD data-phase segments
+} CAN_TimingFormat_t;
+
+typedef struct {
+    uint32_t presdiv;   // Prescaler, PE clock cycles per time quantum
+    uint32_t propSeg;   // Segment lengths in time quanta
+    uint32_t pseg1;
+    uint32_t pseg2;
+    uint32_t rjw;
+} CAN_BitTiming_t;
+
+#define CAN_TX_OK       0           // CAN_TxCallback_t status: frame sent on the bus
+#define CAN_TX_ABORTED  (-1)        // Not sent within CAN_TX_TIMEOUT_MS, mailbox aborted
+
+// Called from the TX interrupt once the frame has been sent on the bus or aborted
+typedef void (*CAN_TxCallback_t)(const CAN_Message_t *msg, int status, void *context);
+
+typedef struct {
+    uint32_t id;    // 11-bit identifier, or 29-bit with CAN_MSG_EXT
+    uint32_t mask;  // Acceptance mask of the same width, 1 = bit must match
+    uint8_t flags;  // CAN_MSG_EXT to match extended frames only
+} CAN_RxFilter_t;
+
+typedef struct {
+    uint32_t rxFrames;      // Frames moved from the Rx FIFO into the ring
+    uint32_t ringOverruns;  // Frames dropped because the ring was full
+    uint32_t fifoWarnings;  // Rx FIFO reached 5 of 6 entries
+    uint32_t fifoOverflows; // Rx FIFO (or an FD RX mailbox) was full and a frame was lost in hardware
+} CAN_RxStats_t;
+
+// Core cycles spent moving frames between mailbox RAM and CAN_Message_t,
+// accumulated by the MB interrupt and the TX path. Measures the word copy
+// (ID, control word and REV'd payload), not queueing or the ISR entry.
+typedef struct {
+    uint32_t rxFrames;
+    uint32_t rxCycles;
+    uint32_t rxMaxCycles;
+    uint32_t txFrames;
+    uint32_t txCycles;
+    uint32_t txMaxCycles;
+} CAN_CycleStats_t;
+
+typedef enum {
+    CAN_STATE_ERROR_ACTIVE = 0,
+    CAN_STATE_ERROR_PASSIVE,
+    CAN_STATE_BUS_OFF
+} CAN_ErrorState_t;
+
+typedef enum {
+    CAN_BUSOFF_RECOVER_AUTO = 0,    // Hardware rejoins after 128 x 11 recessive bits (CTRL1[BOFFREC] = 0)
+    CAN_BUSOFF_RECOVER_DELAYED,     // Stay off the bus for the configured delay, then let hardware rejoin
+    CAN_BUSOFF_RECOVER_MANUAL       // Stay bus-off until FLEXCAN_recover_bus_off()
+} CAN_BusOffPolicy_t;
+
+typedef struct {
+    uint8_t state;              // CAN_ErrorState_t from ESR1[FLTCONF]
+    uint8_t tec;                // Transmit / receive error counters (ECR)
+    uint8_t rec;
+    uint32_t errorPassiveCount; // Transitions into error passive
+    uint32_t busOffCount;       // Bus-off events (ESR1[BOFFINT])
+    uint32_t busOffRecoveries;  // Completed bus-off recoveries (ESR1[BOFFDONEINT])
+    uint32_t stuffErrors;       // ESR1 error bits, one count per error interrupt that reports them
+    uint32_t formErrors;
+    uint32_t crcErrors;
+    uint32_t ackErrors;
+    uint32_t bit0Errors;
+    uint32_t bit1Errors;
+    uint32_t txTimeouts;        // TX mailboxes aborted after CAN_TX_TIMEOUT_MS
+} CAN_ErrorStats_t;
+
+// Driver state of one FlexCAN module: register base, vectors, mailbox layout,
+// RX ring, TX pool and error state. Defined in FlexCan.c.
+typedef struct CAN_Instance CAN_Instance_t;
+
+extern CAN_Instance_t can0Instance;
+#define CAN0_INST (&can0Instance)
+#if CAN1_ENABLE
+extern CAN_Instance_t can1Instance;
+#define CAN1_INST (&can1Instance)
+#endif
+#if CAN2_ENABLE
+extern CAN_Instance_t can2Instance;
+#define CAN2_INST (&can2Instance)
+#endif
+
+void FLEXCAN_init(CAN_Instance_t *can);
+int FLEXCAN_transmit_msg(CAN_Instance_t *can, const CAN_Message_t *msg);
+int FLEXCAN_transmit_async(CAN_Instance_t *can, const CAN_Message_t *msg, uint8_t prio,
+                           CAN_TxCallback_t callback, void *context);
+int FLEXCAN_receive_msg(CAN_Instance_t *can, CAN_Message_t *msg);
+const CAN_Message_t *FLEXCAN_rx_peek(CAN_Instance_t *can);
+void FLEXCAN_rx_release(CAN_Instance_t *can);
+uint32_t FLEXCAN_receive_batch(CAN_Instance_t *can, CAN_Message_t *msgs, uint32_t maxMsgs);
+uint32_t FLEXCAN_rx_pending(CAN_Instance_t *can);
+void FLEXCAN_get_rx_stats(CAN_Instance_t *can, CAN_RxStats_t *stats);
+void FLEXCAN_get_error_stats(CAN_Instance_t *can, CAN_ErrorStats_t *stats);
+#if CAN_CYCLE_STATS
+void FLEXCAN_get_cycle_stats(CAN_Instance_t *can, CAN_CycleStats_t *stats);
+#endif
+void FLEXCAN_set_bus_off_policy(CAN_Instance_t *can, CAN_BusOffPolicy_t policy, uint32_t delayMs);
+void FLEXCAN_recover_bus_off(CAN_Instance_t *can);
+void FLEXCAN_error_tick(CAN_Instance_t *can);
+int FLEXCAN_set_rx_filters(CAN_Instance_t *can, const CAN_RxFilter_t *filters, uint32_t count);
+int FLEXCAN_calc_bit_timing(uint32_t clkHz, uint32_t bitrate, uint32_t samplePoint,
+                            CAN_TimingFormat_t format, CAN_BitTiming_t *timing);
+int FLEXCAN_set_bitrate(CAN_Instance_t *can, uint32_t bitrate, uint32_t samplePoint);
+#if CAN_FD_ENABLE
+int FLEXCAN_set_data_bitrate(CAN_Instance_t *can, uint32_t bitrate, uint32_t samplePoint);
+#endif
+uint32_t FLEXCAN_autobaud(CAN_Instance_t *can, const uint32_t *rates, uint32_t count, uint32_t windowMs);
+uint32_t FLEXCAN_get_time(CAN_Instance_t *can);
+uint32_t FLEXCAN_ticks_to_us(CAN_Instance_t *can, uint32_t ticks);
+uint8_t FLEXCAN_dlc_to_len(uint8_t dlc);
+uint8_t FLEXCAN_len_to_dlc(uint8_t len);
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,138 @@
+/*
+ * @brief  In-RAM index of the DTCs this ECU supports and their status bytes.
+ *
+ * The status bytes are kept in one packed array parallel to the sorted list
+ * of supported DTCs, so a 0x19 status-mask query is a linear scan over a few
+ * bytes of RAM. NVM is only read when the index is (re)loaded and when a
+ * snapshot or extended data record is requested.
+ */
+
+#include "dtcidx.h"
+#include <string.h>
+
+_Static_assert(DTC_SLOT_SIZE >= DTC_SLOT_USED_LEN, "DTC slot too small for the index layout");
+
+/**
+ * @brief DTCs reported by 0x19 sub-function 0x0A. Must stay sorted.
+ */
+static const uint32_t dtcSupported[] = {
+    DTC_ENGINE_OVERHEAT,
+};
+
+#define DTCIDX_COUNT (sizeof(dtcSupported) / sizeof(dtcSupported[0]))
+
+static uint8_t dtcStatus[DTCIDX_COUNT];   /* statusOfDTC, 0 when not stored */
+static int8_t  dtcSlot[DTCIDX_COUNT];     /* NVM slot, -1 when not stored */
+
+/**
+ * @brief Rebuilds the index from the DTC slots in NVM, one read per slot.
+ *        Call at start-up and after DTCs were cleared.
+ */
+void DTCIDX_Load(void) {
+    uint8_t slot[DTC_SLOT_USED_LEN];
+
+    memset(dtcStatus, 0, sizeof(dtcStatus));
+    memset(dtcSlot, -1, sizeof(dtcSlot));
+
+    for (uint8_t i = 0; i < DTC_GetCount(); i++) {
+        uint32_t offset = DTC_REGION_OFFSET + (i * DTC_SLOT_SIZE);
+        if (NVM_Read(offset, slot, sizeof(slot)) != NVM_OK) {
+            continue;
+        }
+
+        uint32_t dtc = ((uint32_t)slot[DTC_SLOT_DTC_OFS] << 16) |
+                       ((uint32_t)slot[DTC_SLOT_DTC_OFS + 1] << 8) |
+                        slot[DTC_SLOT_DTC_OFS + 2];
+        int index = DTCIDX_Find(dtc);       /* Erased slots (0xFFFFFF) are not found */
+        if (index >= 0) {
+            dtcStatus[index] = slot[DTC_SLOT_STATUS_OFS];
+            dtcSlot[index] = (int8_t)i;
+        }
+    }
+}
+
+uint16_t DTCIDX_Count(void) {
+    return DTCIDX_COUNT;
+}
+
+uint32_t DTCIDX_Dtc(uint16_t index) {
+    return dtcSupported[index];
+}
+
+uint8_t DTCIDX_Status(uint16_t index) {
+    return dtcStatus[index] & DTC_STATUS_AVAILABILITY_MASK;
+}
+
+/**
+ * @brief Binary search of the supported DTCs.
+ * @return Index of dtc, or -1 if this ECU does not support it.
+ */
+int DTCIDX_Find(uint32_t dtc) {
+    uint32_t lo = 0;
+    uint32_t hi = DTCIDX_COUNT;
+
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2U;
+        if (dtcSupported[mid] == dtc) {
+            return (int)mid;
+        }
+        if (dtcSupported[mid] < dtc) {
+            lo = mid + 1U;
+        } else {
+            hi = mid;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief First index at or after from whose status matches mask.
+ * @return The index, or -1 if there is none.
+ */
+int DTCIDX_NextByMask(uint8_t mask, uint16_t from) {
+    mask &= DTC_STATUS_AVAILABILITY_MASK;
+    for (uint16_t i = from; i < DTCIDX_COUNT; i++) {
+        if (dtcStatus[i] & mask) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+uint16_t DTCIDX_CountByMask(uint8_t mask) {
+    uint16_t count = 0;
+
+    mask &= DTC_STATUS_AVAILABILITY_MASK;
+    for (uint16_t i = 0; i < DTCIDX_COUNT; i++) {
+        if (dtcStatus[i] & mask) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Reads the stored NVM slot of a DTC (DTC_SLOT_USED_LEN bytes).
+ * @return 0 on success, -1 if the DTC is not stored or the read failed.
+ */
+int DTCIDX_ReadSlot(uint16_t index, uint8_t *slot) {
+    if (dtcSlot[index] < 0) {
+        return -1;
+    }
+    uint32_t offset = DTC_REGION_OFFSET + ((uint32_t)dtcSlot[index] * DTC_SLOT_SIZE);
+    return (NVM_Read(offset, slot, DTC_SLOT_USED_LEN) == NVM_OK) ? 0 : -1;
+}
+
+/**
+ * @brief Keeps the index in step when the application stores a DTC status.
+ *        A DTC stored for the first time gets its slot from DTC_Find().
+ */
+void DTCIDX_SetStatus(uint32_t dtc, uint8_t status) {
+    int index = DTCIDX_Find(dtc);
+    if (index >= 0) {
+        dtcStatus[index] = status;
+        if (dtcSlot[index] < 0) {
+            dtcSlot[index] = DTC_Find(dtc);
+        }
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef DTCIDX_H_
+#define DTCIDX_H_
+
+#include <stdint.h>
+#include "dtc.h"
+
+// ===== DTC slot layout in NVM (DTC_SLOT_SIZE bytes per slot) =====
+#define DTC_SLOT_DTC_OFS         0U     // 24-bit DTC number, big-endian
+#define DTC_SLOT_STATUS_OFS      3U     // ISO 14229-1 statusOfDTC
+#define DTC_SLOT_SNAPSHOT_OFS    4U     // Snapshot record 0x01: DID_ENGINE_TEMP value, big-endian
+#define DTC_SLOT_SNAPSHOT_LEN    2U
+#define DTC_SLOT_OCCURRENCE_OFS  6U     // Extended data record 0x01: occurrence counter
+#define DTC_SLOT_USED_LEN        7U
+
+#define DTC_STATUS_AVAILABILITY_MASK  0xFFU  // statusOfDTC bits this ECU reports
+#define DTC_FORMAT_ISO14229_1         0x01U
+
+// ===== Function Prototypes =====
+void     DTCIDX_Load(void);
+uint16_t DTCIDX_Count(void);
+uint32_t DTCIDX_Dtc(uint16_t index);
+uint8_t  DTCIDX_Status(uint16_t index);
+int      DTCIDX_Find(uint32_t dtc);
+int      DTCIDX_NextByMask(uint8_t mask, uint16_t from);
+uint16_t DTCIDX_CountByMask(uint8_t mask);
+int      DTCIDX_ReadSlot(uint16_t index, uint8_t *slot);
+void     DTCIDX_SetStatus(uint32_t dtc, uint8_t status);
+
+#endif /* DTCIDX_H_ */
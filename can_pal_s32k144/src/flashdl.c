@@ -0,0 +1,301 @@
+/*
+ * @brief  Pipelined P-Flash download engine behind UDS 0x34/0x36/0x37.
+ *
+ * Received blocks go into FLASHDL_BUF_COUNT buffers. FLASHDL_Poll() programs
+ * the oldest one in FLASHDL_CHUNK pieces from the main loop, so the next
+ * block arrives over ISO-TP while the previous one is programmed. Sectors are
+ * erased ahead of the write pointer by FLASHDL_EraseStep(), which the UDS
+ * layer calls while the tester waits for a response and the bus is quiet.
+ *
+ * S32K144 has a single P-Flash block: code and interrupt handlers cannot be
+ * fetched while it is programmed or erased, so the CPU waits for every FTFC
+ * command in RAM with interrupts masked. That window is kept short instead of
+ * lasting a whole command:
+ * - programming goes one phrase (FEATURE_FLS_PF_BLOCK_WRITE_UNIT_SIZE bytes,
+ *   about 0.1 ms) per command, with interrupts open between phrases;
+ * - a sector erase (12 ms typical, over 100 ms worst case) is suspended by
+ *   the RAM wait hook as soon as an enabled interrupt is pending. The
+ *   handlers run from flash while the erase is suspended, then it resumes.
+ *
+ * The FTFC also runs the CSEc commands (SecurityAccess key checks) and the
+ * D-Flash writes of the NVM records. No command is launched while one of
+ * those is still running (CCIF clear): the FTFC would ignore it.
+ */
+
+#include "flashdl.h"
+#include "flash_driver.h"
+#include "interrupt_manager.h"
+#include <string.h>
+
+/* Runs from RAM while the flash is busy; see FLASH_DRV_CommandSequence() */
+START_FUNCTION_DECLARATION_RAMSECTION
+static void flashdlWaitHook(void)
+END_FUNCTION_DECLARATION_RAMSECTION
+
+static const flash_user_config_t flashUserConfig = {
+    .PFlashBase = 0x00000000UL,
+    .PFlashSize = FEATURE_FLS_PF_BLOCK_SIZE,
+    .DFlashBase = 0x10000000UL,
+    .EERAMBase  = 0x14000000UL,
+    .CallBack   = flashdlWaitHook,
+};
+
+#define FLASH_ERROR_BITS  (FTFx_FSTAT_MGSTAT0_MASK | FTFx_FSTAT_FPVIOL_MASK | \
+                           FTFx_FSTAT_ACCERR_MASK | FTFx_FSTAT_RDCOLERR_MASK)
+
+// Programmed flash as seen by the verify. Overridable, like the erase resume
+// below, so host tests can run this module on a modelled flash controller.
+#ifndef FLASHDL_FLASH_PTR
+#define FLASHDL_FLASH_PTR(address)  ((const void *)(uintptr_t)(address))
+#endif
+
+static flash_ssd_config_t flashSSDConfig;
+
+static uint8_t  dlBuf[FLASHDL_BUF_COUNT][FLASHDL_BLOCK_SIZE];
+static uint16_t dlLen[FLASHDL_BUF_COUNT];
+static uint32_t dlAddr[FLASHDL_BUF_COUNT];
+static uint8_t  dlHead;          /* Buffer being programmed */
+static uint8_t  dlCount;         /* Buffers holding data */
+static uint16_t dlProgOffset;    /* Bytes of the head buffer already programmed */
+
+static bool     dlActive;
+static bool     dlFailed;
+static uint32_t dlNext;          /* Address of the next pushed block */
+static uint32_t dlEnd;           /* End of the requested range */
+static uint32_t dlErasedEnd;     /* Sectors below this are erased */
+
+static volatile bool     dlErasing;     /* A sector erase may be suspended */
+static volatile uint32_t dlErasePolls;  /* Wait hook calls since the erase (re)started */
+
+/**
+ * @brief Called from the RAM wait loop of every FTFC command: requests an
+ *        erase suspend if any enabled interrupt is pending.
+ *
+ * A resumed erase runs FLASHDL_ERASE_MIN_POLLS polls before it can be
+ * suspended again, so it progresses under any interrupt load. Must not call
+ * anything outside RAM.
+ */
+static void flashdlWaitHook(void) {
+    if (!dlErasing) {
+        return;
+    }
+    if (dlErasePolls < FLASHDL_ERASE_MIN_POLLS) {
+        dlErasePolls++;
+        return;
+    }
+    for (uint32_t i = 0; i < S32_NVIC_ISPR_COUNT; i++) {
+        if ((S32_NVIC->ISER[i] & S32_NVIC->ISPR[i]) != 0U) {
+            FTFx_FCNFG |= FTFx_FCNFG_ERSSUSP_MASK;
+            return;
+        }
+    }
+}
+
+#ifndef FLASHDL_RESUME_ERASE
+START_FUNCTION_DECLARATION_RAMSECTION
+static void flashdlResumeErase(void)
+END_FUNCTION_DECLARATION_RAMSECTION
+
+/**
+ * @brief Relaunches a suspended erase (ERSSUSP still set) and waits in RAM
+ *        until it completes or is suspended again.
+ */
+static void flashdlResumeErase(void) {
+    FTFx_FSTAT = FTFx_FSTAT_CCIF_MASK;
+    while ((FTFx_FSTAT & FTFx_FSTAT_CCIF_MASK) == 0U) {
+        flashdlWaitHook();
+    }
+}
+#define FLASHDL_RESUME_ERASE()  flashdlResumeErase()
+#endif
+
+/* true if no FTFC or CSEc command is running */
+static bool ftfcIdle(void) {
+    return (FTFx_FSTAT & FTFx_FSTAT_CCIF_MASK) != 0U;
+}
+
+void FLASHDL_Init(void) {
+    (void)FLASH_DRV_Init(&flashUserConfig, &flashSSDConfig);
+}
+
+/**
+ * @brief Opens a download of size bytes at address.
+ *        The start must be sector aligned: erasing never touches bytes
+ *        outside the requested range below it.
+ * @return 0 on success, -1 if the range is not allowed.
+ */
+int FLASHDL_Begin(uint32_t address, uint32_t size) {
+    if (size == 0 || address < FLASHDL_START || address > FLASHDL_END ||
+        size > FLASHDL_END - address ||
+        (address % FEATURE_FLS_PF_BLOCK_SECTOR_SIZE) != 0) {
+        return -1;
+    }
+
+    dlActive = true;
+    dlFailed = false;
+    dlNext = address;
+    dlEnd = address + size;
+    dlErasedEnd = address;
+    dlHead = 0;
+    dlCount = 0;
+    dlProgOffset = 0;
+    return 0;
+}
+
+/**
+ * @brief Closes the download; blocks not yet programmed are dropped.
+ */
+void FLASHDL_End(void) {
+    dlActive = false;
+    dlCount = 0;
+}
+
+bool FLASHDL_Active(void) {
+    return dlActive;
+}
+
+/**
+ * @brief Erases the next sector if the erased area does not reach until yet.
+ * @return 0 once [.., until) is erased, 1 if more remain (a sector was
+ *         erased, or the FTFC is busy with another command), -1 on a flash
+ *         error.
+ */
+int FLASHDL_EraseStep(uint32_t until) {
+    status_t status;
+
+    if (until > dlEnd) {
+        until = dlEnd;
+    }
+    if (dlErasedEnd >= until) {
+        return 0;
+    }
+    if (!ftfcIdle()) {
+        return 1;
+    }
+
+    dlErasePolls = 0;
+    dlErasing = true;
+    INT_SYS_DisableIRQGlobal();
+    status = FLASH_DRV_EraseSector(&flashSSDConfig, dlErasedEnd, FEATURE_FLS_PF_BLOCK_SECTOR_SIZE);
+    INT_SYS_EnableIRQGlobal();
+
+    /* Suspended for a pending interrupt, which has just been served */
+    while (status == STATUS_SUCCESS && (FTFx_FCNFG & FTFx_FCNFG_ERSSUSP_MASK) != 0U) {
+        dlErasePolls = 0;
+        INT_SYS_DisableIRQGlobal();
+        FLASHDL_RESUME_ERASE();
+        INT_SYS_EnableIRQGlobal();
+        if ((FTFx_FSTAT & FLASH_ERROR_BITS) != 0U) {
+            status = STATUS_ERROR;
+        }
+    }
+    dlErasing = false;
+
+    if (status != STATUS_SUCCESS) {
+        dlFailed = true;
+        return -1;
+    }
+    dlErasedEnd += FEATURE_FLS_PF_BLOCK_SECTOR_SIZE;
+    return (dlErasedEnd >= until) ? 0 : 1;
+}
+
+uint32_t FLASHDL_NextAddress(void) {
+    return dlNext;
+}
+
+uint32_t FLASHDL_Remaining(void) {
+    return dlEnd - dlNext;
+}
+
+/**
+ * @brief Queues the next block. The tail of the last block is padded with
+ *        erased bytes up to the 8-byte program unit.
+ * @return 0 on success, -1 if no buffer is free, the block overruns the range
+ *         or a block before the last one is not a multiple of 8 bytes.
+ */
+int FLASHDL_Push(const uint8_t *data, uint16_t len) {
+    uint8_t slot;
+    uint16_t padded;
+
+    if (!dlActive || dlCount >= FLASHDL_BUF_COUNT || len == 0 ||
+        len > FLASHDL_BLOCK_SIZE || len > FLASHDL_Remaining()) {
+        return -1;
+    }
+    /* Only the last block may end off the program unit */
+    if ((len % FEATURE_FLS_PF_BLOCK_WRITE_UNIT_SIZE) != 0 && len != FLASHDL_Remaining()) {
+        return -1;
+    }
+
+    slot = (uint8_t)((dlHead + dlCount) % FLASHDL_BUF_COUNT);
+    padded = (uint16_t)((len + FEATURE_FLS_PF_BLOCK_WRITE_UNIT_SIZE - 1U) &
+                        ~(FEATURE_FLS_PF_BLOCK_WRITE_UNIT_SIZE - 1U));
+    memcpy(dlBuf[slot], data, len);
+    memset(&dlBuf[slot][len], 0xFF, padded - len);
+    dlLen[slot] = padded;
+    dlAddr[slot] = dlNext;
+    dlNext += len;
+    dlCount++;
+    return 0;
+}
+
+bool FLASHDL_BufferFree(void) {
+    return dlCount < FLASHDL_BUF_COUNT;
+}
+
+/**
+ * @brief true while received data is still waiting to be programmed.
+ */
+bool FLASHDL_Busy(void) {
+    return dlCount != 0;
+}
+
+bool FLASHDL_Failed(void) {
+    return dlFailed;
+}
+
+/**
+ * @brief Programs and verifies one chunk of the oldest buffer. Call from the
+ *        main loop; does nothing while the FTFC is busy with another command.
+ */
+void FLASHDL_Poll(void) {
+    uint32_t dest;
+    const uint8_t *src;
+    uint16_t n;
+    status_t status = STATUS_SUCCESS;
+
+    if (!dlActive || dlFailed || dlCount == 0 || !ftfcIdle()) {
+        return;
+    }
+
+    dest = dlAddr[dlHead] + dlProgOffset;
+    src = &dlBuf[dlHead][dlProgOffset];
+    n = dlLen[dlHead] - dlProgOffset;
+    if (n > FLASHDL_CHUNK) n = FLASHDL_CHUNK;
+
+    /* The UDS layer erases ahead; reaching unerased flash is a sequencing bug */
+    if (dest + n > dlErasedEnd) {
+        dlFailed = true;
+        return;
+    }
+
+    /* One phrase per command: interrupts are served between phrases */
+    for (uint16_t done = 0; done < n && status == STATUS_SUCCESS;
+         done += FEATURE_FLS_PF_BLOCK_WRITE_UNIT_SIZE) {
+        INT_SYS_DisableIRQGlobal();
+        status = FLASH_DRV_Program(&flashSSDConfig, dest + done,
+                                   FEATURE_FLS_PF_BLOCK_WRITE_UNIT_SIZE, &src[done]);
+        INT_SYS_EnableIRQGlobal();
+    }
+
+    if (status != STATUS_SUCCESS || memcmp(FLASHDL_FLASH_PTR(dest), src, n) != 0) {
+        dlFailed = true;
+        return;
+    }
+
+    dlProgOffset += n;
+    if (dlProgOffset >= dlLen[dlHead]) {
+        dlProgOffset = 0;
+        dlHead = (uint8_t)((dlHead + 1U) % FLASHDL_BUF_COUNT);
+        dlCount--;
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef FLASHDL_H_
+#define FLASHDL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// ===== Download area and pipeline =====
+#define FLASHDL_START        0x00040000UL  // P-Flash range RequestDownload may target
+#define FLASHDL_END          0x00080000UL
+#define FLASHDL_BLOCK_SIZE   1024U         // TransferData payload per block = one buffer, multiple of 8
+#define FLASHDL_BUF_COUNT    2U            // Block N is programmed while block N+1 is received
+#define FLASHDL_CHUNK        32U           // Bytes programmed per FLASHDL_Poll() call
+#define FLASHDL_ERASE_MIN_POLLS  200U      // Wait-loop polls a (resumed) erase runs before it may be suspended
+
+// ===== Function Prototypes =====
+void     FLASHDL_Init(void);
+int      FLASHDL_Begin(uint32_t address, uint32_t size);
+void     FLASHDL_End(void);
+bool     FLASHDL_Active(void);
+int      FLASHDL_EraseStep(uint32_t until);
+uint32_t FLASHDL_NextAddress(void);
+uint32_t FLASHDL_Remaining(void);
+int      FLASHDL_Push(const uint8_t *data, uint16_t len);
+bool     FLASHDL_BufferFree(void);
+bool     FLASHDL_Busy(void);
+bool     FLASHDL_Failed(void);
+void     FLASHDL_Poll(void);
+
+#endif /* FLASHDL_H_ */
@@ -0,0 +1,450 @@
+/*
+ * @brief  ISO 15765-2 (ISO-TP) transport on top of the FlexCAN driver.
+ *
+ * Classic CAN, normal addressing, unpadded frames. All protocol timing runs on
+ * the CAN time base (FLEXCAN_get_time), which resolves the 100..900 us STmin
+ * values; ISOTP_Tick() must be called from the main loop.
+ */
+
+#include "isotp.h"
+#include <string.h>
+
+/* Worst-case stuffed length of an 8-byte standard-ID data frame, in bit times.
+ * TX timestamps mark the start of frame; STmin counts from its end. */
+#define ISOTP_CF_FRAME_BITS  132UL
+
+static uint32_t elapsedUs(ISOTP_Link_t *link, uint32_t start) {
+    return FLEXCAN_ticks_to_us(link->can, FLEXCAN_get_time(link->can) - start);
+}
+
+/**
+ * @brief Converts the FC STmin byte to microseconds.
+ *        Reserved values are treated as the longest valid STmin (127 ms).
+ */
+static uint32_t decodeStMin(uint8_t raw) {
+    if (raw <= 0x7F) {
+        return raw * 1000UL;
+    }
+    if (raw >= 0xF1 && raw <= 0xF9) {
+        return (raw - 0xF0) * 100UL;
+    }
+    return 127000UL;
+}
+
+/**
+ * @brief CAN TX callback, runs in the FlexCAN interrupt.
+ */
+static void onTxConfirm(const CAN_Message_t *msg, int status, void *context) {
+    ISOTP_Link_t *link = (ISOTP_Link_t *)context;
+
+    link->txConfStatus = (int8_t)status;
+    link->txConfTime = msg->timestamp;
+    link->txConfirmed = 1;
+}
+
+static void finish(ISOTP_Link_t *link, ISOTP_Result_t result) {
+    link->txState = ISOTP_TX_IDLE;
+    if (link->txDone != NULL) {
+        link->txDone(link, result);
+    }
+}
+
+/**
+ * @brief Fetches len payload bytes at offset, from the caller's buffer or,
+ *        for a streamed transfer, from its fill callback.
+ * @return 0, or the ISOTP_TxFill_t result that kept the bytes back.
+ */
+static int readPayload(ISOTP_Link_t *link, uint16_t offset, uint8_t *dst, uint16_t len) {
+    if (link->txFill != NULL) {
+        return link->txFill(link->txFillCtx, offset, dst, len);
+    }
+    memcpy(dst, &link->txData[offset], len);
+    return 0;
+}
+
+static int queueFrame(ISOTP_Link_t *link, const uint8_t *bytes, uint8_t len) {
+    CAN_Message_t msg = {0};
+
+    msg.canID = link->txId;
+    msg.dlc   = len;
+    memcpy(msg.data, bytes, len);
+
+    link->txConfirmed = 0;
+    if (FLEXCAN_transmit_async(link->can, &msg, TX_PRIO_DEFAULT, onTxConfirm, link) != 0) {
+        return -1;
+    }
+    link->txState = ISOTP_TX_WAIT_CONF;
+    link->timerStart = FLEXCAN_get_time(link->can);
+    return 0;
+}
+
+/**
+ * @brief Queues the next Consecutive Frame. If the CAN queue is full or the
+ *        payload source is not ready, the frame is retried on the next tick
+ *        until N_Cs runs out.
+ */
+static void sendConsecutive(ISOTP_Link_t *link) {
+    uint8_t frame[8];
+    uint16_t n = link->txLen - link->txOffset;
+    int fill;
+
+    if (n > 7) n = 7;
+    frame[0] = (uint8_t)((ISOTP_PCI_CF << 4) | link->txSn);
+    fill = readPayload(link, link->txOffset, &frame[1], n);
+
+    if (fill == ISOTP_FILL_ERROR) {
+        finish(link, ISOTP_SOURCE_ERROR);
+    } else if (fill == 0 && queueFrame(link, frame, (uint8_t)(n + 1)) == 0) {
+        link->txOffset += n;
+        link->txSn = (link->txSn + 1) & 0x0F;
+        if (link->blockSize != 0) {
+            link->blockLeft--;
+        }
+    } else if (elapsedUs(link, link->timerStart) >= ISOTP_N_CS_MS * 1000UL) {
+        finish(link, ISOTP_TIMEOUT_CS);
+    }
+}
+
+/**
+ * @brief Moves on once the CAN driver has confirmed (or aborted) the last frame.
+ */
+static void handleConfirmation(ISOTP_Link_t *link) {
+    uint32_t now;
+    uint32_t ref;
+
+    if (link->txState != ISOTP_TX_WAIT_CONF || !link->txConfirmed) {
+        return;
+    }
+    link->txConfirmed = 0;
+
+    if (link->txConfStatus != CAN_TX_OK) {
+        finish(link, ISOTP_TIMEOUT_A);
+        return;
+    }
+    if (link->txOffset >= link->txLen) {
+        finish(link, ISOTP_OK);
+        return;
+    }
+
+    now = FLEXCAN_get_time(link->can);
+    if (link->blockSize != 0 && link->blockLeft == 0) {
+        link->txState = ISOTP_TX_WAIT_FC;
+        link->timerStart = now;
+        return;
+    }
+
+    /* STmin (and N_Cs) count from the end of the confirmed CF */
+    ref = link->txConfTime + ISOTP_CF_FRAME_BITS;
+    if ((int32_t)(now - ref) < 0) ref = now;
+    link->txState = ISOTP_TX_WAIT_STMIN;
+    link->timerStart = ref;
+}
+
+/**
+ * @brief Sends the first frame of a transfer whose source is already set up.
+ */
+static int startTransfer(ISOTP_Link_t *link, uint16_t len) {
+    uint8_t frame[8];
+
+    link->txLen = len;
+
+    if (len <= 7) {
+        frame[0] = (uint8_t)((ISOTP_PCI_SF << 4) | len);
+        if (readPayload(link, 0, &frame[1], len) != 0) {
+            return -1;
+        }
+        link->txOffset = len;
+        return queueFrame(link, frame, (uint8_t)(len + 1));
+    }
+
+    frame[0] = (uint8_t)((ISOTP_PCI_FF << 4) | (len >> 8));
+    frame[1] = (uint8_t)len;
+    if (readPayload(link, 0, &frame[2], 6) != 0) {
+        return -1;
+    }
+    link->txOffset = 6;
+    link->txSn = 1;
+    link->wftCount = 0;
+    /* Until the first FC arrives, behave as if a block had just ended */
+    link->blockSize = 1;
+    link->blockLeft = 0;
+    return queueFrame(link, frame, 8);
+}
+
+/**
+ * @brief Starts a transfer: a Single Frame for up to 7 bytes, otherwise a First
+ *        Frame followed by Consecutive Frames paced by the receiver's Flow Control.
+ *
+ * @param data Payload; must stay untouched until the link is idle again.
+ * @return 0 if the first frame was queued, -1 if busy, too long or the CAN queue is full.
+ */
+int ISOTP_Send(ISOTP_Link_t *link, const uint8_t *data, uint16_t len) {
+    if (link->txState != ISOTP_TX_IDLE || len == 0 || len > ISOTP_MAX_LEN) {
+        return -1;
+    }
+
+    link->txData = data;
+    link->txFill = NULL;
+    return startTransfer(link, len);
+}
+
+/**
+ * @brief Like ISOTP_Send(), but the payload is pulled from fill() as each
+ *        frame is built, so no buffer of len bytes is needed.
+ *
+ * fill() may be asked for the same offset again when a frame has to be
+ * retried, so it must return the same bytes for the same offset. The first
+ * frame is built right away: a source that is not ready for it yet fails
+ * the call.
+ */
+int ISOTP_SendStream(ISOTP_Link_t *link, uint16_t len, ISOTP_TxFill_t fill, void *context) {
+    if (link->txState != ISOTP_TX_IDLE || len == 0 || len > ISOTP_MAX_LEN || fill == NULL) {
+        return -1;
+    }
+
+    link->txData = NULL;
+    link->txFill = fill;
+    link->txFillCtx = context;
+    return startTransfer(link, len);
+}
+
+/**
+ * @brief Processes a Flow Control from the peer while a segmented send runs.
+ */
+static void handleFlowControl(ISOTP_Link_t *link, const CAN_Message_t *msg) {
+    /* The FC may overtake the tick that would have processed our FF confirmation */
+    handleConfirmation(link);
+
+    /* Unexpected or truncated FC is ignored */
+    if (link->txState != ISOTP_TX_WAIT_FC || msg->dlc < 3) {
+        return;
+    }
+
+    switch (msg->data[0] & 0x0F) {
+        case ISOTP_FS_CTS:
+            link->blockSize = msg->data[1];
+            link->blockLeft = msg->data[1];
+            link->stMinUs = decodeStMin(msg->data[2]);
+            link->wftCount = 0;
+            /* First CF of a block goes out without STmin */
+            link->txState = ISOTP_TX_WAIT_STMIN;
+            link->timerStart = FLEXCAN_get_time(link->can);
+            sendConsecutive(link);
+            break;
+
+        case ISOTP_FS_WAIT:
+            if (++link->wftCount > ISOTP_WFT_MAX) {
+                finish(link, ISOTP_WFT_OVRN);
+            } else {
+                link->timerStart = FLEXCAN_get_time(link->can);   /* Restart N_Bs */
+            }
+            break;
+
+        case ISOTP_FS_OVFLW:
+            finish(link, ISOTP_BUFFER_OVFLW);
+            break;
+
+        default:
+            finish(link, ISOTP_INVALID_FS);
+            break;
+    }
+}
+
+/**
+ * @brief Sends our Flow Control for the transfer being reassembled.
+ *
+ * The reassembly buffer always holds the whole PDU, so the scarce resource is
+ * the driver's RX ring between ISR and main loop: one block may fill at most
+ * half of its free slots, and STmin throttles the sender once it is half full. A frame the
+ * TX queue has no room for is retried from ISOTP_Tick() until N_Cr runs out.
+ */
+static void sendFlowControl(ISOTP_Link_t *link, uint8_t flowStatus) {
+    CAN_Message_t msg = {0};
+    uint32_t freeSlots = RX_RING_SIZE - FLEXCAN_rx_pending(link->can);
+    uint32_t cfLeft = (link->rxLen - link->rxOffset + 6U) / 7U;
+    uint32_t room = freeSlots / 2U;
+    uint8_t bs = 0;
+    uint8_t stMin = 0;
+
+    if (flowStatus == ISOTP_FS_CTS) {
+        if (room == 0) room = 1;
+        if (room < cfLeft) bs = (uint8_t)room;
+        if (freeSlots < RX_RING_SIZE / 2U) stMin = ISOTP_RX_STMIN_BUSY;
+        link->rxBlockLeft = bs;
+    }
+
+    msg.canID   = link->txId;
+    msg.dlc     = 3;
+    msg.data[0] = (uint8_t)((ISOTP_PCI_FC << 4) | flowStatus);
+    msg.data[1] = bs;
+    msg.data[2] = stMin;
+    /* Without it the sender never goes on: ISOTP_Tick() tries again */
+    link->rxFcPending = (FLEXCAN_transmit_msg(link->can, &msg) == 0) ? 0U : (uint8_t)(flowStatus + 1U);
+}
+
+/**
+ * @brief Points *pdu / *pduLen at the payload of a valid Single Frame.
+ * @return 1 for a Single Frame of 1..7 bytes, 0 otherwise.
+ */
+static int parseSingleFrame(const CAN_Message_t *msg, const uint8_t **pdu, uint16_t *pduLen) {
+    uint16_t len = msg->data[0] & 0x0F;
+
+    if ((msg->data[0] >> 4) != ISOTP_PCI_SF || len == 0 || len > 7 || msg->dlc < len + 1U) {
+        return 0;
+    }
+    *pdu = &msg->data[1];
+    *pduLen = len;
+    return 1;
+}
+
+/**
+ * @brief Offers a received frame to the link.
+ *
+ * Flow Control frames drive the sender; SF/FF/CF drive reassembly. A Single
+ * Frame is returned in place (pointing into msg), a segmented request as
+ * rxBuf, so the request is never copied again on its way to the dispatcher.
+ *
+ * @return 1 if *pdu / *pduLen now describe a complete request, 0 otherwise.
+ */
+int ISOTP_OnFrame(ISOTP_Link_t *link, const CAN_Message_t *msg,
+                  const uint8_t **pdu, uint16_t *pduLen) {
+    uint16_t len;
+
+    if (msg->dlc < 1) {
+        return 0;
+    }
+
+    switch (msg->data[0] >> 4) {
+        case ISOTP_PCI_FC:
+            if (msg->canID == link->rxId) {
+                handleFlowControl(link, msg);
+            }
+            return 0;
+
+        case ISOTP_PCI_SF:
+            if (!parseSingleFrame(msg, pdu, pduLen)) {
+                return 0;
+            }
+            /* A new request terminates any reassembly in progress */
+            link->rxState = ISOTP_RX_IDLE;
+            link->rxFcPending = 0;
+            return 1;
+
+        case ISOTP_PCI_FF:
+            len = (uint16_t)(((msg->data[0] & 0x0F) << 8) | msg->data[1]);
+            if (msg->canID == link->funcId || msg->dlc < 8 || len < 8) {
+                return 0;
+            }
+            link->rxState = ISOTP_RX_IDLE;
+            link->rxPeerId = msg->canID;
+            link->rxLen = len;
+            link->rxOffset = 6;
+            link->rxTimerStart = FLEXCAN_get_time(link->can);
+            if (len > link->rxBufSize) {
+                sendFlowControl(link, ISOTP_FS_OVFLW);
+                return 0;
+            }
+            memcpy(link->rxBuf, &msg->data[2], 6);
+            link->rxSn = 1;
+            link->rxState = ISOTP_RX_RECEIVING;
+            sendFlowControl(link, ISOTP_FS_CTS);
+            return 0;
+
+        case ISOTP_PCI_CF:
+            if (link->rxState != ISOTP_RX_RECEIVING || msg->canID != link->rxPeerId) {
+                return 0;
+            }
+            len = link->rxLen - link->rxOffset;
+            if (len > 7) len = 7;
+            if ((msg->data[0] & 0x0F) != link->rxSn || msg->dlc < len + 1U) {
+                link->rxState = ISOTP_RX_IDLE;      /* Wrong SN: abort reception */
+                return 0;
+            }
+            memcpy(&link->rxBuf[link->rxOffset], &msg->data[1], len);
+            link->rxOffset += len;
+            link->rxSn = (link->rxSn + 1) & 0x0F;
+            link->rxTimerStart = FLEXCAN_get_time(link->can);
+
+            if (link->rxOffset >= link->rxLen) {
+                link->rxState = ISOTP_RX_IDLE;
+                *pdu = link->rxBuf;
+                *pduLen = link->rxLen;
+                return 1;
+            }
+            if (link->rxBlockLeft != 0 && --link->rxBlockLeft == 0) {
+                sendFlowControl(link, ISOTP_FS_CTS);
+            }
+            return 0;
+
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Offers a frame received on the functional identifier.
+ *
+ * Functional requests are Single Frames only (ISO 15765-2): anything else is
+ * ignored, and no link state is read or written, so a functional request can
+ * arrive in the middle of a physical reassembly or segmented response.
+ *
+ * @return 1 if *pdu / *pduLen now describe a request, 0 otherwise.
+ */
+int ISOTP_OnFunctionalFrame(const ISOTP_Link_t *link, const CAN_Message_t *msg,
+                            const uint8_t **pdu, uint16_t *pduLen) {
+    if (msg->canID != link->funcId || msg->dlc < 1) {
+        return 0;
+    }
+    return parseSingleFrame(msg, pdu, pduLen);
+}
+
+/**
+ * @brief Drives timeouts, CF pacing and Flow Control retries. Call from the main loop.
+ */
+void ISOTP_Tick(ISOTP_Link_t *link) {
+    handleConfirmation(link);
+
+    if (link->rxState == ISOTP_RX_RECEIVING &&
+        elapsedUs(link, link->rxTimerStart) >= ISOTP_N_CR_MS * 1000UL) {
+        link->rxState = ISOTP_RX_IDLE;
+    }
+
+    /* An FC the TX queue refused: a CTS only while its reception is alive */
+    if (link->rxFcPending != 0) {
+        uint8_t flowStatus = (uint8_t)(link->rxFcPending - 1U);
+
+        if (elapsedUs(link, link->rxTimerStart) >= ISOTP_N_CR_MS * 1000UL ||
+            (flowStatus == ISOTP_FS_CTS && link->rxState != ISOTP_RX_RECEIVING)) {
+            link->rxFcPending = 0;
+        } else {
+            sendFlowControl(link, flowStatus);
+        }
+    }
+
+    switch (link->txState) {
+        case ISOTP_TX_WAIT_CONF:
+            if (elapsedUs(link, link->timerStart) >= ISOTP_N_AS_MS * 1000UL) {
+                finish(link, ISOTP_TIMEOUT_A);
+            }
+            break;
+
+        case ISOTP_TX_WAIT_FC:
+            if (elapsedUs(link, link->timerStart) >= ISOTP_N_BS_MS * 1000UL) {
+                finish(link, ISOTP_TIMEOUT_BS);
+            }
+            break;
+
+        case ISOTP_TX_WAIT_STMIN:
+            if (elapsedUs(link, link->timerStart) >= link->stMinUs) {
+                sendConsecutive(link);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+int ISOTP_IsBusy(const ISOTP_Link_t *link) {
+    return link->txState != ISOTP_TX_IDLE;
+}
@@ -0,0 +1,113 @@
+#ifndef ISOTP_H_
+#define ISOTP_H_
+
+#include <stdint.h>
+#include "FlexCan.h"
+
+// ===== ISO 15765-2 parameters =====
+#define ISOTP_MAX_LEN        4095U   // 12-bit FF_DL, no escape sequence
+#define ISOTP_N_AS_MS        1000UL  // Sender: frame handed to CAN until TX confirmation
+#define ISOTP_N_BS_MS        1000UL  // Sender: FF/last CF of a block until Flow Control
+#define ISOTP_N_CS_MS        900UL   // Sender: FC or CF confirmation until next CF is queued
+#define ISOTP_WFT_MAX        10U     // FC.WAIT frames accepted in a row before giving up
+#define ISOTP_N_CR_MS        1000UL  // Receiver: FC or CF until the next CF
+#define ISOTP_RX_STMIN_BUSY  0x01U   // FC STmin (1 ms) while the CAN RX ring is over half full
+
+// ===== Protocol Control Information =====
+#define ISOTP_PCI_SF         0x0U
+#define ISOTP_PCI_FF         0x1U
+#define ISOTP_PCI_CF         0x2U
+#define ISOTP_PCI_FC         0x3U
+
+#define ISOTP_FS_CTS         0x0U
+#define ISOTP_FS_WAIT        0x1U
+#define ISOTP_FS_OVFLW       0x2U
+
+/**
+ * @brief Outcome of a transfer, reported through ISOTP_TxDone_t.
+ */
+typedef enum {
+    ISOTP_OK = 0,
+    ISOTP_TIMEOUT_A,        /* TX confirmation missing or frame aborted by the driver */
+    ISOTP_TIMEOUT_BS,       /* No Flow Control in time */
+    ISOTP_TIMEOUT_CS,       /* Next CF could not be queued in time */
+    ISOTP_INVALID_FS,       /* Unknown FlowStatus */
+    ISOTP_WFT_OVRN,         /* More than ISOTP_WFT_MAX FC.WAIT */
+    ISOTP_BUFFER_OVFLW,     /* Receiver answered FC.OVFLW */
+    ISOTP_SOURCE_ERROR      /* Streamed payload source failed */
+} ISOTP_Result_t;
+
+typedef enum {
+    ISOTP_TX_IDLE = 0,
+    ISOTP_TX_WAIT_CONF,     /* Frame queued, waiting for the CAN TX callback */
+    ISOTP_TX_WAIT_FC,       /* FF or last CF of a block sent, waiting for Flow Control */
+    ISOTP_TX_WAIT_STMIN     /* Next CF due once STmin has passed */
+} ISOTP_TxState_t;
+
+typedef enum {
+    ISOTP_RX_IDLE = 0,
+    ISOTP_RX_RECEIVING      /* FF accepted, collecting CFs into rxBuf */
+} ISOTP_RxState_t;
+
+struct ISOTP_Link;
+typedef void (*ISOTP_TxDone_t)(struct ISOTP_Link *link, ISOTP_Result_t result);
+
+/* Streamed payload source: writes exactly len bytes starting at offset into dst.
+ * Returns 0, ISOTP_FILL_NOT_READY to have the frame retried on a later tick
+ * (until N_Cs runs out), or ISOTP_FILL_ERROR to abort the transfer. */
+#define ISOTP_FILL_NOT_READY  1
+#define ISOTP_FILL_ERROR      (-1)
+typedef int (*ISOTP_TxFill_t)(void *context, uint16_t offset, uint8_t *dst, uint16_t len);
+
+/**
+ * @brief One ISO-TP connection (a pair of CAN identifiers on one FlexCAN instance).
+ *
+ * can, txId, rxId, funcId, rxBuf, rxBufSize and txDone are configuration;
+ * the rest is engine state.
+ */
+typedef struct ISOTP_Link {
+    CAN_Instance_t *can;
+    uint32_t        txId;          /* Identifier of our SF/FF/CF */
+    uint32_t        rxId;          /* Identifier the peer sends Flow Control on */
+    uint32_t        funcId;        /* Functional request identifier, Single Frames only */
+    uint8_t        *rxBuf;         /* Reassembly buffer for multi-frame requests */
+    uint16_t        rxBufSize;
+    ISOTP_TxDone_t  txDone;        /* Optional, called from ISOTP_Tick() */
+
+    ISOTP_TxState_t txState;
+    const uint8_t  *txData;        /* Caller's buffer, must stay valid until txDone */
+    ISOTP_TxFill_t  txFill;        /* Or the streamed source of ISOTP_SendStream() */
+    void           *txFillCtx;
+    uint16_t        txLen;
+    uint16_t        txOffset;      /* Bytes already segmented */
+    uint8_t         txSn;          /* Next sequence number */
+    uint8_t         blockSize;     /* From the last FC.CTS, 0 = no further FC */
+    uint8_t         blockLeft;     /* CFs left before the next FC */
+    uint8_t         wftCount;
+    uint32_t        stMinUs;
+    uint32_t        timerStart;    /* CAN time the running N_As/N_Bs/N_Cs/STmin started */
+    volatile uint8_t  txConfirmed; /* Set by the CAN TX callback */
+    volatile int8_t   txConfStatus;
+    volatile uint32_t txConfTime;  /* Frame start timestamp of the confirmed frame */
+
+    ISOTP_RxState_t rxState;
+    uint32_t        rxPeerId;      /* Sender of the FF being reassembled */
+    uint16_t        rxLen;
+    uint16_t        rxOffset;
+    uint8_t         rxSn;
+    uint8_t         rxBlockLeft;   /* CFs until we send the next FC, 0 = none */
+    uint8_t         rxFcPending;   /* Flow status + 1 of an FC the TX queue refused, 0 = none */
+    uint32_t        rxTimerStart;  /* N_Cr */
+} ISOTP_Link_t;
+
+// ===== Function Prototypes =====
+int  ISOTP_Send(ISOTP_Link_t *link, const uint8_t *data, uint16_t len);
+int  ISOTP_SendStream(ISOTP_Link_t *link, uint16_t len, ISOTP_TxFill_t fill, void *context);
+int  ISOTP_OnFrame(ISOTP_Link_t *link, const CAN_Message_t *msg,
+                   const uint8_t **pdu, uint16_t *pduLen);
+int  ISOTP_OnFunctionalFrame(const ISOTP_Link_t *link, const CAN_Message_t *msg,
+                             const uint8_t **pdu, uint16_t *pduLen);
+void ISOTP_Tick(ISOTP_Link_t *link);
+int  ISOTP_IsBusy(const ISOTP_Link_t *link);
+
+#endif /* ISOTP_H_ */
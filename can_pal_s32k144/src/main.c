@@ -6,9 +6,23 @@
 #include "adc_pal_cfg.h"
 #include <uds.h>
 #include "adc.h"
+#include "seca.h"
+#include "dtcidx.h"
+#include "flashdl.h"
+#include "memrd.h"
+#include "periodic.h"
 
 volatile int exit_code = 0;
 
+/* Diagnostic server on the ECU's physical address; further servers (e.g. gateway
+ * proxies on RX_GW_MSG_ID..) get their own buffer and are fed the same frames */
+static uint8_t udsRxBuf[ISOTP_MAX_LEN];
+static UDS_Server_t udsServer = UDS_SERVER_INIT(CAN0_INST, RX_MSG_ID, TX_MSG_ID_UDS, udsRxBuf);
+
+#if CAN_AUTOBAUD_ENABLE
+static const uint32_t canAutobaudRates[] = { 500000UL, 250000UL, 1000000UL };
+#endif
+
 void BoardInit(void)
 {
     CLOCK_DRV_Init(&clockMan1_InitConfig0);
@@ -20,15 +34,47 @@ void BoardInit(void)
 int main(void)
 {
     BoardInit();
-    FLEXCAN0_init();
+    SECA_Init();
+    DTCIDX_Load();
+    UDS_RestoreDddids();
+    FLASHDL_Init();
+    MEMRD_Init();
+    MEMRD_Protect(udsServer.secSeed, sizeof(udsServer.secSeed));  // Not readable by 0x23
+    PERIODIC_Init();
+    FLEXCAN_init(CAN0_INST);
+#if CAN_AUTOBAUD_ENABLE
+    (void)FLEXCAN_autobaud(CAN0_INST, canAutobaudRates, sizeof(canAutobaudRates) / sizeof(canAutobaudRates[0]),
+                           CAN_AUTOBAUD_WINDOW_MS);
+#endif
+#if CAN1_ENABLE
+    FLEXCAN_init(CAN1_INST);
+#endif
+#if CAN2_ENABLE
+    FLEXCAN_init(CAN2_INST);
+#endif
 
-    CAN_Message_t msg_rx;
+    CAN_Message_t msg_rx[RX_BATCH_MAX];
     while (1)
     {
+        uint32_t count = FLEXCAN_receive_batch(CAN0_INST, msg_rx, RX_BATCH_MAX);
 
-        if (FLEXCAN0_receive_msg(&msg_rx)) {
-            UDS_DispatchService(msg_rx);
+        // Error bookkeeping, TX timeouts and bus-off recovery; also keeps the
+        // 32-bit CAN time base ticking while the bus is quiet
+        FLEXCAN_error_tick(CAN0_INST);
+#if CAN1_ENABLE
+        FLEXCAN_error_tick(CAN1_INST);
+#endif
+#if CAN2_ENABLE
+        FLEXCAN_error_tick(CAN2_INST);
+#endif
+
+        for (uint32_t i = 0; i < count; i++) {
+            UDS_OnFrame(&udsServer, &msg_rx[i]);
         }
+        UDS_Tick(&udsServer);
+
+        // Programs one chunk of a received 0x36 block, if any
+        FLASHDL_Poll();
     }
     return exit_code;
 }
\ No newline at end of file
@@ -0,0 +1,268 @@
+/*
+ * @brief  Memory source of UDS 0x23 (ReadMemoryByAddress), staged by eDMA.
+ *
+ * The requested range is split into MEMRD_STAGE_SIZE windows. Window k is
+ * copied by a memory-to-memory eDMA transfer into staging buffer k % 2; when
+ * the ISO-TP sender first asks for bytes of window k, the transfer of window
+ * k + 1 is started into the other buffer. The CPU only copies the 7 bytes of
+ * each Consecutive Frame out of a staging buffer.
+ *
+ * Nothing here waits for the eDMA: a window still in flight is reported as
+ * MEMRD_BUSY and the caller asks again on its next tick; a failed transfer
+ * is reported as MEMRD_ERROR, never papered over by a CPU copy.
+ *
+ * There is one eDMA channel and one stream. It belongs to the server that
+ * opened it until that server releases it; another server's 0x23 is
+ * refused meanwhile, its owner's next 0x23 restarts it.
+ */
+
+#include "memrd.h"
+#include "edma_driver.h"
+#include <string.h>
+
+/**
+ * @brief Ranges 0x23 may read: P-Flash, FlexNVM (D-Flash) and SRAM_L + SRAM_U.
+ *        P-Flash skips the flash configuration field (backdoor key, FPROT,
+ *        FSEC); secrets in SRAM are hidden with MEMRD_Protect().
+ */
+static const struct {
+    uint32_t start;
+    uint32_t end;
+} memrdRegions[] = {
+    { 0x00000000UL, 0x00000400UL },
+    { 0x00000410UL, 0x00080000UL },
+    { 0x10000000UL, 0x10010000UL },
+    { 0x1FFF8000UL, 0x20007000UL },
+};
+
+static struct {
+    uint32_t start;
+    uint32_t size;
+} memrdProtected[MEMRD_PROTECT_MAX];
+static uint8_t memrdProtectedCount;
+
+static void onStageDone(void *parameter, edma_chn_status_t status);
+
+static edma_state_t edmaState;
+static edma_chn_state_t memrdChnState;
+static edma_chn_state_t * const memrdChnStates[] = { &memrdChnState };
+
+static const edma_user_config_t edmaUserConfig = {
+    .chnArbitration = EDMA_ARBITRATION_FIXED_PRIORITY,
+    .haltOnError    = false,
+};
+
+static const edma_channel_config_t memrdChnConfig = {
+    .channelPriority = EDMA_CHN_DEFAULT_PRIORITY,
+    .virtChnConfig   = MEMRD_DMA_CHANNEL,
+    .source          = EDMA_REQ_DISABLED,       /* Started by software request */
+    .callback        = onStageDone,
+    .callbackParam   = NULL,
+    .enableTrigger   = false,
+};
+static const edma_channel_config_t * const memrdChnConfigs[] = { &memrdChnConfig };
+
+static uint32_t stageBuf[2][MEMRD_STAGE_SIZE / 4U];  /* Word aligned for 4-byte transfers */
+static int32_t  stageWindow[2];      /* Window held by each buffer, -1 = none */
+static volatile bool stageDone[2];   /* Set by the eDMA completion interrupt */
+static volatile bool stageError[2];
+static uint8_t  dmaBuf;              /* Buffer of the last started transfer */
+static int32_t  lastWindow;          /* Window the sender asked for last */
+
+static const void *rdOwner;          /* Server holding the stream, NULL = free */
+static uint32_t rdAddress;
+static uint32_t rdSize;
+
+static void onStageDone(void *parameter, edma_chn_status_t status) {
+    (void)parameter;
+    stageError[dmaBuf] = (status != EDMA_CHN_NORMAL);
+    stageDone[dmaBuf] = true;
+}
+
+void MEMRD_Init(void) {
+    (void)EDMA_DRV_Init(&edmaState, &edmaUserConfig, memrdChnStates, memrdChnConfigs, 1U);
+    stageDone[0] = true;
+    stageDone[1] = true;
+    rdOwner = NULL;
+}
+
+/**
+ * @brief Hides [start, start + size) from MEMRD_IsReadable(), for state such
+ *        as the CSEc driver context or SecurityAccess seeds. Call at init;
+ *        a range already hidden is not added twice, ranges beyond
+ *        MEMRD_PROTECT_MAX are ignored.
+ */
+void MEMRD_Protect(const void *start, uint32_t size) {
+    uint32_t address = (uint32_t)(uintptr_t)start;
+
+    for (uint32_t i = 0; i < memrdProtectedCount; i++) {
+        if (memrdProtected[i].start == address && memrdProtected[i].size == size) {
+            return;
+        }
+    }
+    if (memrdProtectedCount < MEMRD_PROTECT_MAX && size != 0U) {
+        memrdProtected[memrdProtectedCount].start = address;
+        memrdProtected[memrdProtectedCount].size = size;
+        memrdProtectedCount++;
+    }
+}
+
+/**
+ * @brief true if [address, address + size) lies inside one readable region
+ *        and overlaps no protected range.
+ */
+bool MEMRD_IsReadable(uint32_t address, uint32_t size) {
+    bool inside = false;
+
+    for (uint32_t i = 0; i < sizeof(memrdRegions) / sizeof(memrdRegions[0]); i++) {
+        if (address >= memrdRegions[i].start && address < memrdRegions[i].end &&
+            size <= memrdRegions[i].end - address) {
+            inside = true;
+            break;
+        }
+    }
+    for (uint32_t i = 0; inside && i < memrdProtectedCount; i++) {
+        if (address - memrdProtected[i].start < memrdProtected[i].size ||
+            memrdProtected[i].start - address < size) {
+            inside = false;
+        }
+    }
+    return inside;
+}
+
+/**
+ * @brief Starts the eDMA copy of window w into buffer w % 2.
+ *        Word transfers are used when source and length allow them.
+ * @return false if the channel is still busy with another window.
+ */
+static bool startStage(int32_t w) {
+    uint8_t b = (uint8_t)(w % 2);
+    uint32_t from = (uint32_t)w * MEMRD_STAGE_SIZE;
+    uint32_t src = rdAddress + from;
+    uint32_t n;
+    edma_transfer_size_t size;
+
+    if (from >= rdSize) {
+        return true;
+    }
+    n = rdSize - from;
+    if (n > MEMRD_STAGE_SIZE) n = MEMRD_STAGE_SIZE;
+
+    /* One transfer at a time on the channel */
+    if (!stageDone[dmaBuf]) {
+        return false;
+    }
+
+    size = (((src | n) & 3U) == 0U) ? EDMA_TRANSFER_SIZE_4B : EDMA_TRANSFER_SIZE_1B;
+    stageWindow[b] = w;
+    stageError[b] = false;
+    stageDone[b] = false;
+    dmaBuf = b;
+
+    if (EDMA_DRV_ConfigSingleBlockTransfer(MEMRD_DMA_CHANNEL, EDMA_TRANSFER_MEM2MEM, src,
+                                           (uint32_t)(uintptr_t)stageBuf[b], size, n) != STATUS_SUCCESS) {
+        stageError[b] = true;
+        stageDone[b] = true;
+        return true;
+    }
+    EDMA_DRV_TriggerSwRequest(MEMRD_DMA_CHANNEL);
+    return true;
+}
+
+/* Stops the transfer in flight, if any */
+static void stopStage(void) {
+    if (!stageDone[dmaBuf]) {
+        (void)EDMA_DRV_StopChannel(MEMRD_DMA_CHANNEL);
+        stageDone[dmaBuf] = true;
+    }
+}
+
+/**
+ * @brief Opens a stream over [address, address + size), already checked with
+ *        MEMRD_IsReadable(), for owner and starts staging its first window.
+ *        A transfer of owner's previous stream still in flight is stopped.
+ * @return false if another owner holds the stream.
+ */
+bool MEMRD_Start(const void *owner, uint32_t address, uint32_t size) {
+    if (rdOwner != NULL && rdOwner != owner) {
+        return false;
+    }
+    stopStage();
+
+    rdOwner = owner;
+    rdAddress = address;
+    rdSize = size;
+    stageWindow[0] = -1;
+    stageWindow[1] = -1;
+    lastWindow = -1;
+    (void)startStage(0);
+    return true;
+}
+
+/**
+ * @brief Frees the stream once owner's response has ended or was aborted.
+ *        Does nothing if owner does not hold it.
+ */
+void MEMRD_Release(const void *owner) {
+    if (rdOwner != owner) {
+        return;
+    }
+    stopStage();
+    rdOwner = NULL;
+}
+
+/**
+ * @brief State of the window holding offset; one look at the completion
+ *        flag, no waiting. A window that is not staged (any more) is
+ *        started if the channel is free.
+ * @return MEMRD_OK once its bytes can be read, MEMRD_BUSY or MEMRD_ERROR.
+ */
+int MEMRD_Ready(uint32_t offset) {
+    int32_t w = (int32_t)(offset / MEMRD_STAGE_SIZE);
+    uint8_t b = (uint8_t)(w % 2);
+
+    if (stageWindow[b] != w) {
+        (void)startStage(w);
+        return MEMRD_BUSY;
+    }
+    if (!stageDone[b]) {
+        return MEMRD_BUSY;
+    }
+    return stageError[b] ? MEMRD_ERROR : MEMRD_OK;
+}
+
+/**
+ * @brief Copies len stream bytes starting at offset into dst.
+ *
+ * Offsets are expected to grow as the response is segmented; asking again
+ * for the current frame is fine. A window that is no longer staged (a
+ * retried frame across a window boundary) is staged again.
+ * @return MEMRD_OK, or MEMRD_BUSY / MEMRD_ERROR from MEMRD_Ready(); dst is
+ *         then incomplete.
+ */
+int MEMRD_Read(uint32_t offset, uint8_t *dst, uint16_t len) {
+    while (len > 0) {
+        int32_t w = (int32_t)(offset / MEMRD_STAGE_SIZE);
+        uint8_t b = (uint8_t)(w % 2);
+        uint32_t from = offset % MEMRD_STAGE_SIZE;
+        uint32_t n = MEMRD_STAGE_SIZE - from;
+        int status = MEMRD_Ready(offset);
+
+        if (status != MEMRD_OK) {
+            return status;
+        }
+
+        /* First bytes of a new window: prefetch the next one */
+        if (w > lastWindow) {
+            lastWindow = w;
+            (void)startStage(w + 1);
+        }
+
+        if (n > len) n = len;
+        memcpy(dst, (const uint8_t *)stageBuf[b] + from, n);
+        dst += n;
+        offset += n;
+        len -= (uint16_t)n;
+    }
+    return MEMRD_OK;
+}
@@ -0,0 +1,26 @@
+#ifndef MEMRD_H_
+#define MEMRD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// ===== eDMA staging =====
+#define MEMRD_DMA_CHANNEL    0U      // eDMA virtual channel owned by this module
+#define MEMRD_STAGE_SIZE     112U    // Bytes per eDMA transfer: 16 CF payloads, multiple of 4
+#define MEMRD_PROTECT_MAX    4U      // Ranges MEMRD_Protect() can hide inside readable regions
+
+// ===== Stream status =====
+#define MEMRD_OK             0
+#define MEMRD_BUSY           1       // Staging transfer still running, ask again later
+#define MEMRD_ERROR          (-1)    // eDMA reported an error
+
+// ===== Function Prototypes =====
+void MEMRD_Init(void);
+void MEMRD_Protect(const void *start, uint32_t size);
+bool MEMRD_IsReadable(uint32_t address, uint32_t size);
+bool MEMRD_Start(const void *owner, uint32_t address, uint32_t size);
+void MEMRD_Release(const void *owner);
+int  MEMRD_Ready(uint32_t offset);
+int  MEMRD_Read(uint32_t offset, uint8_t *dst, uint16_t len);
+
+#endif /* MEMRD_H_ */
@@ -0,0 +1,42 @@
+/*
+ * @brief  Time base of the 0x2A periodic scheduler on a timing_pal (LPIT) channel.
+ *
+ * The interrupt only counts ticks. Whatever is scheduled, the frames are
+ * built and sent from the main loop (UDS_Tick()), so the interrupt time
+ * does not depend on the number of periodic DIDs.
+ */
+
+#include "sdk_project_config.h"
+#include "periodic.h"
+
+static volatile uint32_t periodicTicks;
+
+/**
+ * @brief Starts the channel with a PERIODIC_TICK_MS period.
+ */
+void PERIODIC_Init(void) {
+    uint64_t resolution = 0;
+
+    (void)TIMING_Init(&timing_pal_1_instance, &timing_pal_1_InitConfig);
+    if (TIMING_GetResolution(&timing_pal_1_instance, TIMER_RESOLUTION_TYPE_NANOSECOND,
+                             &resolution) != STATUS_SUCCESS || resolution == 0U) {
+        return;
+    }
+    TIMING_StartChannel(&timing_pal_1_instance, PERIODIC_CHANNEL,
+                        (uint32_t)((PERIODIC_TICK_MS * 1000000ULL) / resolution));
+}
+
+/**
+ * @brief Ticks since PERIODIC_Init(); wraps after 2^32.
+ */
+uint32_t PERIODIC_Ticks(void) {
+    return periodicTicks;
+}
+
+/**
+ * @brief Channel notification from timing_pal_1.
+ */
+void PERIODIC_OnTimer(void *userData) {
+    (void)userData;
+    periodicTicks++;
+}
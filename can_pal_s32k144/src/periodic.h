@@ -0,0 +1,15 @@
+#ifndef PERIODIC_H_
+#define PERIODIC_H_
+
+#include <stdint.h>
+
+// ===== Periodic transmission time base =====
+#define PERIODIC_TICK_MS     10U     // LPIT channel period; 0x2A rates are multiples of it
+#define PERIODIC_CHANNEL     0U      // Channel of timing_pal_1
+
+// ===== Function Prototypes =====
+void     PERIODIC_Init(void);
+uint32_t PERIODIC_Ticks(void);
+void     PERIODIC_OnTimer(void *userData);
+
+#endif /* PERIODIC_H_ */
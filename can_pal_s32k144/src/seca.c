@@ -0,0 +1,142 @@
+/*
+ * @brief  SecurityAccess (0x27) backend on the CSEc engine.
+ *
+ * Seeds come from the CSEc TRNG. The expected key is the AES-128 CMAC of the
+ * seed under SECA_KEY_SLOT; it is checked inside CSEc by the asynchronous
+ * VERIFY_MAC command, so the MAC key never leaves the module and the CAN path
+ * keeps running while the command executes. Failed attempts are kept in NVM
+ * so a reset does not lift a lockout.
+ */
+
+#include "seca.h"
+#include "dtc.h"
+#include "memrd.h"
+#include "osif.h"
+#include <string.h>
+
+static csec_state_t csecState;
+
+static bool     verifStatus;      /* Written by the CSEc driver on completion */
+static bool     verifyRunning;
+static uint8_t  failedAttempts;   /* Mirror of the NVM record */
+static bool     delayActive;
+static uint32_t delayStart;
+
+/**
+ * @brief Persists failedAttempts (byte 0 of the record, rest left erased).
+ */
+static void storeAttempts(void) {
+    uint8_t record[SECA_NVM_SIZE];
+
+    memset(record, 0xFF, sizeof(record));
+    record[0] = failedAttempts;
+    if (NVM_Erase(SECA_NVM_OFFSET, SECA_NVM_SIZE) == NVM_OK) {
+        (void)NVM_Write(SECA_NVM_OFFSET, record, SECA_NVM_SIZE);
+    }
+}
+
+static void startDelay(void) {
+    delayActive = true;
+    delayStart = OSIF_GetMilliseconds();
+}
+
+/**
+ * @brief Initializes CSEc and its RNG and restores the attempt counter.
+ *        If the last power cycle ended locked out, the delay starts again.
+ *        The CSEc driver context is kept out of reach of 0x23.
+ */
+void SECA_Init(void) {
+    uint8_t record[SECA_NVM_SIZE];
+
+    CSEC_DRV_Init(&csecState);
+    (void)CSEC_DRV_InitRNG();
+    MEMRD_Protect(&csecState, sizeof(csecState));
+
+    failedAttempts = 0;
+    delayActive = false;
+    verifyRunning = false;
+
+    /* Erased record (0xFF) means no failed attempts */
+    if (NVM_Read(SECA_NVM_OFFSET, record, SECA_NVM_SIZE) == NVM_OK && record[0] != 0xFF) {
+        failedAttempts = record[0];
+    }
+    if (failedAttempts >= SECA_MAX_ATTEMPTS) {
+        startDelay();
+    }
+}
+
+/**
+ * @brief Fills seed with SECA_SEED_LEN random bytes (CMD_RND, a few microseconds).
+ * @return 0 on success, -1 if CSEc is busy or its RNG is not initialized.
+ */
+int SECA_GenerateSeed(uint8_t *seed) {
+    return (CSEC_DRV_GenerateRND(seed) == STATUS_SUCCESS) ? 0 : -1;
+}
+
+/**
+ * @brief Launches the CMAC check of key against seed.
+ *
+ * Both buffers must stay untouched until SECA_PollVerify() stops returning
+ * SECA_VERIFY_PENDING.
+ *
+ * @return 0 if the command was started, -1 if CSEc is busy.
+ */
+int SECA_StartVerify(const uint8_t *seed, const uint8_t *key) {
+    if (verifyRunning) {
+        return -1;
+    }
+    if (CSEC_DRV_VerifyMACAsync(SECA_KEY_SLOT, seed, SECA_SEED_LEN * 8U,
+                                key, SECA_KEY_LEN * 8U, &verifStatus) != STATUS_SUCCESS) {
+        return -1;
+    }
+    verifyRunning = true;
+    return 0;
+}
+
+SECA_Verify_t SECA_PollVerify(void) {
+    status_t status = CSEC_DRV_GetAsyncCmdStatus();
+
+    if (status == STATUS_BUSY) {
+        return SECA_VERIFY_PENDING;
+    }
+    verifyRunning = false;
+
+    if (status != STATUS_SUCCESS) {
+        return SECA_VERIFY_ERROR;
+    }
+    return verifStatus ? SECA_VERIFY_OK : SECA_VERIFY_FAILED;
+}
+
+/**
+ * @brief true while requests must be answered with requiredTimeDelayNotExpired.
+ */
+bool SECA_DelayActive(void) {
+    if (delayActive && OSIF_GetMilliseconds() - delayStart >= SECA_DELAY_MS) {
+        delayActive = false;
+    }
+    return delayActive;
+}
+
+/**
+ * @brief Counts an invalid key.
+ * @return true if the attempt limit is reached and the delay timer started.
+ */
+bool SECA_RecordFailure(void) {
+    if (failedAttempts < 0xFE) {
+        failedAttempts++;
+    }
+    storeAttempts();
+
+    if (failedAttempts >= SECA_MAX_ATTEMPTS) {
+        startDelay();
+        return true;
+    }
+    return false;
+}
+
+void SECA_RecordSuccess(void) {
+    if (failedAttempts != 0) {
+        failedAttempts = 0;
+        storeAttempts();
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef SECA_H_
+#define SECA_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "csec_driver.h"
+
+// ===== SecurityAccess (0x27) parameters =====
+#define SECA_SEED_LEN        16U          // One AES block from CMD_RND
+#define SECA_KEY_LEN         16U          // AES-128 CMAC of the seed
+#define SECA_KEY_SLOT        CSEC_KEY_1   // CSEc slot holding the MAC key, provisioned write-protected
+#define SECA_MAX_ATTEMPTS    3U           // Invalid keys before the delay timer starts
+#define SECA_DELAY_MS        10000UL      // Lockout after SECA_MAX_ATTEMPTS, also applied at power-up
+#define SECA_NVM_OFFSET      0x0000UL     // Attempt counter record, outside the DTC region
+#define SECA_NVM_SIZE        8UL
+
+/**
+ * @brief State of an asynchronous key verification.
+ */
+typedef enum {
+    SECA_VERIFY_PENDING = 0,  /* CSEc command still running */
+    SECA_VERIFY_OK,           /* Key matches the CMAC of the seed */
+    SECA_VERIFY_FAILED,       /* Key does not match */
+    SECA_VERIFY_ERROR         /* CSEc reported an error, e.g. empty key slot */
+} SECA_Verify_t;
+
+// ===== Function Prototypes =====
+void SECA_Init(void);
+int  SECA_GenerateSeed(uint8_t *seed);
+int  SECA_StartVerify(const uint8_t *seed, const uint8_t *key);
+SECA_Verify_t SECA_PollVerify(void);
+bool SECA_DelayActive(void);
+bool SECA_RecordFailure(void);
+void SECA_RecordSuccess(void);
+
+#endif /* SECA_H_ */
@@ -7,70 +7,191 @@
 #include "dtc.h"
 #include <string.h>
 #include "FlexCan.h"
+#include "adc.h"
+#include "dtcidx.h"
 #include <stdbool.h>
 
+/* Application data exposed through 0x22 */
+uint8_t engineLight;
+uint16_t engineTempThreshold = ENGINE_TEMP_THRESHOLD_DEFAULT;
+
+static void holdDddids(UDS_Server_t *srv, bool hold);
+
 /**
- * @brief Defines the type of response flow for the current UDS transaction.
+ * @brief P2 / P2* of each session, indexed by session - 1.
+ *        Used for NRC 0x78 pacing and reported in the 0x10 response.
  */
-typedef enum {
-    UDS_FLOW_NONE = 0, /* No response to be sent */
-    UDS_FLOW_POS,      /* Positive response */
-    UDS_FLOW_NEG       /* Negative response */
-} UDS_FlowType;
+static const struct {
+    uint16_t p2Ms;
+    uint16_t p2StarMs;
+} udsSessionTiming[] = {
+    [UDS_SESSION_DEFAULT - 1]     = { UDS_P2_SERVER_MS, UDS_P2_STAR_SERVER_MS },
+    [UDS_SESSION_PROGRAMMING - 1] = { UDS_P2_SERVER_MS, UDS_P2_STAR_PROG_MS },
+    [UDS_SESSION_EXTENDED - 1]    = { UDS_P2_SERVER_MS, UDS_P2_STAR_SERVER_MS },
+};
 
 /**
- * @brief Holds all necessary information for responding to the current UDS request.
+ * @brief Slot table of each 0x2A rate, indexed by transmissionMode - 1:
+ *        rate r owns pdidSlots[offset .. offset + count), one slot per tick.
  */
-typedef struct {
-    UDS_FlowType   flow;          /* POS / NEG / NONE */
-    uint8_t        sid;           /* Requested Service ID */
-    uint8_t        nrc;           /* Negative Response Code if NEG */
-    const uint8_t* payload;       /* Pointer to POS response payload (if any) */
-    uint16_t       payload_len;   /* Length of POS response payload */
-} UDS_Context;
+static const struct {
+    uint16_t offset;
+    uint16_t count;
+} udsPeriodicRates[] = {
+    [UDS_PERIODIC_SLOW - 1]   = { 0,
+                                  UDS_PERIODIC_SLOW_MS / PERIODIC_TICK_MS },
+    [UDS_PERIODIC_MEDIUM - 1] = { UDS_PERIODIC_SLOW_MS / PERIODIC_TICK_MS,
+                                  UDS_PERIODIC_MEDIUM_MS / PERIODIC_TICK_MS },
+    [UDS_PERIODIC_FAST - 1]   = { (UDS_PERIODIC_SLOW_MS + UDS_PERIODIC_MEDIUM_MS) / PERIODIC_TICK_MS,
+                                  UDS_PERIODIC_FAST_MS / PERIODIC_TICK_MS },
+};
 
-/* Global context for UDS */
-static UDS_Context udsCtx;
+/**
+ * @brief Supported services, indexed by SID - UDS_SID_BASE.
+ *        const with static initializers only, so the table is placed in flash
+ *        and shared by all server instances.
+ */
+static const UDS_ServiceDesc_t udsServices[UDS_SID_COUNT] = {
+    [UDS_SERVICE_SESSION_CONTROL - UDS_SID_BASE] = {
+        .handler = handleSessionControl,
+        .minLen = 2, .maxLen = 2,
+        .sessions = UDS_SESS_ALL,
+        .security = SECURITY_LEVEL_NONE,
+        .subFunction = true,
+        .functional = true,
+        .exclusive = true,
+    },
+    [UDS_SERVICE_CLEAR_DTC - UDS_SID_BASE] = {
+        .handler = handleClearDiagnosticInformation,
+        .minLen = 4, .maxLen = 4,
+        .sessions = UDS_SESS_ALL,
+        .security = SECURITY_LEVEL_NONE,
+        .functional = true,
+    },
+    [UDS_SERVICE_READ_DTC_INFORMATION - UDS_SID_BASE] = {
+        .handler = handleReadDTCInformation,
+        .minLen = 2, .maxLen = 6,
+        .sessions = UDS_SESS_ALL,
+        .security = SECURITY_LEVEL_NONE,
+        .subFunction = true,
+        .functional = true,
+    },
+    [UDS_SERVICE_READ_DID - UDS_SID_BASE] = {
+        .handler = handleReadDataByIdentifier,
+        .minLen = 3, .maxLen = 1 + 2 * UDS_DID_MAX_PER_REQ,
+        .sessions = UDS_SESS_ALL,
+        .security = SECURITY_LEVEL_NONE,
+        .functional = true,
+    },
+    [UDS_SERVICE_READ_MEMORY_BY_ADDRESS - UDS_SID_BASE] = {
+        .handler = handleReadMemoryByAddress,
+        .minLen = 4, .maxLen = 10,
+        .sessions = UDS_SESS_MASK(UDS_SESSION_EXTENDED),
+        .security = SECURITY_LEVEL_ENGINE,
+    },
+    [UDS_SERVICE_DYNAMICALLY_DEFINE_DID - UDS_SID_BASE] = {
+        .handler = handleDynamicallyDefineDataIdentifier,
+        .minLen = 2, .maxLen = 5 + 8 * UDS_DDDID_MAX_SOURCES,
+        .sessions = UDS_SESS_ALL,
+        .security = SECURITY_LEVEL_NONE,
+        .subFunction = true,
+        .exclusive = true,
+    },
+    [UDS_SERVICE_READ_DATA_BY_PERIODIC_ID - UDS_SID_BASE] = {
+        .handler = handleReadDataByPeriodicIdentifier,
+        .minLen = 2, .maxLen = 2 + UDS_PDID_MAX,
+        .sessions = UDS_SESS_ALL,
+        .security = SECURITY_LEVEL_NONE,
+        .exclusive = true,
+    },
+    [UDS_SERVICE_SECURITY_ACCESS - UDS_SID_BASE] = {
+        .handler = handleSecurityAccess,
+        .minLen = 2, .maxLen = 2 + SECA_KEY_LEN,
+        .sessions = UDS_SESS_MASK(UDS_SESSION_PROGRAMMING) | UDS_SESS_MASK(UDS_SESSION_EXTENDED),
+        .security = SECURITY_LEVEL_NONE,
+        .subFunction = true,
+        .exclusive = true,
+    },
+    [UDS_SERVICE_REQUEST_DOWNLOAD - UDS_SID_BASE] = {
+        .handler = handleRequestDownload,
+        .minLen = 5, .maxLen = 11,
+        .sessions = UDS_SESS_MASK(UDS_SESSION_PROGRAMMING),
+        .security = SECURITY_LEVEL_ENGINE,
+        .exclusive = true,
+    },
+    [UDS_SERVICE_TRANSFER_DATA - UDS_SID_BASE] = {
+        .handler = handleTransferData,
+        .minLen = 3, .maxLen = 2 + FLASHDL_BLOCK_SIZE,
+        .sessions = UDS_SESS_MASK(UDS_SESSION_PROGRAMMING),
+        .security = SECURITY_LEVEL_ENGINE,
+        .exclusive = true,
+    },
+    [UDS_SERVICE_REQUEST_TRANSFER_EXIT - UDS_SID_BASE] = {
+        .handler = handleRequestTransferExit,
+        .minLen = 1, .maxLen = 1,
+        .sessions = UDS_SESS_MASK(UDS_SESSION_PROGRAMMING),
+        .security = SECURITY_LEVEL_ENGINE,
+        .exclusive = true,
+    },
+    [UDS_SERVICE_TESTER_PRESENT - UDS_SID_BASE] = {
+        .handler = handleTesterPresent,
+        .minLen = 2, .maxLen = 2,
+        .sessions = UDS_SESS_ALL,
+        .security = SECURITY_LEVEL_NONE,
+        .subFunction = true,
+        .functional = true,
+    },
+};
 
 /**
- * @brief Clear DTC(s) from NVM based on the GroupOfDTC parameter.
+ * @brief Background job of service 0x14: clears DTC(s) from NVM based on the
+ *        GroupOfDTC parameter, one slot erase per UDS_Tick() so the CAN RX
+ *        path keeps running between flash operations.
  *
- * @param groupOfDTC 24-bit DTC group identifier (0xFFFFFF = all DTCs).
- * @return true if all targeted DTC(s) were successfully erased, false otherwise.
+ * jobParam = GroupOfDTC (0xFFFFFF = all DTCs), jobIndex = next slot,
+ * jobFailed = an erase failed.
  */
-static bool clearDTCFromNVM(uint32_t groupOfDTC) {
-    uint8_t erased[DTC_SLOT_SIZE];
-    memset(erased, 0xFF, DTC_SLOT_SIZE); // 0xFF = "empty" state
+static UDS_FlowType clearDTCJob(UDS_Server_t *srv) {
+    uint32_t groupOfDTC = srv->jobParam;
 
-    // === Case 1: Clear ALL stored DTCs ===
     if (groupOfDTC == 0xFFFFFF) {
-        bool cleared = true;
-        for (uint8_t i = 0; i < DTC_GetCount(); i++) {
-            uint32_t offset = DTC_REGION_OFFSET + (i * DTC_SLOT_SIZE);
+        // === Case 1: Clear ALL stored DTCs ===
+        if (srv->jobIndex < DTC_GetCount()) {
+            uint32_t offset = DTC_REGION_OFFSET + (srv->jobIndex * DTC_SLOT_SIZE);
+            if (NVM_Erase(offset, DTC_SLOT_SIZE) != NVM_OK) {
+                srv->jobFailed = true; // Mark failure but continue erasing others
+            }
+            srv->jobIndex++;
+            return UDS_FLOW_PENDING;
+        }
+    } else {
+        // === Case 2: Clear a specific single DTC ===
+        int8_t index = DTC_Find(groupOfDTC);
+        if (index != -1) {
+            uint32_t offset = DTC_REGION_OFFSET + (index * DTC_SLOT_SIZE);
+
+            // Only erase this DTC slot without touching others
             if (NVM_Erase(offset, DTC_SLOT_SIZE) != NVM_OK) {
-                cleared = false; // Mark failure but continue erasing others
+                srv->jobFailed = true;
             }
         }
-        return cleared;
+        // === Case 3: DTC not found ===
+        // Per UDS ISO 14229, if the requested DTC is not present,
+        // it is still considered a successful clear operation.
     }
 
-    // === Case 2: Clear a specific single DTC ===
-    int8_t index = DTC_Find(groupOfDTC);
-    if (index != -1) {
-        uint32_t offset = DTC_REGION_OFFSET + (index * DTC_SLOT_SIZE);
+    /* Slots changed under the 0x19 index */
+    DTCIDX_Load();
 
-        // Only erase this DTC slot without touching others
-        if (NVM_Erase(offset, DTC_SLOT_SIZE) == NVM_OK) {
-            return true; // Success
-        } else {
-            return false; // Failed to erase this slot
-        }
+    if (srv->jobFailed) {
+        srv->ctx.nrc = NRC_GENERAL_PROGRAMMING_FAILURE;
+        return UDS_FLOW_NEG;
     }
 
-    // === Case 3: DTC not found ===
-    // Per UDS ISO 14229, if the requested DTC is not present,
-    // it is still considered a successful clear operation.
-    return true;
+    /* Positive Response: No payload required for service 0x14 */
+    srv->ctx.payload = NULL;
+    srv->ctx.payload_len = 0;
+    return UDS_FLOW_POS;
 }
 
 /**
@@ -98,125 +219,1957 @@ static bool isConditionOkForClear(void) {
     return true;
 }
 
+/**
+ * @brief Milliseconds on the server's CAN time base since start.
+ */
+static uint32_t elapsedMs(UDS_Server_t *srv, uint32_t start) {
+    return FLEXCAN_ticks_to_us(srv->link.can, FLEXCAN_get_time(srv->link.can) - start) / 1000UL;
+}
+
+/**
+ * @brief Sends a negative response frame without touching the request context.
+ * @return 0, or -1 if the CAN TX queue is full.
+ */
+static int sendNegative(UDS_Server_t *srv, uint8_t sid, uint8_t nrc) {
+    CAN_Message_t msg = {0};
+    msg.canID = srv->link.txId;
+    msg.dlc   = 4;
+    msg.data[0] = 0x03;       /* PCI: Single Frame, length 3 */
+    msg.data[1] = 0x7F;       /* NRC header */
+    msg.data[2] = sid;        /* Original SID */
+    msg.data[3] = nrc;        /* NRC code */
+    return (FLEXCAN_transmit_msg(srv->link.can, &msg) == 0) ? 0 : -1;
+}
+
+/**
+ * @brief Keeps a negative response in heldRsp; UDS_Tick() sends it once the
+ *        link is free.
+ */
+static void holdNegative(UDS_Server_t *srv, uint8_t sid, uint8_t nrc) {
+    srv->heldRsp[0] = 0x03;
+    srv->heldRsp[1] = 0x7F;
+    srv->heldRsp[2] = sid;
+    srv->heldRsp[3] = nrc;
+    srv->heldRspDlc = 4;
+}
+
+/**
+ * @brief Drops the download this server opened, e.g. when security is relocked.
+ */
+static void abortDownload(UDS_Server_t *srv) {
+    if (srv->dlOwner) {
+        FLASHDL_End();
+        srv->dlOwner = false;
+    }
+}
+
+/**
+ * @brief Unschedules every periodic DID of the server.
+ */
+static void stopPeriodic(UDS_Server_t *srv) {
+    memset(srv->pdidRate, 0, sizeof(srv->pdidRate));
+    memset(srv->pdidSlots, 0, sizeof(srv->pdidSlots));
+    srv->pdidCount = 0;
+}
+
+/**
+ * @brief Writes the d->len byte record of a DID into dst.
+ *
+ * A 0x2C definition is a flat copy loop over its gather list; every source
+ * was resolved when it was defined, so no registry lookup happens here.
+ */
+static void readDidRecord(UDS_Server_t *srv, const UDS_DidDesc_t *d, uint8_t *dst) {
+    if (d->gather != NULL) {
+        for (uint8_t i = 0; i < d->gatherCount; i++) {
+            const UDS_Gather_t *g = &d->gather[i];
+
+            if (g->src != NULL) {
+                memcpy(dst, g->src, g->len);
+            } else {
+                uint8_t record[UDS_DID_MAX_LEN];
+                g->did->read(srv, record);
+                memcpy(dst, &record[g->offset], g->len);
+            }
+            dst += g->len;
+        }
+    } else if (d->data != NULL) {
+        memcpy(dst, d->data, d->len);
+    } else {
+        d->read(srv, dst);
+    }
+}
+
+/**
+ * @brief Sends one periodic frame: [low byte of the DID] [record].
+ *        Dropped if the CAN TX queue is full; the next period sends it again.
+ */
+static void sendPeriodic(UDS_Server_t *srv, const UDS_DidDesc_t *d) {
+    CAN_Message_t msg = {0};
+
+    msg.canID = srv->periodicId;
+    msg.dlc = (uint8_t)(1U + d->len);
+    msg.data[0] = (uint8_t)d->did;
+    readDidRecord(srv, d, &msg.data[1]);
+    (void)FLEXCAN_transmit_async(srv->link.can, &msg, UDS_PERIODIC_TX_PRIO, NULL, NULL);
+}
+
+/**
+ * @brief Serves the periodic ticks since the last call: per tick one slot
+ *        lookup per rate, however many DIDs are scheduled.
+ *
+ * After a main-loop stall each rate replays at most its last period, so a
+ * scheduled DID goes out once, not once for every period it missed.
+ */
+static void periodicTick(UDS_Server_t *srv) {
+    uint32_t now = PERIODIC_Ticks();
+    uint32_t behind = now - srv->pdidTick;
+
+    srv->pdidTick = now;
+    if (srv->pdidCount == 0) {
+        return;
+    }
+
+    for (uint8_t r = 0; r < sizeof(udsPeriodicRates) / sizeof(udsPeriodicRates[0]); r++) {
+        uint32_t tick = now - (behind < udsPeriodicRates[r].count ? behind : udsPeriodicRates[r].count);
+
+        while (tick != now) {
+            uint8_t entry;
+
+            tick++;
+            entry = srv->pdidSlots[udsPeriodicRates[r].offset + tick % udsPeriodicRates[r].count];
+            if (entry != 0) {
+                sendPeriodic(srv, srv->pdidList[entry - 1]);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Turns the current request into a background job.
+ *
+ * Called by a handler instead of setting a final flow. step() runs once per
+ * UDS_Tick() and should do a bounded slice of work; it returns
+ * UDS_FLOW_PENDING to be called again, or UDS_FLOW_POS / UDS_FLOW_NEG with
+ * payload or nrc set in srv->ctx to send the final response. Until then the
+ * server answers 0x7F SID 0x78 before P2 and again before every P2*.
+ * jobParam / jobIndex / jobFailed are the job's own; set them after this call.
+ */
+void UDS_StartJob(UDS_Server_t *srv, UDS_JobStep_t step) {
+    srv->job = step;
+    srv->jobParam = 0;
+    srv->jobIndex = 0;
+    srv->jobFailed = false;
+    srv->jobPending = false;
+    srv->ctx.flow = UDS_FLOW_PENDING;
+}
+
+/**
+ * @brief Request-scoped part of a server: what a physical request in
+ *        progress (segmented response or job) still reads.
+ */
+typedef struct {
+    UDS_Context          ctx;
+    uint8_t              rspBuf[UDS_RSP_BUF_SIZE];
+    const UDS_DidDesc_t *didList[UDS_DID_MAX_PER_REQ];
+    uint8_t              didCount;
+    uint8_t              didCached;
+    uint8_t              didRecord[2 + UDS_DID_MAX_LEN];
+    UDS_JobStep_t        job;
+    uint32_t             jobParam;
+    uint32_t             jobIndex;
+    bool                 jobFailed;
+    bool                 jobPending;
+} UDS_RequestState_t;
+
+static void saveRequestState(const UDS_Server_t *srv, UDS_RequestState_t *state) {
+    state->ctx = srv->ctx;
+    memcpy(state->rspBuf, srv->rspBuf, sizeof(state->rspBuf));
+    memcpy(state->didList, srv->didList, sizeof(state->didList));
+    state->didCount = srv->didCount;
+    state->didCached = srv->didCached;
+    memcpy(state->didRecord, srv->didRecord, sizeof(state->didRecord));
+    state->job = srv->job;
+    state->jobParam = srv->jobParam;
+    state->jobIndex = srv->jobIndex;
+    state->jobFailed = srv->jobFailed;
+    state->jobPending = srv->jobPending;
+}
+
+static void restoreRequestState(UDS_Server_t *srv, const UDS_RequestState_t *state) {
+    srv->ctx = state->ctx;
+    memcpy(srv->rspBuf, state->rspBuf, sizeof(srv->rspBuf));
+    memcpy(srv->didList, state->didList, sizeof(srv->didList));
+    srv->didCount = state->didCount;
+    srv->didCached = state->didCached;
+    memcpy(srv->didRecord, state->didRecord, sizeof(srv->didRecord));
+    srv->job = state->job;
+    srv->jobParam = state->jobParam;
+    srv->jobIndex = state->jobIndex;
+    srv->jobFailed = state->jobFailed;
+    srv->jobPending = state->jobPending;
+}
+
+/**
+ * @brief NRCs never sent in answer to a functional request (ISO 14229-1
+ *        7.5): the request was simply not meant for this server.
+ */
+static bool isSuppressedFunctionalNrc(uint8_t nrc) {
+    return nrc == NRC_SERVICE_NOT_SUPPORTED ||
+           nrc == NRC_SUBFUNC_NOT_SUPPORTED ||
+           nrc == NRC_REQUEST_OUT_OF_RANGE ||
+           nrc == NRC_SUBFUNC_NOT_SUPPORTED_IN_SESSION ||
+           nrc == NRC_SERVICE_NOT_SUPPORTED_IN_SESSION;
+}
+
+/**
+ * @brief Resets the context and runs the request through the generic checks
+ *        and its handler. Leaves the outcome in srv->ctx, sends nothing.
+ */
+static void runService(UDS_Server_t *srv, const uint8_t *req, uint16_t len) {
+    UDS_Context *ctx = &srv->ctx;
+    uint8_t sid = req[0];
+    const UDS_ServiceDesc_t *svc = NULL;
+
+    ctx->flow = UDS_FLOW_NONE;
+    ctx->sid = sid;
+    ctx->nrc = 0;
+    ctx->suppress_pos = false;
+    ctx->payload = NULL;
+    ctx->gen = NULL;
+    ctx->payload_len = 0;
+
+    if (sid >= UDS_SID_BASE && sid < UDS_SID_BASE + UDS_SID_COUNT) {
+        svc = &udsServices[sid - UDS_SID_BASE];
+    }
+
+    /* Generic preconditions, in the order of ISO 14229-1 figure 5 */
+    if (svc == NULL || svc->handler == NULL ||
+        (ctx->req_id == srv->link.funcId && !svc->functional)) {
+        ctx->flow = UDS_FLOW_NEG;
+        ctx->nrc = NRC_SERVICE_NOT_SUPPORTED;
+    } else if ((svc->sessions & UDS_SESS_MASK(srv->session)) == 0) {
+        ctx->flow = UDS_FLOW_NEG;
+        ctx->nrc = NRC_SERVICE_NOT_SUPPORTED_IN_SESSION;
+    } else if (srv->securityLevel < svc->security) {
+        ctx->flow = UDS_FLOW_NEG;
+        ctx->nrc = NRC_SECURITY_ACCESS_DENIED;
+    } else if (len < svc->minLen || len > svc->maxLen) {
+        ctx->flow = UDS_FLOW_NEG;
+        ctx->nrc = NRC_INCORRECT_LENGTH;
+    } else {
+        if (svc->subFunction) {
+            ctx->suppress_pos = (req[1] & UDS_SUPPRESS_POS_RSP_BIT) != 0;
+        }
+        svc->handler(srv, req, len);
+    }
+}
+
+/**
+ * @brief Serves a functional request while a physical one still owns the
+ *        server (segmented request or response, or job running).
+ *
+ * The request runs on a saved copy of the request-scoped state, which is put
+ * back afterwards, so the physical response keeps streaming from its own
+ * context. Only an answer that fits a Single Frame can be given this way; it
+ * is held in heldRsp until the link is free, since a frame on the response
+ * identifier between two Consecutive Frames would abort the tester's
+ * reassembly. A request that would need a job or a segmented response, or
+ * that changes server state the physical one depends on (session, security,
+ * DDDIDs, periodic schedule, download), is answered with NRC 0x21.
+ */
+static void dispatchConcurrent(UDS_Server_t *srv, const uint8_t *req, uint16_t len) {
+    UDS_RequestState_t saved;
+    UDS_Context *ctx = &srv->ctx;
+    uint8_t sid = req[0];
+
+    saveRequestState(srv, &saved);
+    ctx->req_id = srv->link.funcId;
+    if (sid >= UDS_SID_BASE && sid < UDS_SID_BASE + UDS_SID_COUNT &&
+        udsServices[sid - UDS_SID_BASE].exclusive) {
+        ctx->flow = UDS_FLOW_NEG;
+        ctx->sid = sid;
+        ctx->nrc = NRC_BUSY_REPEAT_REQUEST;
+    } else {
+        runService(srv, req, len);
+    }
+
+    if (ctx->flow == UDS_FLOW_PENDING ||
+        (ctx->flow == UDS_FLOW_POS && 1U + ctx->payload_len > 7U)) {
+        ctx->flow = UDS_FLOW_NEG;
+        ctx->nrc = NRC_BUSY_REPEAT_REQUEST;
+    }
+
+    if (ctx->flow == UDS_FLOW_NEG && !isSuppressedFunctionalNrc(ctx->nrc)) {
+        holdNegative(srv, ctx->sid, ctx->nrc);
+    } else if (ctx->flow == UDS_FLOW_POS && !ctx->suppress_pos) {
+        uint8_t total_len = (uint8_t)(1U + ctx->payload_len);
+
+        srv->heldRsp[0] = total_len;
+        srv->heldRsp[1] = ctx->sid + 0x40;
+        if (ctx->gen != NULL && ctx->payload_len != 0) {
+            (void)ctx->gen(srv, 0, &srv->heldRsp[2], ctx->payload_len);
+        } else if (ctx->payload_len != 0) {
+            memcpy(&srv->heldRsp[2], ctx->payload, ctx->payload_len);
+        }
+        srv->heldRspDlc = (uint8_t)(1U + total_len);
+    }
+
+    restoreRequestState(srv, &saved);
+}
+
+/**
+ * @brief Feeds a received CAN frame to a server's transport.
+ *        Frames for other addresses are ignored, so every server can be
+ *        offered every frame. A request is dispatched once ISO-TP has it complete.
+ *
+ * Functional frames take their own path: Single Frames only, parsed without
+ * touching the link, and served even while a physical transfer is running.
+ */
+void UDS_OnFrame(UDS_Server_t *srv, const CAN_Message_t *msg) {
+    const uint8_t *req;
+    uint16_t len;
+
+    if (msg->canID != srv->link.rxId && msg->canID != srv->link.funcId) {
+        return;
+    }
+    /* Any traffic to us, including a segmented request in progress, holds S3 */
+    srv->s3Time = FLEXCAN_get_time(srv->link.can);
+
+    if (msg->canID == srv->link.funcId) {
+        if (!ISOTP_OnFunctionalFrame(&srv->link, msg, &req, &len)) {
+            return;
+        }
+        if (ISOTP_IsBusy(&srv->link) || srv->link.rxState != ISOTP_RX_IDLE ||
+            srv->job != NULL || srv->rspPending) {
+            dispatchConcurrent(srv, req, len);
+            return;
+        }
+        srv->ctx.req_id = msg->canID;
+        UDS_DispatchService(srv, req, len);
+        return;
+    }
+
+    if (ISOTP_OnFrame(&srv->link, msg, &req, &len)) {
+        srv->ctx.req_id = msg->canID;
+        UDS_DispatchService(srv, req, len);
+    }
+}
+
 /**
  * @brief UDS service dispatcher.
  *        Calls the appropriate service handler based on SID.
+ *
+ * @param req Complete request (SID first), without ISO-TP framing.
+ *            Only valid for the duration of the call.
  */
-void UDS_DispatchService(const CAN_Message_t msg_rx) {
-    uint8_t sid = msg_rx.data[1];
+void UDS_DispatchService(UDS_Server_t *srv, const uint8_t *req, uint16_t len) {
+    /* A response is still being segmented: 0x21 follows its last frame */
+    if (ISOTP_IsBusy(&srv->link)) {
+        holdNegative(srv, req[0], NRC_BUSY_REPEAT_REQUEST);
+        return;
+    }
 
-    /* Reset UDS context for new request */
-    udsCtx.flow = UDS_FLOW_NONE;
-    udsCtx.sid = sid;
-    udsCtx.nrc = 0;
+    /* One request at a time; the running job keeps ctx until it responds */
+    if (srv->job != NULL) {
+        if (sendNegative(srv, req[0], NRC_BUSY_REPEAT_REQUEST) != 0) {
+            holdNegative(srv, req[0], NRC_BUSY_REPEAT_REQUEST);
+        }
+        return;
+    }
+    srv->reqTime = FLEXCAN_get_time(srv->link.can);
 
-    switch (sid) {
-        case UDS_SERVICE_READ_DTC_INFORMATION:
-            handleReadDTCInformation(&msg_rx);
-            break;
+    runService(srv, req, len);
 
-        case UDS_SERVICE_CLEAR_DTC:
-            handleClearDiagnosticInformation(msg_rx);
-            break;
+    /* Send response after processing */
+    UDS_SendResponse(srv);
+}
 
-        default:
-            udsCtx.flow = UDS_FLOW_NEG;
-            udsCtx.nrc = NRC_SERVICE_NOT_SUPPORTED;
-            break;
+/**
+ * @brief ISO-TP source of a positive response: the response SID, then the
+ *        payload from the handler's generator or buffer, fetched per frame.
+ */
+static int responseFill(void *context, uint16_t offset, uint8_t *dst, uint16_t len) {
+    UDS_Server_t *srv = (UDS_Server_t *)context;
+    UDS_Context *ctx = &srv->ctx;
+
+    if (offset == 0) {
+        *dst++ = ctx->sid + 0x40;
+        len--;
+    } else {
+        offset--;
+    }
+    if (len == 0) {
+        return 0;
     }
 
-    /* Send response after processing */
-    UDS_SendResponse();
+    if (ctx->gen != NULL) {
+        return ctx->gen(srv, offset, dst, len);
+    }
+    memcpy(dst, &ctx->payload[offset], len);
+    return 0;
+}
+
+/**
+ * @brief Makes the positive response body len bytes pulled from gen().
+ *
+ * gen() runs while the response is segmented, after the handler returned,
+ * so it must read from state that stays put until then (NVM, ctx.gen_param).
+ * No RAM proportional to len is needed.
+ */
+void UDS_SetResponseGen(UDS_Server_t *srv, uint16_t len, UDS_RspGen_t gen) {
+    srv->ctx.flow = UDS_FLOW_POS;
+    srv->ctx.payload = NULL;
+    srv->ctx.gen = gen;
+    srv->ctx.payload_len = len;
 }
 
 /**
  * @brief Sends either a Positive or Negative UDS response based on the context.
+ *
+ * A response that cannot be queued yet (CAN TX queue full, or a held frame
+ * must go first) stays in ctx with rspPending set; UDS_Tick() sends it.
  */
-void UDS_SendResponse(void) {
-    if (udsCtx.flow == UDS_FLOW_NEG) {
+void UDS_SendResponse(UDS_Server_t *srv) {
+    UDS_Context *ctx = &srv->ctx;
+    int sent = 0;
+
+    srv->rspPending = false;
+
+    /* Negative responses are sent regardless of suppressPosRspMsgIndicationBit */
+    if (ctx->flow == UDS_FLOW_POS && ctx->suppress_pos) {
+        return;
+    }
+    if (ctx->flow == UDS_FLOW_NEG && ctx->req_id == srv->link.funcId &&
+        isSuppressedFunctionalNrc(ctx->nrc)) {
+        return;
+    }
+    if (ctx->flow != UDS_FLOW_NEG && ctx->flow != UDS_FLOW_POS) {
+        return;
+    }
+    if (srv->heldRspDlc != 0) {
+        srv->rspPending = true;
+        return;
+    }
+
+    /* Longest response a 12-bit ISO-TP First Frame can announce */
+    if (ctx->flow == UDS_FLOW_POS && 1U + ctx->payload_len > ISOTP_MAX_LEN) {
+        ctx->flow = UDS_FLOW_NEG;
+        ctx->nrc = NRC_RESPONSE_TOO_LONG;
+    }
+
+    if (ctx->flow == UDS_FLOW_NEG) {
         /* === Send Negative Response Frame === */
-        CAN_Message_t msg;
-        msg.canID = TX_MSG_ID_UDS;
-        msg.dlc   = 4;
-        msg.data[0] = 0x03;       /* PCI: Single Frame, length 3 */
-        msg.data[1] = 0x7F;       /* NRC header */
-        msg.data[2] = udsCtx.sid; /* Original SID */
-        msg.data[3] = udsCtx.nrc; /* NRC code */
-        FLEXCAN0_transmit_msg(&msg);
-
-    } else if (udsCtx.flow == UDS_FLOW_POS) {
+        sent = sendNegative(srv, ctx->sid, ctx->nrc);
+
+    } else {
         /* === Send Positive Response === */
-        uint8_t response_sid = udsCtx.sid + 0x40;
-        uint16_t total_len = 1 + udsCtx.payload_len; // SID + payload
+        uint16_t total_len = 1 + ctx->payload_len; // SID + payload
 
         if (total_len <= 7) {
             /* Fits into Single Frame */
-            CAN_Message_t msg;
-            msg.canID   = TX_MSG_ID_UDS;
+            CAN_Message_t msg = {0};
+            msg.canID   = srv->link.txId;
             msg.dlc     = 1 + total_len;
             msg.data[0] = (uint8_t)total_len;
-            msg.data[1] = response_sid;
+            (void)responseFill(srv, 0, &msg.data[1], total_len);
+            sent = FLEXCAN_transmit_msg(srv->link.can, &msg);
 
-            if (udsCtx.payload && udsCtx.payload_len > 0) {
-                memcpy(&msg.data[2], udsCtx.payload, udsCtx.payload_len);
+        } else {
+            /* Requires Multi-Frame (ISO-TP) transmission, built frame by frame */
+            sent = ISOTP_SendStream(&srv->link, total_len, responseFill, srv);
+            if (sent == 0) {
+                holdDddids(srv, true);
             }
-            FLEXCAN0_transmit_msg(&msg);
+        }
+    }
+    srv->rspPending = (sent != 0);
+}
 
+/**
+ * @brief Starts a segmented (ISO 15765-2) transfer of a complete response.
+ *        Non-blocking: Consecutive Frames go out from UDS_Tick().
+ */
+void UDS_SendMultiFrameISO_TP(UDS_Server_t *srv, const uint8_t *data, uint16_t len) {
+    (void)ISOTP_Send(&srv->link, data, len);
+}
+
+/**
+ * @brief Periodic processing of one server. Call from the main loop.
+ */
+void UDS_Tick(UDS_Server_t *srv) {
+    ISOTP_Tick(&srv->link);
+    periodicTick(srv);
+
+    /* Functional answer or 0x21 given while the link was busy */
+    if (srv->heldRspDlc != 0 && !ISOTP_IsBusy(&srv->link)) {
+        CAN_Message_t msg = {0};
+        msg.canID = srv->link.txId;
+        msg.dlc   = srv->heldRspDlc;
+        memcpy(msg.data, srv->heldRsp, srv->heldRspDlc);
+        if (FLEXCAN_transmit_msg(srv->link.can, &msg) == 0) {
+            srv->heldRspDlc = 0;
+        }
+    }
+    /* A response the TX queue had no room for, until P2* runs out */
+    if (srv->rspPending && srv->heldRspDlc == 0 && !ISOTP_IsBusy(&srv->link)) {
+        if (elapsedMs(srv, srv->reqTime) < udsSessionTiming[srv->session - 1].p2StarMs) {
+            UDS_SendResponse(srv);
         } else {
-            /* Requires Multi-Frame (ISO-TP) transmission */
-            static uint8_t full_payload[4095];
-            full_payload[0] = response_sid;
+            srv->rspPending = false;
+        }
+    }
+    if (srv->didHeld != 0 && !ISOTP_IsBusy(&srv->link)) {
+        holdDddids(srv, false);
+    }
+    /* The 0x23 response has been sent, failed or was aborted */
+    if (srv->memOwner && srv->job == NULL && !srv->rspPending && !ISOTP_IsBusy(&srv->link)) {
+        MEMRD_Release(srv);
+        srv->memOwner = false;
+    }
 
-            if (udsCtx.payload && udsCtx.payload_len > 0) {
-                memcpy(&full_payload[1], udsCtx.payload, udsCtx.payload_len);
-            }
-            UDS_SendMultiFrameISO_TP(full_payload, total_len);
+    if (srv->job == NULL) {
+        /* S3 runs only while the server is idle and outside the default session */
+        if (ISOTP_IsBusy(&srv->link)) {
+            srv->s3Time = FLEXCAN_get_time(srv->link.can);
+        } else if (srv->session != UDS_SESSION_DEFAULT &&
+                   elapsedMs(srv, srv->s3Time) >= UDS_S3_SERVER_MS) {
+            srv->session = UDS_SESSION_DEFAULT;
+            srv->securityLevel = SECURITY_LEVEL_NONE;
+            abortDownload(srv);
+            stopPeriodic(srv);
         }
+        return;
+    }
+
+    UDS_FlowType flow = srv->job(srv);
+    if (flow != UDS_FLOW_PENDING) {
+        srv->job = NULL;
+        srv->ctx.flow = flow;
+        UDS_SendResponse(srv);
+        return;
+    }
+
+    /* Keep the tester waiting: 0x78 before P2, then before each P2* */
+    uint32_t limit = srv->jobPending ? udsSessionTiming[srv->session - 1].p2StarMs
+                                     : udsSessionTiming[srv->session - 1].p2Ms;
+    /* Tried again on the next pass if the TX queue is full */
+    if (elapsedMs(srv, srv->reqTime) + UDS_RSP_PENDING_MARGIN_MS >= limit &&
+        sendNegative(srv, srv->ctx.sid, NRC_RESPONSE_PENDING) == 0) {
+        srv->reqTime = FLEXCAN_get_time(srv->link.can);
+        srv->jobPending = true;
+        /* After 0x78 the final positive response is mandatory (ISO 14229-1) */
+        srv->ctx.suppress_pos = false;
     }
+    srv->s3Time = FLEXCAN_get_time(srv->link.can);
 }
 
 /**
- * @brief Handles UDS Service 0x14: ClearDiagnosticInformation.
+ * @brief Handles UDS Service 0x10: DiagnosticSessionControl.
+ *
+ * Format: [SID] [sessionType]
+ * Response: [sessionType] [P2 ms (16 bit)] [P2* in 10 ms (16 bit)]
+ *
+ * Every session transition relocks security access, drops a download and
+ * stops periodic transmission.
+ */
+void handleSessionControl(UDS_Server_t *srv, const uint8_t *req, uint16_t len) {
+    uint8_t session = req[1] & (uint8_t)~UDS_SUPPRESS_POS_RSP_BIT;
+    uint8_t *p = srv->rspBuf;
+
+    if (session != UDS_SESSION_DEFAULT && session != UDS_SESSION_PROGRAMMING &&
+        session != UDS_SESSION_EXTENDED) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_SUBFUNC_NOT_SUPPORTED;
+        return;
+    }
+
+    srv->session = session;
+    srv->securityLevel = SECURITY_LEVEL_NONE;
+    abortDownload(srv);
+    stopPeriodic(srv);
+
+    *p++ = session;
+    *p++ = (uint8_t)(udsSessionTiming[session - 1].p2Ms >> 8);
+    *p++ = (uint8_t)udsSessionTiming[session - 1].p2Ms;
+    *p++ = (uint8_t)((udsSessionTiming[session - 1].p2StarMs / 10U) >> 8);
+    *p++ = (uint8_t)(udsSessionTiming[session - 1].p2StarMs / 10U);
+
+    srv->ctx.flow = UDS_FLOW_POS;
+    srv->ctx.payload = srv->rspBuf;
+    srv->ctx.payload_len = (uint16_t)(p - srv->rspBuf);
+}
+
+/**
+ * @brief Handles UDS Service 0x3E: TesterPresent.
+ *
+ * Format: [SID] [0x00 | suppressPosRsp]
  *
- * Format: [len] [SID] [DTC-high-byte] [DTC-mid-byte] [DTC-low-byte]
+ * Only keeps S3 alive, which UDS_OnFrame() already did. With the
+ * suppress bit set the dispatcher sends nothing at all.
  */
-void handleClearDiagnosticInformation(const CAN_Message_t msg_rx) {
-    /* Check request length: 1 len + 1 SID + 3 bytes groupOfDTC */
-    if (msg_rx.dlc != 5 || msg_rx.data[0] != 0x04) {
-        udsCtx.flow = UDS_FLOW_NEG;
-        udsCtx.nrc = NRC_INCORRECT_LENGTH;
+void handleTesterPresent(UDS_Server_t *srv, const uint8_t *req, uint16_t len) {
+    static const uint8_t zeroSubFunction = 0x00;
+
+    if ((req[1] & (uint8_t)~UDS_SUPPRESS_POS_RSP_BIT) != 0x00) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_SUBFUNC_NOT_SUPPORTED;
         return;
     }
 
+    srv->ctx.flow = UDS_FLOW_POS;
+    srv->ctx.payload = &zeroSubFunction;
+    srv->ctx.payload_len = 1;
+}
+
+/**
+ * @brief Handles UDS Service 0x14: ClearDiagnosticInformation.
+ *
+ * Format: [SID] [DTC-high-byte] [DTC-mid-byte] [DTC-low-byte]
+ */
+void handleClearDiagnosticInformation(UDS_Server_t *srv, const uint8_t *req, uint16_t len) {
+    /* Request length (1 SID + 3 bytes groupOfDTC) is checked by the dispatcher */
+
     /* Extract GroupOfDTC from request */
     uint32_t groupOfDTC =
-        (msg_rx.data[2] << 16) |
-        (msg_rx.data[3] << 8)  |
-         msg_rx.data[4];
+        ((uint32_t)req[1] << 16) |
+        ((uint32_t)req[2] << 8)  |
+         req[3];
 
     /* Validate that the requested GroupOfDTC is supported */
     if (!isGroupOfDTCSupported(groupOfDTC)) {
-        udsCtx.flow = UDS_FLOW_NEG;
-        udsCtx.nrc = NRC_REQUEST_OUT_OF_RANGE;
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_REQUEST_OUT_OF_RANGE;
         return;
     }
 
     /* Check operational conditions for clearing */
     if (!isConditionOkForClear()) {
-        udsCtx.flow = UDS_FLOW_NEG;
-        udsCtx.nrc = NRC_CONDITIONS_NOT_CORRECT;
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_CONDITIONS_NOT_CORRECT;
         return;
     }
 
-    /* Try to clear DTC(s) from NVM */
-    if (!clearDTCFromNVM(groupOfDTC)) {
-        udsCtx.flow = UDS_FLOW_NEG;
-        udsCtx.nrc = NRC_GENERAL_PROGRAMMING_FAILURE;
-        return;
+    /* Clear DTC(s) from NVM in the background; the response follows from UDS_Tick() */
+    UDS_StartJob(srv, clearDTCJob);
+    srv->jobParam = groupOfDTC;
+}
+
+/**
+ * @brief Appends a 32-bit value in big-endian order.
+ */
+static uint8_t *putU32(uint8_t *p, uint32_t value) {
+    p[0] = (uint8_t)(value >> 24);
+    p[1] = (uint8_t)(value >> 16);
+    p[2] = (uint8_t)(value >> 8);
+    p[3] = (uint8_t)value;
+    return p + 4;
+}
+
+/**
+ * @brief Reads an ADC channel as a big-endian 16-bit DID record.
+ */
+static void readAdcDid(uint8_t *dst, uint8_t channel) {
+    uint16_t value = myADC_Read(channel);
+    dst[0] = (uint8_t)(value >> 8);
+    dst[1] = (uint8_t)value;
+}
+
+static void readEngineTemp(UDS_Server_t *srv, uint8_t *dst) {
+    readAdcDid(dst, ADC_CH_ENGINE_TEMP);
+}
+
+static void readThreshold(UDS_Server_t *srv, uint8_t *dst) {
+    dst[0] = (uint8_t)(engineTempThreshold >> 8);
+    dst[1] = (uint8_t)engineTempThreshold;
+}
+
+/**
+ * DID_PERIODIC_ENGINE record: engine temperature, lamp state, threshold.
+ */
+static void readEngineStatus(UDS_Server_t *srv, uint8_t *dst) {
+    readAdcDid(dst, ADC_CH_ENGINE_TEMP);
+    dst[2] = engineLight;
+    readThreshold(srv, &dst[3]);
+}
+
+/**
+ * DID_PERIODIC_CAN record: error state, TEC, REC.
+ */
+static void readCanState(UDS_Server_t *srv, uint8_t *dst) {
+    CAN_ErrorStats_t stats;
+
+    FLEXCAN_get_error_stats(srv->link.can, &stats);
+    dst[0] = stats.state;
+    dst[1] = stats.tec;
+    dst[2] = stats.rec;
+}
+
+/**
+ * DID_CAN_ERROR_STATS record: state, TEC, REC, then errorPassive, busOff,
+ * busOffRecoveries, stuff, form, CRC, ACK, bit0, bit1 and txTimeout counts
+ * as 32-bit big-endian values.
+ */
+static void readCanErrorStats(UDS_Server_t *srv, uint8_t *dst) {
+    CAN_ErrorStats_t stats;
+    uint8_t *p = dst;
+
+    FLEXCAN_get_error_stats(srv->link.can, &stats);
+    *p++ = stats.state;
+    *p++ = stats.tec;
+    *p++ = stats.rec;
+    p = putU32(p, stats.errorPassiveCount);
+    p = putU32(p, stats.busOffCount);
+    p = putU32(p, stats.busOffRecoveries);
+    p = putU32(p, stats.stuffErrors);
+    p = putU32(p, stats.formErrors);
+    p = putU32(p, stats.crcErrors);
+    p = putU32(p, stats.ackErrors);
+    p = putU32(p, stats.bit0Errors);
+    p = putU32(p, stats.bit1Errors);
+    (void)putU32(p, stats.txTimeouts);
+}
+
+/**
+ * @brief Readable DIDs. Must stay sorted by DID: lookups are a binary search.
+ */
+static const UDS_DidDesc_t udsDids[] = {
+    { .did = DID_ENGINE_TEMP,     .len = 2,  .read = readEngineTemp,
+      .sessions = UDS_SESS_ALL, .security = SECURITY_LEVEL_NONE },
+    { .did = DID_ENGINE_LIGHT,    .len = 1,  .data = &engineLight,
+      .sessions = UDS_SESS_ALL, .security = SECURITY_LEVEL_NONE },
+    { .did = DID_THRESHOLD,       .len = 2,  .read = readThreshold,
+      .sessions = UDS_SESS_ALL, .security = SECURITY_LEVEL_NONE },
+    { .did = DID_PERIODIC_ENGINE, .len = 5,  .read = readEngineStatus,
+      .sessions = UDS_SESS_ALL, .security = SECURITY_LEVEL_NONE },
+    { .did = DID_PERIODIC_CAN,    .len = 3,  .read = readCanState,
+      .sessions = UDS_SESS_ALL, .security = SECURITY_LEVEL_NONE },
+    { .did = DID_CAN_ERROR_STATS, .len = 43, .read = readCanErrorStats,
+      .sessions = UDS_SESS_ALL, .security = SECURITY_LEVEL_NONE },
+};
+
+#define UDS_DID_COUNT (sizeof(udsDids) / sizeof(udsDids[0]))
+
+/**
+ * @brief One source of a 0x2C definition as the tester sent it. Kept so the
+ *        definition can be stored and compiled again after a reset.
+ */
+typedef struct {
+    uint8_t  type;              /* UDS_DDDID_DEFINE_BY_ID or _BY_MEMORY */
+    uint8_t  position;          /* 1-based first byte in the source DID */
+    uint8_t  size;
+    uint32_t source;            /* Source DID or memory address */
+} UDS_DddidSource_t;
+
+/**
+ * @brief A dynamically defined DID: its registry entry plus the compiled
+ *        gather list that entry points to.
+ */
+typedef struct {
+    UDS_DidDesc_t     desc;     /* desc.did == 0: slot free */
+    UDS_Gather_t      gather[UDS_DDDID_MAX_SOURCES];
+    UDS_DddidSource_t sources[UDS_DDDID_MAX_SOURCES];
+    uint8_t           sourceCount;
+    uint8_t           users;    /* Servers streaming a 0x22 response that reads it */
+} UDS_Dddid_t;
+
+static UDS_Dddid_t udsDddids[UDS_DDDID_MAX];
+
+/**
+ * @brief Binary search of udsDids[], or the defined 0x2C DIDs for their range.
+ * @return The entry, or NULL if the DID is not in the registry.
+ */
+static const UDS_DidDesc_t *findDid(uint16_t did) {
+    uint32_t lo = 0;
+    uint32_t hi = UDS_DID_COUNT;
+
+    if (did >= UDS_DDDID_FIRST && did <= UDS_DDDID_LAST) {
+        for (uint8_t i = 0; i < UDS_DDDID_MAX; i++) {
+            if (udsDddids[i].desc.did == did) {
+                return &udsDddids[i].desc;
+            }
+        }
+        return NULL;
     }
 
-    /* Positive Response: No payload required for service 0x14 */
-    udsCtx.flow = UDS_FLOW_POS;
-    udsCtx.payload = NULL;
-    udsCtx.payload_len = 0;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2U;
+        if (udsDids[mid].did == did) {
+            return &udsDids[mid];
+        }
+        if (udsDids[mid].did < did) {
+            lo = mid + 1U;
+        } else {
+            hi = mid;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Response generator of 0x22: the [DID][record] pairs of srv->didList.
+ *
+ * Each record is sampled once, when its first byte is emitted, and served
+ * from srv->didRecord until the next one starts, so a record split across
+ * Consecutive Frames is one consistent snapshot.
+ */
+static int didResponseGen(UDS_Server_t *srv, uint16_t offset, uint8_t *dst, uint16_t len) {
+    uint8_t *record = srv->didRecord;
+    uint16_t start = 0;
+
+    for (uint8_t i = 0; i < srv->didCount && len > 0; i++) {
+        const UDS_DidDesc_t *d = srv->didList[i];
+        uint16_t size = 2 + d->len;
+
+        if (offset < start + size) {
+            uint16_t from = offset - start;
+            uint16_t n = size - from;
+            if (n > len) n = len;
+
+            if (srv->didCached != i + 1U) {
+                record[0] = (uint8_t)(d->did >> 8);
+                record[1] = (uint8_t)d->did;
+                readDidRecord(srv, d, &record[2]);
+                srv->didCached = (uint8_t)(i + 1U);
+            }
+            memcpy(dst, &record[from], n);
+            dst += n;
+            len -= n;
+            offset += n;
+        }
+        start += size;
+    }
+    return 0;
+}
+
+/**
+ * @brief Releases the DDDIDs the previous streamed response of srv read and,
+ *        if hold is set and a 0x22 response is starting, takes those of
+ *        srv->didList. 0x2C leaves a held DDDID alone: the table is shared
+ *        by all servers and didResponseGen() reads it until the last frame.
+ *        Periodic DIDs (0xF2nn) never name a DDDID (0xF3nn), so only
+ *        streamed 0x22 responses hold them.
+ */
+static void holdDddids(UDS_Server_t *srv, bool hold) {
+    for (uint8_t i = 0; i < UDS_DDDID_MAX; i++) {
+        if (srv->didHeld & (1U << i)) {
+            udsDddids[i].users--;
+        }
+    }
+    srv->didHeld = 0;
+    if (!hold || srv->ctx.gen != didResponseGen) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < srv->didCount; i++) {
+        for (uint8_t j = 0; j < UDS_DDDID_MAX; j++) {
+            if (srv->didList[i] == &udsDddids[j].desc && !(srv->didHeld & (1U << j))) {
+                srv->didHeld |= (uint8_t)(1U << j);
+                udsDddids[j].users++;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Handles UDS Service 0x22: ReadDataByIdentifier.
+ *
+ * Format: [SID] [DID-high-byte] [DID-low-byte] { [DID-high-byte] [DID-low-byte] }
+ *
+ * DIDs that are unknown or not readable in the active session are skipped;
+ * the request fails with 0x31 only if none is left. A response that fits
+ * rspBuf is sampled at once, a longer one is streamed record by record, each
+ * record sampled when the frame carrying its first byte is built.
+ */
+void handleReadDataByIdentifier(UDS_Server_t *srv, const uint8_t *req, uint16_t len) {
+    uint16_t total = 0;
+
+    /* Min/max length are checked by the dispatcher; DIDs come in pairs */
+    if ((len - 1U) % 2U != 0) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_INCORRECT_LENGTH;
+        return;
+    }
+
+    srv->didCount = 0;
+    srv->didCached = 0;
+    for (uint16_t i = 1; i < len; i += 2) {
+        const UDS_DidDesc_t *d = findDid((uint16_t)((req[i] << 8) | req[i + 1]));
+
+        if (d != NULL && (d->sessions & UDS_SESS_MASK(srv->session)) != 0) {
+            srv->didList[srv->didCount++] = d;
+            total += 2 + d->len;
+        }
+    }
+
+    if (srv->didCount == 0) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_REQUEST_OUT_OF_RANGE;
+        return;
+    }
+
+    for (uint8_t i = 0; i < srv->didCount; i++) {
+        if (srv->securityLevel < srv->didList[i]->security) {
+            srv->ctx.flow = UDS_FLOW_NEG;
+            srv->ctx.nrc = NRC_SECURITY_ACCESS_DENIED;
+            return;
+        }
+    }
+
+    if (total <= UDS_RSP_BUF_SIZE) {
+        /* Snapshot in the server's buffer, stable while the response is segmented */
+        (void)didResponseGen(srv, 0, srv->rspBuf, total);
+        srv->ctx.flow = UDS_FLOW_POS;
+        srv->ctx.payload = srv->rspBuf;
+        srv->ctx.payload_len = total;
+    } else {
+        UDS_SetResponseGen(srv, total, didResponseGen);
+    }
+}
+
+/**
+ * @brief Response generator of 0x23: the eDMA-staged memory stream. A frame
+ *        whose window is still in flight is retried on a later tick.
+ */
+static int memoryGen(UDS_Server_t *srv, uint16_t offset, uint8_t *dst, uint16_t len) {
+    int status = MEMRD_Read(offset, dst, len);
+
+    if (status == MEMRD_BUSY) {
+        return ISOTP_FILL_NOT_READY;
+    }
+    return (status == MEMRD_OK) ? 0 : ISOTP_FILL_ERROR;
+}
+
+/**
+ * @brief Background job of 0x23: responds once the first window is staged,
+ *        so an eDMA error there is still reported as a negative response.
+ *
+ * jobParam = memorySize.
+ */
+static UDS_FlowType readMemoryJob(UDS_Server_t *srv) {
+    int status = MEMRD_Ready(0);
+
+    if (status == MEMRD_BUSY) {
+        return UDS_FLOW_PENDING;
+    }
+    if (status != MEMRD_OK) {
+        srv->ctx.nrc = NRC_CONDITIONS_NOT_CORRECT;
+        return UDS_FLOW_NEG;
+    }
+    UDS_SetResponseGen(srv, (uint16_t)srv->jobParam, memoryGen);
+    return UDS_FLOW_POS;
+}
+
+/**
+ * @brief Handles UDS Service 0x23: ReadMemoryByAddress.
+ *
+ * Format: [SID] [addressAndLengthFormatIdentifier] [memoryAddress (1..4)]
+ *         [memorySize (1..4)]
+ * Response: [dataRecord]
+ *
+ * The range must lie inside one region of memrd.c. Only the extended
+ * session with security unlocked may read, as RAM holds key material.
+ * An eDMA error on the first window answers 0x22; one on a later window
+ * can no longer be reported and ends the transfer early. While another
+ * server's 0x23 response holds the memory stream the request gets 0x21.
+ */
+void handleReadMemoryByAddress(UDS_Server_t *srv, const uint8_t *req, uint16_t len) {
+    uint8_t addrLen = req[1] & 0x0F;
+    uint8_t sizeLen = req[1] >> 4;
+    uint32_t address = 0;
+    uint32_t size = 0;
+
+    if (addrLen < 1 || addrLen > 4 || sizeLen < 1 || sizeLen > 4) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_REQUEST_OUT_OF_RANGE;
+        return;
+    }
+    if (len != 2U + addrLen + sizeLen) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_INCORRECT_LENGTH;
+        return;
+    }
+
+    for (uint8_t i = 0; i < addrLen; i++) {
+        address = (address << 8) | req[2 + i];
+    }
+    for (uint8_t i = 0; i < sizeLen; i++) {
+        size = (size << 8) | req[2 + addrLen + i];
+    }
+
+    if (size == 0 || !MEMRD_IsReadable(address, size)) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_REQUEST_OUT_OF_RANGE;
+        return;
+    }
+    if (size > ISOTP_MAX_LEN - 1U) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_RESPONSE_TOO_LONG;
+        return;
+    }
+
+    /* One memory stream for all servers */
+    if (!MEMRD_Start(srv, address, size)) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_BUSY_REPEAT_REQUEST;
+        return;
+    }
+    srv->memOwner = true;
+    UDS_StartJob(srv, readMemoryJob);
+    srv->jobParam = size;
+}
+
+/**
+ * @brief Appends one source to a definition, resolving it to a gather
+ *        fragment now so reads never look it up again.
+ *
+ * srv is the requesting server whose security level is checked, or NULL
+ * when a stored definition is restored.
+ * @return 0, or the NRC that rejects the source.
+ */
+static uint8_t compileSource(UDS_Dddid_t *def, const UDS_DddidSource_t *spec, const UDS_Server_t *srv) {
+    UDS_Gather_t *last = (def->desc.gatherCount > 0) ? &def->gather[def->desc.gatherCount - 1] : NULL;
+    const UDS_DidDesc_t *d = NULL;
+    const uint8_t *src = NULL;
+
+    if (def->sourceCount >= UDS_DDDID_MAX_SOURCES || spec->size == 0 ||
+        def->desc.len + spec->size > UDS_DID_MAX_LEN) {
+        return NRC_REQUEST_OUT_OF_RANGE;
+    }
+
+    if (spec->type == UDS_DDDID_DEFINE_BY_ID) {
+        d = (spec->source <= 0xFFFFUL) ? findDid((uint16_t)spec->source) : NULL;
+        /* Only registry DIDs are sources, so definitions cannot refer to each other */
+        if (d == NULL || d->gather != NULL || spec->position == 0 ||
+            spec->position - 1U + spec->size > d->len) {
+            return NRC_REQUEST_OUT_OF_RANGE;
+        }
+        if (srv != NULL && srv->securityLevel < d->security) {
+            return NRC_SECURITY_ACCESS_DENIED;
+        }
+        def->desc.sessions &= d->sessions;
+        if (d->security > def->desc.security) {
+            def->desc.security = d->security;
+        }
+        if (d->data != NULL) {
+            src = (const uint8_t *)d->data + spec->position - 1U;
+            d = NULL;
+        }
+    } else {
+        /* Same access rule as 0x23 */
+        if (!MEMRD_IsReadable(spec->source, spec->size)) {
+            return NRC_REQUEST_OUT_OF_RANGE;
+        }
+        if (srv != NULL && srv->securityLevel < SECURITY_LEVEL_ENGINE) {
+            return NRC_SECURITY_ACCESS_DENIED;
+        }
+        def->desc.sessions &= UDS_SESS_MASK(UDS_SESSION_EXTENDED);
+        def->desc.security = SECURITY_LEVEL_ENGINE;
+        src = (const uint8_t *)(uintptr_t)spec->source;
+    }
+
+    if (src != NULL && last != NULL && last->src != NULL && last->src + last->len == src) {
+        /* Contiguous with the previous fragment: one copy */
+        last->len += spec->size;
+    } else {
+        UDS_Gather_t *g = &def->gather[def->desc.gatherCount++];
+        g->src = src;
+        g->did = d;
+        g->offset = (d != NULL) ? (uint8_t)(spec->position - 1U) : 0U;
+        g->len = spec->size;
+    }
+    def->desc.len += spec->size;
+    def->sources[def->sourceCount++] = *spec;
+    return 0;
+}
+
+/**
+ * @brief Starts an empty definition of did.
+ */
+static void initDddid(UDS_Dddid_t *def, uint16_t did) {
+    memset(def, 0, sizeof(*def));
+    def->desc.did = did;
+    def->desc.sessions = UDS_SESS_ALL;
+    def->desc.security = SECURITY_LEVEL_NONE;
+}
+
+/**
+ * @brief Installs a compiled definition in its slot.
+ */
+static void commitDddid(UDS_Dddid_t *slot, const UDS_Dddid_t *def) {
+    *slot = *def;
+    slot->desc.gather = slot->gather;
+}
+
+/**
+ * @brief Writes all definitions in request form, one UDS_DDDID_NVM_SLOT
+ *        record per slot; free slots stay erased.
+ */
+static void storeDddids(void) {
+#if UDS_DDDID_PERSIST
+    uint8_t record[UDS_DDDID_NVM_SIZE];
+
+    memset(record, 0xFF, sizeof(record));
+    for (uint8_t i = 0; i < UDS_DDDID_MAX; i++) {
+        const UDS_Dddid_t *def = &udsDddids[i];
+        uint8_t *p = &record[i * UDS_DDDID_NVM_SLOT];
+
+        if (def->desc.did == 0) {
+            continue;
+        }
+        *p++ = (uint8_t)(def->desc.did >> 8);
+        *p++ = (uint8_t)def->desc.did;
+        *p++ = def->sourceCount;
+        for (uint8_t j = 0; j < def->sourceCount; j++) {
+            *p++ = def->sources[j].type;
+            *p++ = def->sources[j].position;
+            *p++ = def->sources[j].size;
+            p = putU32(p, def->sources[j].source);
+        }
+    }
+    if (NVM_Erase(UDS_DDDID_NVM_OFFSET, UDS_DDDID_NVM_SIZE) == NVM_OK) {
+        (void)NVM_Write(UDS_DDDID_NVM_OFFSET, record, UDS_DDDID_NVM_SIZE);
+    }
+#endif
+}
+
+/**
+ * @brief Compiles the stored 0x2C definitions again. Call once at start-up;
+ *        a definition whose sources no longer resolve is dropped.
+ */
+void UDS_RestoreDddids(void) {
+#if UDS_DDDID_PERSIST
+    uint8_t record[UDS_DDDID_NVM_SIZE];
+
+    if (NVM_Read(UDS_DDDID_NVM_OFFSET, record, UDS_DDDID_NVM_SIZE) != NVM_OK) {
+        return;
+    }
+    for (uint8_t i = 0; i < UDS_DDDID_MAX; i++) {
+        const uint8_t *p = &record[i * UDS_DDDID_NVM_SLOT];
+        uint16_t did = (uint16_t)((p[0] << 8) | p[1]);
+        uint8_t count = p[2];
+        UDS_Dddid_t def;
+        uint8_t nrc = 0;
+
+        /* Erased slot (0xFFFF) is out of range */
+        if (did < UDS_DDDID_FIRST || did > UDS_DDDID_LAST || count == 0 ||
+            count > UDS_DDDID_MAX_SOURCES) {
+            continue;
+        }
+        initDddid(&def, did);
+        p += 3;
+        for (uint8_t j = 0; j < count && nrc == 0; j++, p += 7) {
+            UDS_DddidSource_t spec = {
+                .type = p[0],
+                .position = p[1],
+                .size = p[2],
+                .source = ((uint32_t)p[3] << 24) | ((uint32_t)p[4] << 16) |
+                          ((uint32_t)p[5] << 8) | p[6],
+            };
+            nrc = compileSource(&def, &spec, NULL);
+        }
+        if (nrc == 0) {
+            commitDddid(&udsDddids[i], &def);
+        }
+    }
+#endif
+}
+
+/**
+ * @brief Slot holding did, else a free slot if alloc is set.
+ * @return The slot, or NULL.
+ */
+static UDS_Dddid_t *findDddidSlot(uint16_t did, bool alloc) {
+    UDS_Dddid_t *unused = NULL;
+
+    for (uint8_t i = 0; i < UDS_DDDID_MAX; i++) {
+        if (udsDddids[i].desc.did == did) {
+            return &udsDddids[i];
+        }
+        if (unused == NULL && udsDddids[i].desc.did == 0) {
+            unused = &udsDddids[i];
+        }
+    }
+    return alloc ? unused : NULL;
+}
+
+/**
+ * @brief Handles UDS Service 0x2C: DynamicallyDefineDataIdentifier.
+ *
+ * 0x01 defineByIdentifier:    [SID] [01] [DDDID (2)] { [sourceDID (2)] [position] [size] }
+ * 0x02 defineByMemoryAddress: [SID] [02] [DDDID (2)] [addressAndLengthFormatIdentifier]
+ *                             { [memoryAddress (1..4)] [memorySize (1..4)] }
+ * 0x03 clear:                 [SID] [03] [ [DDDID (2)] ]
+ * Response: [sub-function] [DDDID (2)], only [03] when all were cleared.
+ *
+ * Defining an existing DDDID appends to it. The request is applied as a
+ * whole or not at all; the DDDID is readable where all its sources are.
+ * A DDDID some server is streaming a 0x22 response of is not changed (0x22),
+ * nor is any while a download still has data to program (0x22).
+ */
+void handleDynamicallyDefineDataIdentifier(UDS_Server_t *srv, const uint8_t *req, uint16_t len) {
+    uint8_t sub = req[1] & (uint8_t)~UDS_SUPPRESS_POS_RSP_BIT;
+    uint16_t did;
+    UDS_Dddid_t *slot;
+    UDS_Dddid_t def;
+    uint8_t nrc = 0;
+
+    if (sub < UDS_DDDID_DEFINE_BY_ID || sub > UDS_DDDID_CLEAR) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_SUBFUNC_NOT_SUPPORTED;
+        return;
+    }
+#if UDS_DDDID_PERSIST
+    /* Definitions are stored through the FTFC, which the download is using */
+    if (FLASHDL_Busy()) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_CONDITIONS_NOT_CORRECT;
+        return;
+    }
+#endif
+
+    srv->rspBuf[0] = sub;
+    if (sub == UDS_DDDID_CLEAR && len == 2) {
+        for (uint8_t i = 0; i < UDS_DDDID_MAX; i++) {
+            if (udsDddids[i].users != 0) {
+                srv->ctx.flow = UDS_FLOW_NEG;
+                srv->ctx.nrc = NRC_CONDITIONS_NOT_CORRECT;
+                return;
+            }
+        }
+        memset(udsDddids, 0, sizeof(udsDddids));
+        storeDddids();
+        srv->ctx.flow = UDS_FLOW_POS;
+        srv->ctx.payload = srv->rspBuf;
+        srv->ctx.payload_len = 1;
+        return;
+    }
+    if (len < 4 || (sub == UDS_DDDID_CLEAR && len != 4)) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_INCORRECT_LENGTH;
+        return;
+    }
+
+    did = (uint16_t)((req[2] << 8) | req[3]);
+    if (did < UDS_DDDID_FIRST || did > UDS_DDDID_LAST) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_REQUEST_OUT_OF_RANGE;
+        return;
+    }
+    srv->rspBuf[1] = req[2];
+    srv->rspBuf[2] = req[3];
+
+    /* A response being streamed still reads the definition */
+    slot = findDddidSlot(did, false);
+    if (slot != NULL && slot->users != 0) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_CONDITIONS_NOT_CORRECT;
+        return;
+    }
+
+    if (sub == UDS_DDDID_CLEAR) {
+        /* Clearing an undefined DDDID is not an error */
+        if (slot != NULL) {
+            memset(slot, 0, sizeof(*slot));
+            storeDddids();
+        }
+    } else {
+        slot = findDddidSlot(did, true);
+        if (slot == NULL) {
+            srv->ctx.flow = UDS_FLOW_NEG;
+            srv->ctx.nrc = NRC_REQUEST_OUT_OF_RANGE;
+            return;
+        }
+        if (slot->desc.did == did) {
+            def = *slot;
+        } else {
+            initDddid(&def, did);
+        }
+
+        if (sub == UDS_DDDID_DEFINE_BY_ID) {
+            if (len < 8 || (len - 4U) % 4U != 0) {
+                srv->ctx.flow = UDS_FLOW_NEG;
+                srv->ctx.nrc = NRC_INCORRECT_LENGTH;
+                return;
+            }
+            for (uint16_t i = 4; i < len && nrc == 0; i += 4) {
+                UDS_DddidSource_t spec = {
+                    .type = UDS_DDDID_DEFINE_BY_ID,
+                    .position = req[i + 2],
+                    .size = req[i + 3],
+                    .source = ((uint32_t)req[i] << 8) | req[i + 1],
+                };
+                nrc = compileSource(&def, &spec, srv);
+            }
+        } else {
+            uint8_t addrLen = (len > 4) ? (req[4] & 0x0F) : 0;
+            uint8_t sizeLen = (len > 4) ? (req[4] >> 4) : 0;
+
+            if (addrLen < 1 || addrLen > 4 || sizeLen < 1 || sizeLen > 4) {
+                srv->ctx.flow = UDS_FLOW_NEG;
+                srv->ctx.nrc = (len > 4) ? NRC_REQUEST_OUT_OF_RANGE : NRC_INCORRECT_LENGTH;
+                return;
+            }
+            if (len == 5 || (len - 5U) % (addrLen + sizeLen) != 0) {
+                srv->ctx.flow = UDS_FLOW_NEG;
+                srv->ctx.nrc = NRC_INCORRECT_LENGTH;
+                return;
+            }
+            for (uint16_t i = 5; i < len && nrc == 0; i += addrLen + sizeLen) {
+                UDS_DddidSource_t spec = { .type = UDS_DDDID_DEFINE_BY_MEMORY };
+                uint32_t size = 0;
+
+                for (uint8_t k = 0; k < addrLen; k++) {
+                    spec.source = (spec.source << 8) | req[i + k];
+                }
+                for (uint8_t k = 0; k < sizeLen; k++) {
+                    size = (size << 8) | req[i + addrLen + k];
+                }
+                spec.size = (size <= UDS_DID_MAX_LEN) ? (uint8_t)size : 0U;  /* 0 is rejected */
+                nrc = compileSource(&def, &spec, srv);
+            }
+        }
+
+        if (nrc != 0) {
+            srv->ctx.flow = UDS_FLOW_NEG;
+            srv->ctx.nrc = nrc;
+            return;
+        }
+        commitDddid(slot, &def);
+        storeDddids();
+    }
+
+    srv->ctx.flow = UDS_FLOW_POS;
+    srv->ctx.payload = srv->rspBuf;
+    srv->ctx.payload_len = 3;
+}
+
+/**
+ * @brief Spreads the DIDs of one rate evenly over its slot table. Runs when
+ *        the schedule changes, never per tick. Rates start on different
+ *        slots so they do not all fire on the same tick.
+ */
+static void buildSlots(UDS_Server_t *srv, uint8_t mode) {
+    uint8_t *slots = &srv->pdidSlots[udsPeriodicRates[mode - 1].offset];
+    uint16_t count = udsPeriodicRates[mode - 1].count;
+    uint16_t n = 0;
+    uint16_t k = 0;
+
+    memset(slots, 0, count);
+    for (uint8_t i = 0; i < UDS_PDID_MAX; i++) {
+        if (srv->pdidRate[i] == mode) n++;
+    }
+    for (uint8_t i = 0; i < UDS_PDID_MAX; i++) {
+        if (srv->pdidRate[i] == mode) {
+            slots[((uint32_t)k * count / n + (mode - 1U)) % count] = (uint8_t)(i + 1U);
+            k++;
+        }
+    }
+}
+
+/**
+ * @brief Index of d in the server's periodic list, or -1.
+ */
+static int findPeriodic(UDS_Server_t *srv, const UDS_DidDesc_t *d) {
+    for (uint8_t i = 0; i < UDS_PDID_MAX; i++) {
+        if (srv->pdidRate[i] != 0 && srv->pdidList[i] == d) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Handles UDS Service 0x2A: ReadDataByPeriodicIdentifier.
+ *
+ * Format: [SID] [transmissionMode] { [periodicDataIdentifier] }
+ *
+ * Modes 0x01..0x03 (re)schedule the given pDIDs at the slow / medium /
+ * fast rate; 0x04 stops them, or all of them if none is given. pDID nn
+ * is DID 0xF2nn of the 0x22 registry, sent as [nn] [record] on the
+ * server's periodicId. Unknown pDIDs are skipped as in 0x22.
+ */
+void handleReadDataByPeriodicIdentifier(UDS_Server_t *srv, const uint8_t *req, uint16_t len) {
+    uint8_t mode = req[1];
+    const UDS_DidDesc_t *dids[UDS_PDID_MAX];
+    uint8_t count = 0;
+
+    if (mode < UDS_PERIODIC_SLOW || mode > UDS_PERIODIC_STOP) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_REQUEST_OUT_OF_RANGE;
+        return;
+    }
+    if (mode == UDS_PERIODIC_STOP && len == 2) {
+        stopPeriodic(srv);
+        srv->ctx.flow = UDS_FLOW_POS;
+        return;
+    }
+    if (len < 3) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_INCORRECT_LENGTH;
+        return;
+    }
+
+    for (uint16_t i = 2; i < len; i++) {
+        const UDS_DidDesc_t *d = findDid((uint16_t)(UDS_PDID_BASE | req[i]));
+        bool duplicate = false;
+
+        for (uint8_t j = 0; j < count; j++) {
+            duplicate |= (dids[j] == d);
+        }
+        /* One frame per pDID: the record must fit behind the pDID byte */
+        if (d != NULL && !duplicate && d->len <= 7U &&
+            (d->sessions & UDS_SESS_MASK(srv->session)) != 0) {
+            dids[count++] = d;
+        }
+    }
+
+    if (count == 0) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_REQUEST_OUT_OF_RANGE;
+        return;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        if (srv->securityLevel < dids[i]->security) {
+            srv->ctx.flow = UDS_FLOW_NEG;
+            srv->ctx.nrc = NRC_SECURITY_ACCESS_DENIED;
+            return;
+        }
+    }
+
+    if (mode != UDS_PERIODIC_STOP) {
+        /* Capacity once the listed pDIDs moved to this rate */
+        uint8_t total = count;
+        uint8_t atRate = count;
+
+        for (uint8_t i = 0; i < UDS_PDID_MAX; i++) {
+            bool listed = false;
+
+            if (srv->pdidRate[i] == 0) continue;
+            for (uint8_t j = 0; j < count; j++) {
+                listed |= (srv->pdidList[i] == dids[j]);
+            }
+            if (!listed) {
+                total++;
+                atRate += (srv->pdidRate[i] == mode) ? 1U : 0U;
+            }
+        }
+        if (total > UDS_PDID_MAX || atRate > udsPeriodicRates[mode - 1].count) {
+            srv->ctx.flow = UDS_FLOW_NEG;
+            srv->ctx.nrc = NRC_REQUEST_OUT_OF_RANGE;
+            return;
+        }
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        int index = findPeriodic(srv, dids[i]);
+
+        if (index >= 0) {
+            srv->pdidRate[index] = 0;
+            srv->pdidCount--;
+        }
+        if (mode != UDS_PERIODIC_STOP) {
+            for (index = 0; srv->pdidRate[index] != 0; index++) {}
+            srv->pdidList[index] = dids[i];
+            srv->pdidRate[index] = mode;
+            srv->pdidCount++;
+        }
+    }
+
+    buildSlots(srv, UDS_PERIODIC_SLOW);
+    buildSlots(srv, UDS_PERIODIC_MEDIUM);
+    buildSlots(srv, UDS_PERIODIC_FAST);
+    srv->ctx.flow = UDS_FLOW_POS;
+}
+
+/**
+ * @brief Background job of the 0x27 sendKey: waits for the CSEc CMAC check.
+ *
+ * jobParam = session << 8 | level being unlocked, jobIndex = sendKey
+ * sub-function to echo. A good key only grants the level if the session is
+ * still the one it was sent in and no new seed was requested meanwhile.
+ */
+static UDS_FlowType securityKeyJob(UDS_Server_t *srv) {
+    switch (SECA_PollVerify()) {
+        case SECA_VERIFY_PENDING:
+            return UDS_FLOW_PENDING;
+
+        case SECA_VERIFY_OK:
+            if (srv->session != (uint8_t)(srv->jobParam >> 8)) {
+                srv->ctx.nrc = NRC_CONDITIONS_NOT_CORRECT;
+                return UDS_FLOW_NEG;
+            }
+            if (srv->secSeedLevel != 0) {
+                srv->ctx.nrc = NRC_REQUEST_SEQUENCE_ERROR;
+                return UDS_FLOW_NEG;
+            }
+            SECA_RecordSuccess();
+            srv->securityLevel = (uint8_t)srv->jobParam;
+            srv->rspBuf[0] = (uint8_t)srv->jobIndex;
+            srv->ctx.payload = srv->rspBuf;
+            srv->ctx.payload_len = 1;
+            return UDS_FLOW_POS;
+
+        case SECA_VERIFY_FAILED:
+            srv->ctx.nrc = SECA_RecordFailure() ? NRC_EXCEEDED_NUMBER_OF_ATTEMPTS
+                                                : NRC_INVALID_KEY;
+            return UDS_FLOW_NEG;
+
+        default:
+            srv->ctx.nrc = NRC_CONDITIONS_NOT_CORRECT;
+            return UDS_FLOW_NEG;
+    }
+}
+
+/**
+ * @brief Handles UDS Service 0x27: SecurityAccess.
+ *
+ * requestSeed: [SID] [2n-1]             Response: [2n-1] [seed (16 bytes)]
+ * sendKey:     [SID] [2n] [key (16)]    Response: [2n]
+ *
+ * The key is the AES-128 CMAC of the seed (see seca.c). A seed is good for
+ * one sendKey; an already unlocked level gets an all-zero seed. A sendKey
+ * while a download still has data to program gets 0x22.
+ */
+void handleSecurityAccess(UDS_Server_t *srv, const uint8_t *req, uint16_t len) {
+    uint8_t sub = req[1] & (uint8_t)~UDS_SUPPRESS_POS_RSP_BIT;
+    uint8_t level = (uint8_t)((sub + 1U) / 2U);
+
+    if (sub == 0 || level != SECURITY_LEVEL_ENGINE) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_SUBFUNC_NOT_SUPPORTED;
+        return;
+    }
+
+    if (sub & 0x01) {
+        /* === requestSeed === */
+        if (len != 2) {
+            srv->ctx.flow = UDS_FLOW_NEG;
+            srv->ctx.nrc = NRC_INCORRECT_LENGTH;
+            return;
+        }
+        if (SECA_DelayActive()) {
+            srv->ctx.flow = UDS_FLOW_NEG;
+            srv->ctx.nrc = NRC_TIME_DELAY_NOT_EXPIRED;
+            return;
+        }
+
+        if (srv->securityLevel >= level) {
+            memset(&srv->rspBuf[1], 0, SECA_SEED_LEN);
+        } else {
+            if (SECA_GenerateSeed(srv->secSeed) != 0) {
+                srv->ctx.flow = UDS_FLOW_NEG;
+                srv->ctx.nrc = NRC_CONDITIONS_NOT_CORRECT;
+                return;
+            }
+            srv->secSeedLevel = level;
+            memcpy(&srv->rspBuf[1], srv->secSeed, SECA_SEED_LEN);
+        }
+
+        srv->rspBuf[0] = sub;
+        srv->ctx.flow = UDS_FLOW_POS;
+        srv->ctx.payload = srv->rspBuf;
+        srv->ctx.payload_len = 1 + SECA_SEED_LEN;
+        return;
+    }
+
+    /* === sendKey === */
+    if (len != 2 + SECA_KEY_LEN) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_INCORRECT_LENGTH;
+        return;
+    }
+    if (srv->secSeedLevel != level) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_REQUEST_SEQUENCE_ERROR;
+        return;
+    }
+    /* CSEc shares the FTFC with the download; the seed stays valid for a retry */
+    if (FLASHDL_Busy()) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_CONDITIONS_NOT_CORRECT;
+        return;
+    }
+    srv->secSeedLevel = 0;
+
+    if (SECA_DelayActive()) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_TIME_DELAY_NOT_EXPIRED;
+        return;
+    }
+
+    /* req is only valid during this call; CSEc reads the key asynchronously */
+    memcpy(srv->secKey, &req[2], SECA_KEY_LEN);
+    if (SECA_StartVerify(srv->secSeed, srv->secKey) != 0) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_BUSY_REPEAT_REQUEST;
+        return;
+    }
+
+    UDS_StartJob(srv, securityKeyJob);
+    srv->jobParam = (uint32_t)srv->session << 8 | level;
+    srv->jobIndex = sub;
+}
+
+/**
+ * @brief Response generator of 0x19 sub-functions 0x02 and 0x0A:
+ *        [sub] [availabilityMask] then [DTC (3)] [status] per listed DTC.
+ *
+ * gen_param = sub << 8 | statusMask. The count was fixed by the announced
+ * length when the request was accepted. The cursor (gen_record, gen_index)
+ * remembers where the last record came from, so each frame resumes the
+ * scan there and the whole list costs one pass over the index. A record
+ * once sent is never revisited; if the set shrank meanwhile, the missing
+ * records are sent as zeros.
+ */
+static int dtcListGen(UDS_Server_t *srv, uint16_t offset, uint8_t *dst, uint16_t len) {
+    UDS_Context *ctx = &srv->ctx;
+    uint8_t sub = (uint8_t)(ctx->gen_param >> 8);
+    uint8_t mask = (uint8_t)ctx->gen_param;
+    uint8_t rec[4];
+
+    while (len > 0) {
+        uint16_t from;
+        uint16_t n;
+
+        if (offset < 2) {
+            rec[0] = sub;
+            rec[1] = DTC_STATUS_AVAILABILITY_MASK;
+            from = offset;
+            n = 2 - offset;
+        } else {
+            uint16_t k = (offset - 2U) / 4U;
+            int index;
+
+            from = (offset - 2U) % 4U;
+            n = 4 - from;
+
+            if (sub == UDS_DTC_REPORT_SUPPORTED) {
+                index = (k < DTCIDX_Count()) ? (int)k : -1;
+            } else {
+                /* Frames are built in order: record k is the cursor's or the next one */
+                if (k != ctx->gen_record) {
+                    if (ctx->gen_record == 0xFFFFU) {
+                        index = DTCIDX_NextByMask(mask, 0);
+                    } else if (ctx->gen_index >= 0) {
+                        index = DTCIDX_NextByMask(mask, (uint16_t)(ctx->gen_index + 1));
+                    } else {
+                        index = -1;             /* Set ran out earlier */
+                    }
+                    ctx->gen_record = k;
+                    ctx->gen_index = (int16_t)index;
+                }
+                index = ctx->gen_index;
+            }
+
+            if (index >= 0) {
+                uint32_t dtc = DTCIDX_Dtc((uint16_t)index);
+                rec[0] = (uint8_t)(dtc >> 16);
+                rec[1] = (uint8_t)(dtc >> 8);
+                rec[2] = (uint8_t)dtc;
+                rec[3] = DTCIDX_Status((uint16_t)index);
+            } else {
+                memset(rec, 0, sizeof(rec));
+            }
+        }
+
+        if (n > len) n = len;
+        memcpy(dst, &rec[from], n);
+        dst += n;
+        offset += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Handles UDS Service 0x19: ReadDTCInformation.
+ *
+ * 0x01 reportNumberOfDTCByStatusMask:  [SID] [01] [mask]
+ * 0x02 reportDTCByStatusMask:          [SID] [02] [mask]
+ * 0x04 reportDTCSnapshotRecordByDTCNumber:      [SID] [04] [DTC (3)] [record]
+ * 0x06 reportDTCExtDataRecordByDTCNumber:       [SID] [06] [DTC (3)] [record]
+ * 0x0A reportSupportedDTC:             [SID] [0A]
+ *
+ * Status queries are answered from the RAM index (dtcidx.c); only 0x04 and
+ * 0x06 read the DTC's NVM slot. Lists are streamed into the ISO-TP sender.
+ */
+void handleReadDTCInformation(UDS_Server_t *srv, const uint8_t *req, uint16_t len) {
+    uint8_t sub = req[1] & (uint8_t)~UDS_SUPPRESS_POS_RSP_BIT;
+    uint8_t *p = srv->rspBuf;
+    uint16_t expected;
+
+    switch (sub) {
+        case UDS_DTC_REPORT_COUNT_BY_MASK:
+        case UDS_DTC_REPORT_BY_MASK:
+            expected = 3;
+            break;
+        case UDS_DTC_REPORT_SNAPSHOT:
+        case UDS_DTC_REPORT_EXT_DATA:
+            expected = 6;
+            break;
+        case UDS_DTC_REPORT_SUPPORTED:
+            expected = 2;
+            break;
+        default:
+            srv->ctx.flow = UDS_FLOW_NEG;
+            srv->ctx.nrc = NRC_SUBFUNC_NOT_SUPPORTED;
+            return;
+    }
+    if (len != expected) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_INCORRECT_LENGTH;
+        return;
+    }
+
+    if (sub == UDS_DTC_REPORT_COUNT_BY_MASK) {
+        uint16_t count = DTCIDX_CountByMask(req[2]);
+
+        *p++ = sub;
+        *p++ = DTC_STATUS_AVAILABILITY_MASK;
+        *p++ = DTC_FORMAT_ISO14229_1;
+        *p++ = (uint8_t)(count >> 8);
+        *p++ = (uint8_t)count;
+
+    } else if (sub == UDS_DTC_REPORT_BY_MASK || sub == UDS_DTC_REPORT_SUPPORTED) {
+        uint16_t count = (sub == UDS_DTC_REPORT_SUPPORTED) ? DTCIDX_Count()
+                                                           : DTCIDX_CountByMask(req[2]);
+
+        srv->ctx.gen_param = ((uint32_t)sub << 8) |
+                             ((sub == UDS_DTC_REPORT_BY_MASK) ? req[2] : 0U);
+        /* No record produced yet: the scan starts at index 0 */
+        srv->ctx.gen_record = 0xFFFFU;
+        srv->ctx.gen_index = -1;
+        UDS_SetResponseGen(srv, (uint16_t)(2U + 4U * count), dtcListGen);
+        return;
+
+    } else {
+        uint32_t dtc = ((uint32_t)req[2] << 16) | ((uint32_t)req[3] << 8) | req[4];
+        uint8_t record = req[5];
+        uint8_t slot[DTC_SLOT_USED_LEN];
+        int index = DTCIDX_Find(dtc);
+
+        /* Only record 0x01 exists; 0xFF asks for all records */
+        if (index < 0 || (record != 0x01 && record != 0xFF)) {
+            srv->ctx.flow = UDS_FLOW_NEG;
+            srv->ctx.nrc = NRC_REQUEST_OUT_OF_RANGE;
+            return;
+        }
+
+        *p++ = sub;
+        *p++ = req[2];
+        *p++ = req[3];
+        *p++ = req[4];
+        *p++ = DTCIDX_Status((uint16_t)index);
+
+        /* A DTC that was never stored is reported without records */
+        if (DTCIDX_ReadSlot((uint16_t)index, slot) == 0) {
+            *p++ = 0x01;
+            if (sub == UDS_DTC_REPORT_SNAPSHOT) {
+                *p++ = 0x01;                            /* Number of identifiers */
+                *p++ = (uint8_t)(DID_ENGINE_TEMP >> 8);
+                *p++ = (uint8_t)DID_ENGINE_TEMP;
+                memcpy(p, &slot[DTC_SLOT_SNAPSHOT_OFS], DTC_SLOT_SNAPSHOT_LEN);
+                p += DTC_SLOT_SNAPSHOT_LEN;
+            } else {
+                *p++ = slot[DTC_SLOT_OCCURRENCE_OFS];
+            }
+        }
+    }
+
+    srv->ctx.flow = UDS_FLOW_POS;
+    srv->ctx.payload = srv->rspBuf;
+    srv->ctx.payload_len = (uint16_t)(p - srv->rspBuf);
+}
+
+/**
+ * @brief Background job of 0x34: erases the sectors of the first block.
+ *
+ * jobParam = start address. Responds with maxNumberOfBlockLength, the
+ * largest 0x36 request (SID and counter included) one buffer and the
+ * ISO-TP receive buffer can both hold.
+ */
+static UDS_FlowType requestDownloadJob(UDS_Server_t *srv) {
+    int erase = FLASHDL_EraseStep(srv->jobParam + FLASHDL_BLOCK_SIZE);
+    uint16_t block = FLASHDL_BLOCK_SIZE;
+
+    if (erase < 0) {
+        abortDownload(srv);
+        srv->ctx.nrc = NRC_GENERAL_PROGRAMMING_FAILURE;
+        return UDS_FLOW_NEG;
+    }
+    if (erase > 0) {
+        return UDS_FLOW_PENDING;
+    }
+
+    /* Blocks before the last one must be a multiple of the 8-byte program unit */
+    if (srv->link.rxBufSize - 2U < block) {
+        block = (uint16_t)((srv->link.rxBufSize - 2U) & ~7U);
+    }
+    block += 2U;
+
+    srv->rspBuf[0] = 0x20;                     /* lengthFormatIdentifier: 2 bytes */
+    srv->rspBuf[1] = (uint8_t)(block >> 8);
+    srv->rspBuf[2] = (uint8_t)block;
+    srv->ctx.payload = srv->rspBuf;
+    srv->ctx.payload_len = 3;
+    return UDS_FLOW_POS;
+}
+
+/**
+ * @brief Handles UDS Service 0x34: RequestDownload.
+ *
+ * Format: [SID] [dataFormatIdentifier] [addressAndLengthFormatIdentifier]
+ *         [memoryAddress (1..4)] [memorySize (1..4)]
+ * Response: [0x20] [maxNumberOfBlockLength (16 bit)]
+ *
+ * Only unencrypted, uncompressed data (format 0x00) into a sector-aligned
+ * range inside FLASHDL_START..FLASHDL_END is accepted.
+ */
+void handleRequestDownload(UDS_Server_t *srv, const uint8_t *req, uint16_t len) {
+    uint8_t addrLen = req[2] & 0x0F;
+    uint8_t sizeLen = req[2] >> 4;
+    uint32_t address = 0;
+    uint32_t size = 0;
+
+    if (FLASHDL_Active()) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_CONDITIONS_NOT_CORRECT;
+        return;
+    }
+    if (req[1] != 0x00 || addrLen < 1 || addrLen > 4 || sizeLen < 1 || sizeLen > 4) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_REQUEST_OUT_OF_RANGE;
+        return;
+    }
+    if (len != 3U + addrLen + sizeLen) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_INCORRECT_LENGTH;
+        return;
+    }
+
+    for (uint8_t i = 0; i < addrLen; i++) {
+        address = (address << 8) | req[3 + i];
+    }
+    for (uint8_t i = 0; i < sizeLen; i++) {
+        size = (size << 8) | req[3 + addrLen + i];
+    }
+
+    if (FLASHDL_Begin(address, size) != 0) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_REQUEST_OUT_OF_RANGE;
+        return;
+    }
+    srv->dlOwner = true;
+    srv->dlBlocks = 0;
+
+    UDS_StartJob(srv, requestDownloadJob);
+    srv->jobParam = address;
+}
+
+/**
+ * @brief Background job of 0x36: the block is queued and FLASHDL_Poll()
+ *        programs it. Responds once the sectors of the next block are erased
+ *        and a buffer is free for it, so the tester's next 0x36 always finds
+ *        room while the current block is still being programmed.
+ *
+ * jobParam = blockSequenceCounter to echo.
+ */
+static UDS_FlowType transferDataJob(UDS_Server_t *srv) {
+    int erase = 0;
+
+    if (!FLASHDL_Failed()) {
+        erase = FLASHDL_EraseStep(FLASHDL_NextAddress() + FLASHDL_BLOCK_SIZE);
+    }
+    if (FLASHDL_Failed() || erase < 0) {
+        abortDownload(srv);
+        srv->ctx.nrc = NRC_GENERAL_PROGRAMMING_FAILURE;
+        return UDS_FLOW_NEG;
+    }
+    if (erase > 0 || !FLASHDL_BufferFree()) {
+        return UDS_FLOW_PENDING;
+    }
+
+    srv->rspBuf[0] = (uint8_t)srv->jobParam;
+    srv->ctx.payload = srv->rspBuf;
+    srv->ctx.payload_len = 1;
+    return UDS_FLOW_POS;
+}
+
+/**
+ * @brief Handles UDS Service 0x36: TransferData.
+ *
+ * Format: [SID] [blockSequenceCounter] [data]
+ * Response: [blockSequenceCounter]
+ *
+ * The counter starts at 1 and wraps from 0xFF to 0x00. A repeat of the last
+ * accepted block (its response was lost) is acknowledged without writing.
+ */
+void handleTransferData(UDS_Server_t *srv, const uint8_t *req, uint16_t len) {
+    uint8_t seq = req[1];
+
+    if (!srv->dlOwner || !FLASHDL_Active()) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_REQUEST_SEQUENCE_ERROR;
+        return;
+    }
+
+    if (srv->dlBlocks != 0 && seq == (uint8_t)srv->dlBlocks) {
+        srv->rspBuf[0] = seq;
+        srv->ctx.flow = UDS_FLOW_POS;
+        srv->ctx.payload = srv->rspBuf;
+        srv->ctx.payload_len = 1;
+        return;
+    }
+    if (seq != (uint8_t)(srv->dlBlocks + 1U)) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_WRONG_BLOCK_SEQUENCE_COUNTER;
+        return;
+    }
+
+    /* Overrun of memorySize, or a short block that is not the last one */
+    if (FLASHDL_Push(&req[2], len - 2U) != 0) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_TRANSFER_DATA_SUSPENDED;
+        return;
+    }
+    srv->dlBlocks++;
+
+    UDS_StartJob(srv, transferDataJob);
+    srv->jobParam = seq;
+}
+
+/**
+ * @brief Background job of 0x37: waits until the last buffer is programmed.
+ */
+static UDS_FlowType transferExitJob(UDS_Server_t *srv) {
+    if (FLASHDL_Failed()) {
+        abortDownload(srv);
+        srv->ctx.nrc = NRC_GENERAL_PROGRAMMING_FAILURE;
+        return UDS_FLOW_NEG;
+    }
+    if (FLASHDL_Busy()) {
+        return UDS_FLOW_PENDING;
+    }
+
+    abortDownload(srv);
+    srv->ctx.payload = NULL;
+    srv->ctx.payload_len = 0;
+    return UDS_FLOW_POS;
+}
+
+/**
+ * @brief Handles UDS Service 0x37: RequestTransferExit.
+ *
+ * Format: [SID]
+ *
+ * Accepted once memorySize bytes were transferred.
+ */
+void handleRequestTransferExit(UDS_Server_t *srv, const uint8_t *req, uint16_t len) {
+    if (!srv->dlOwner || !FLASHDL_Active() || FLASHDL_Remaining() != 0) {
+        srv->ctx.flow = UDS_FLOW_NEG;
+        srv->ctx.nrc = NRC_REQUEST_SEQUENCE_ERROR;
+        return;
+    }
+
+    UDS_StartJob(srv, transferExitJob);
 }
@@ -4,13 +4,36 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "FlexCan.h"
+#include "isotp.h"
+#include "seca.h"
 #include "dtc.h"
+#include "flashdl.h"
+#include "memrd.h"
+#include "periodic.h"
 
 // ===== UDS Service IDs =====
+#define UDS_SERVICE_SESSION_CONTROL   0x10
+#define UDS_SERVICE_TESTER_PRESENT    0x3E
 #define UDS_SERVICE_ECU_RESET         0x11
 #define UDS_SERVICE_READ_DID         0x22
+#define UDS_SERVICE_READ_MEMORY_BY_ADDRESS 0x23
+#define UDS_SERVICE_READ_DATA_BY_PERIODIC_ID 0x2A
+#define UDS_SERVICE_SECURITY_ACCESS   0x27
+#define UDS_SERVICE_DYNAMICALLY_DEFINE_DID 0x2C
 #define UDS_SERVICE_WRITE_DID        0x2E
 #define UDS_SERVICE_CLEAR_DTC        0x14   // <== NEW: Service 0x14
+#define UDS_SERVICE_READ_DTC_INFORMATION 0x19
+#define UDS_SERVICE_REQUEST_DOWNLOAD  0x34
+#define UDS_SERVICE_TRANSFER_DATA     0x36
+#define UDS_SERVICE_REQUEST_TRANSFER_EXIT 0x37
+
+#define UDS_SID_BASE                 0x10   // Lowest request SID in udsServices[]
+#define UDS_SID_COUNT                0x30   // Request SIDs 0x10..0x3F
+#define UDS_SUPPRESS_POS_RSP_BIT     0x80   // Sub-function bit 7: no positive response
+#define UDS_RSP_BUF_SIZE             64U    // Per-server scratch for short fixed responses
+
+#define TX_MSG_ID_UDS                TX_MSG_ID   // Physical response identifier, also answers functional requests
+#define TX_MSG_ID_PERIODIC           0x668       // 0x2A periodic frames: [pDID] [record], no PCI
 
 // ===== NRC (Negative Response Codes) =====
 #define NRC_SERVICE_NOT_SUPPORTED        0x11
@@ -21,44 +44,264 @@
 #define NRC_REQUEST_OUT_OF_RANGE         0x31
 #define NRC_GENERAL_PROGRAMMING_FAILURE  0x72
 #define NRC_RESPONSE_TOO_LONG            0x14
+#define NRC_SERVICE_NOT_SUPPORTED_IN_SESSION 0x7F
+#define NRC_BUSY_REPEAT_REQUEST          0x21
+#define NRC_RESPONSE_PENDING             0x78
+#define NRC_REQUEST_SEQUENCE_ERROR       0x24
+#define NRC_INVALID_KEY                  0x35
+#define NRC_EXCEEDED_NUMBER_OF_ATTEMPTS  0x36
+#define NRC_TIME_DELAY_NOT_EXPIRED       0x37
+#define NRC_UPLOAD_DOWNLOAD_NOT_ACCEPTED 0x70
+#define NRC_TRANSFER_DATA_SUSPENDED      0x71
+#define NRC_WRONG_BLOCK_SEQUENCE_COUNTER 0x73
+#define NRC_SUBFUNC_NOT_SUPPORTED_IN_SESSION 0x7E
+
+// ===== 0x19 sub-functions =====
+#define UDS_DTC_REPORT_COUNT_BY_MASK  0x01
+#define UDS_DTC_REPORT_BY_MASK        0x02
+#define UDS_DTC_REPORT_SNAPSHOT       0x04
+#define UDS_DTC_REPORT_EXT_DATA       0x06
+#define UDS_DTC_REPORT_SUPPORTED      0x0A
+
+// ===== 0x2C sub-functions =====
+#define UDS_DDDID_DEFINE_BY_ID      0x01
+#define UDS_DDDID_DEFINE_BY_MEMORY  0x02
+#define UDS_DDDID_CLEAR             0x03
+
+// ===== 0x2A transmissionMode =====
+#define UDS_PERIODIC_SLOW     0x01
+#define UDS_PERIODIC_MEDIUM   0x02
+#define UDS_PERIODIC_FAST     0x03
+#define UDS_PERIODIC_STOP     0x04
+
+// ===== Periodic Transmission (0x2A) =====
+#define UDS_PERIODIC_SLOW_MS    1000U   // Rates, multiples of PERIODIC_TICK_MS
+#define UDS_PERIODIC_MEDIUM_MS  200U
+#define UDS_PERIODIC_FAST_MS    50U
+#define UDS_PDID_MAX            8U      // Periodic DIDs scheduled at once, all rates together
+#define UDS_PDID_BASE           0xF200  // periodicDataIdentifier nn is DID 0xF2nn
+#define UDS_PDID_SLOTS          ((UDS_PERIODIC_SLOW_MS + UDS_PERIODIC_MEDIUM_MS + \
+                                  UDS_PERIODIC_FAST_MS) / PERIODIC_TICK_MS)  // One slot per tick of each rate
+#define UDS_PERIODIC_TX_PRIO    6U      // Below responses (TX_PRIO_DEFAULT)
+
+// ===== Server Timing (ISO 14229-2) =====
+#define UDS_P2_SERVER_MS          50UL    // Request to first response
+#define UDS_P2_STAR_SERVER_MS     5000UL  // Between NRC 0x78 and the next response
+#define UDS_P2_STAR_PROG_MS       10000UL // P2* in the programming session (flash erase)
+#define UDS_S3_SERVER_MS          5000UL  // Non-default session ends after this without a request
+#define UDS_RSP_PENDING_MARGIN_MS 10UL    // Send NRC 0x78 this long before P2 / P2* expire
 
 // ===== DIDs =====
 #define DID_ENGINE_TEMP      0xF190
 #define DID_ENGINE_LIGHT     0xF191
 #define DID_THRESHOLD        0xF192
+#define DID_PERIODIC_ENGINE  0xF201   // engineTemp, engineLight, threshold; fits one 0x2A frame
+#define DID_PERIODIC_CAN     0xF202   // CAN error state, TEC, REC
+#define DID_CAN_ERROR_STATS  0xFD00   // Error state and counters of the server's CAN instance (CAN_ErrorStats_t)
+
+#define UDS_DID_MAX_PER_REQ  16U      // DIDs accepted in one 0x22 request
+#define UDS_DID_MAX_LEN      48U      // Longest record in the DID registry
+
+#define UDS_DDDID_FIRST          0xF300   // Range 0x2C may define
+#define UDS_DDDID_LAST           0xF3FF
+#define UDS_DDDID_MAX            4U       // Definitions held at once
+#define UDS_DDDID_MAX_SOURCES    8U       // Source fragments per definition
+#define UDS_DDDID_PERSIST        1        // 1 = definitions survive a reset (NVM)
+#define UDS_DDDID_NVM_OFFSET     0x0010UL // After the SecurityAccess record, outside the DTC region
+#define UDS_DDDID_NVM_SLOT       (3UL + UDS_DDDID_MAX_SOURCES * 7UL)  // [DDDID] [count] { [type] [pos] [size] [source (4)] }
+#define UDS_DDDID_NVM_SIZE       (UDS_DDDID_MAX * UDS_DDDID_NVM_SLOT)
+
+#define ADC_CH_ENGINE_TEMP   12U      // ADC0_SE12 (PTC14)
+#define ENGINE_TEMP_THRESHOLD_DEFAULT 3000U  // ADC counts
+
+// ===== Diagnostic Sessions =====
+#define UDS_SESSION_DEFAULT      0x01
+#define UDS_SESSION_PROGRAMMING  0x02
+#define UDS_SESSION_EXTENDED     0x03
+
+#define UDS_SESS_MASK(s)         (1U << ((s) - 1U))   // Bit of a session in UDS_ServiceDesc_t.sessions
+#define UDS_SESS_ALL             (UDS_SESS_MASK(UDS_SESSION_DEFAULT) | \
+                                  UDS_SESS_MASK(UDS_SESSION_PROGRAMMING) | \
+                                  UDS_SESS_MASK(UDS_SESSION_EXTENDED))
 
 // ===== Security Levels =====
 #define SECURITY_LEVEL_NONE     0
 #define SECURITY_LEVEL_ENGINE   1
 
+// ===== Server Instance =====
+/**
+ * @brief Defines the type of response flow for the current UDS transaction.
+ */
+typedef enum {
+    UDS_FLOW_NONE = 0, /* No response to be sent */
+    UDS_FLOW_POS,      /* Positive response */
+    UDS_FLOW_NEG,      /* Negative response */
+    UDS_FLOW_PENDING   /* Background job running, see UDS_StartJob() */
+} UDS_FlowType;
+
+struct UDS_Server;
+
+/* Pull-based response body: writes exactly len bytes starting at body offset
+ * into dst. Called per ISO-TP frame, possibly again for the same offset.
+ * Returns 0 or an ISOTP_TxFill_t result (not ready yet, failed). */
+typedef int (*UDS_RspGen_t)(struct UDS_Server *srv, uint16_t offset, uint8_t *dst, uint16_t len);
+
+/**
+ * @brief Holds all necessary information for responding to the current UDS request.
+ */
+typedef struct {
+    UDS_FlowType   flow;          /* POS / NEG / NONE */
+    uint8_t        sid;           /* Requested Service ID */
+    uint8_t        nrc;           /* Negative Response Code if NEG */
+    const uint8_t* payload;       /* Pointer to POS response payload (if any) */
+    UDS_RspGen_t   gen;           /* Or generator of the payload, see UDS_SetResponseGen() */
+    uint32_t       gen_param;     /* Generator state, owned by the handler */
+    uint16_t       gen_record;    /* Generator cursor: last record produced, */
+    int16_t        gen_index;     /* and the index it was taken from */
+    uint16_t       payload_len;   /* Length of POS response payload */
+    uint32_t       req_id;        /* CAN identifier the request arrived on */
+    bool           suppress_pos;  /* suppressPosRspMsgIndicationBit was set */
+} UDS_Context;
+
+/**
+ * @brief One logical diagnostic server: its addresses, transport, buffers,
+ *        session and security state. Servers share nothing but the const
+ *        service table, so several can run side by side (e.g. the ECU's own
+ *        physical address plus gateway proxies for sub-ECUs).
+ */
+typedef UDS_FlowType (*UDS_JobStep_t)(struct UDS_Server *srv);
+
+typedef void (*UDS_DidRead_t)(struct UDS_Server *srv, uint8_t *dst);
+
+/**
+ * @brief One fragment of a 0x2C gather list, resolved when the DID is defined.
+ */
+typedef struct UDS_Gather {
+    const uint8_t            *src;     /* Memory copied straight, or NULL for */
+    const struct UDS_DidDesc *did;     /* a slice of this DID's read() record */
+    uint8_t                   offset;  /* Slice start in that record */
+    uint8_t                   len;
+} UDS_Gather_t;
+
+/**
+ * @brief One entry of the 0x22 DID registry.
+ */
+typedef struct UDS_DidDesc {
+    uint16_t      did;
+    uint16_t      len;          /* Record length, at most UDS_DID_MAX_LEN */
+    const void   *data;         /* Record copied straight from memory, or */
+    UDS_DidRead_t read;         /* read(srv, dst) writes len bytes, or */
+    const UDS_Gather_t *gather; /* record gathered from gatherCount fragments (0x2C) */
+    uint8_t       gatherCount;
+    uint8_t       sessions;     /* UDS_SESS_MASK() of the sessions it is readable in */
+    uint8_t       security;     /* Minimum UDS_Server_t.securityLevel */
+} UDS_DidDesc_t;
+
+typedef struct UDS_Server {
+    ISOTP_Link_t   link;          /* rxId = physical request ID, txId = response ID */
+    uint8_t        rspBuf[UDS_RSP_BUF_SIZE]; /* Short payloads; in use while link is busy */
+    UDS_Context    ctx;           /* Request being processed */
+    uint8_t        session;       /* Active diagnostic session */
+    uint8_t        securityLevel; /* Unlocked security level */
+    uint32_t       reqTime;       /* CAN time of the request, then of the last NRC 0x78 */
+    uint32_t       s3Time;        /* CAN time the S3 timer was last restarted */
+    UDS_JobStep_t  job;           /* Running background job, NULL = none */
+    uint32_t       jobParam;      /* Job state, owned by the job */
+    uint32_t       jobIndex;
+    bool           jobFailed;
+    bool           jobPending;    /* NRC 0x78 already sent for this request */
+    const UDS_DidDesc_t *didList[UDS_DID_MAX_PER_REQ]; /* DIDs of the 0x22 response */
+    uint8_t        didCount;
+    uint8_t        didCached;     /* didList index + 1 of the entry in didRecord, 0 = none */
+    uint8_t        didRecord[2 + UDS_DID_MAX_LEN]; /* [DID][record] being streamed */
+    uint8_t        didHeld;       /* DDDID slots the streamed 0x22 response reads, one bit each */
+    uint8_t        secSeed[SECA_SEED_LEN];  /* Last seed sent, input of the key check */
+    uint8_t        secKey[SECA_KEY_LEN];    /* Key under verification by CSEc */
+    uint8_t        secSeedLevel;  /* Level the seed was requested for, 0 = none */
+    uint32_t       dlBlocks;      /* 0x36 blocks accepted since 0x34 */
+    bool           dlOwner;       /* This server opened the running download */
+    bool           memOwner;      /* This server holds the 0x23 memory stream */
+    uint32_t       periodicId;    /* CAN identifier of the 0x2A frames */
+    const UDS_DidDesc_t *pdidList[UDS_PDID_MAX]; /* Scheduled periodic DIDs */
+    uint8_t        pdidRate[UDS_PDID_MAX];       /* transmissionMode of each, 0 = free */
+    uint8_t        pdidCount;
+    uint8_t        pdidSlots[UDS_PDID_SLOTS];    /* Slot tables of the rates, pdidList index + 1, 0 = idle */
+    uint32_t       pdidTick;      /* Last PERIODIC_Ticks() value served */
+    uint8_t        heldRsp[8];    /* Single Frame held until the link is free: a functional */
+    uint8_t        heldRspDlc;    /* answer or a 0x21 to a request while busy; 0 = none */
+    bool           rspPending;    /* ctx response not queued yet (TX queue full), retried */
+} UDS_Server_t;
+
+/* Static initializer; rxBuffer must be an array owned by this server */
+#define UDS_SERVER_INIT(canInst, reqId, rspId, rxBuffer) {              \
+    .link = {                                                           \
+        .can       = (canInst),                                         \
+        .txId      = (rspId),                                           \
+        .rxId      = (reqId),                                           \
+        .funcId    = RX_FUNC_MSG_ID,                                    \
+        .rxBuf     = (rxBuffer),                                        \
+        .rxBufSize = sizeof(rxBuffer),                                  \
+    },                                                                  \
+    .periodicId    = TX_MSG_ID_PERIODIC,                                \
+    .session       = UDS_SESSION_DEFAULT,                               \
+    .securityLevel = SECURITY_LEVEL_NONE,                               \
+}
+
+// ===== Service Table =====
+typedef void (*UDS_Handler_t)(UDS_Server_t *srv, const uint8_t *req, uint16_t len);
+
+/**
+ * @brief Static description of one service; checked by the dispatcher before
+ *        the handler runs, so handlers only see requests that passed them.
+ */
+typedef struct {
+    UDS_Handler_t handler;      /* NULL = service not supported */
+    uint16_t      minLen;       /* Request length including the SID */
+    uint16_t      maxLen;
+    uint8_t       sessions;     /* UDS_SESS_MASK() of the sessions it is allowed in */
+    uint8_t       security;     /* Minimum UDS_Server_t.securityLevel */
+    bool          subFunction;  /* req[1] is a sub-function with the suppressPosRsp bit */
+    bool          functional;   /* Also served on the functional address (link.funcId) */
+    bool          exclusive;    /* Changes server state: NRC 0x21 while a physical request runs */
+} UDS_ServiceDesc_t;
+
 // ===== Global Variables =====
-extern uint8_t currentSecurityLevel;
 extern uint16_t engineTemp;
+extern uint8_t engineLight;             // Engine lamp state, 0 = off
+extern uint16_t engineTempThreshold;
 
 // ===== Function Prototypes =====
-void UDS_DispatchService(const CAN_Message_t msg_rx);
-void UDS_SendResponse(void);
+void UDS_OnFrame(UDS_Server_t *srv, const CAN_Message_t *msg);
+void UDS_DispatchService(UDS_Server_t *srv, const uint8_t *req, uint16_t len);
+void UDS_SendResponse(UDS_Server_t *srv);
+void UDS_SendMultiFrameISO_TP(UDS_Server_t *srv, const uint8_t *data, uint16_t len);
+void UDS_Tick(UDS_Server_t *srv);
+void UDS_StartJob(UDS_Server_t *srv, UDS_JobStep_t step);
+void UDS_SetResponseGen(UDS_Server_t *srv, uint16_t len, UDS_RspGen_t gen);
+void UDS_RestoreDddids(void);
 
 // Service handlers
-void handleECUReset(const CAN_Message_t msg_rx);
-void handleReadDataByIdentifier(const CAN_Message_t msg_rx);
-void handleWriteDataByIdentifier(const CAN_Message_t msg_rx);
-void handleClearDiagnosticInformation(const CAN_Message_t msg_rx); // <== NEW
+void handleSessionControl(UDS_Server_t *srv, const uint8_t *req, uint16_t len);
+void handleTesterPresent(UDS_Server_t *srv, const uint8_t *req, uint16_t len);
+void handleSecurityAccess(UDS_Server_t *srv, const uint8_t *req, uint16_t len);
+void handleReadDTCInformation(UDS_Server_t *srv, const uint8_t *req, uint16_t len);
+void handleECUReset(UDS_Server_t *srv, const uint8_t *req, uint16_t len);
+void handleReadDataByIdentifier(UDS_Server_t *srv, const uint8_t *req, uint16_t len);
+void handleReadMemoryByAddress(UDS_Server_t *srv, const uint8_t *req, uint16_t len);
+void handleDynamicallyDefineDataIdentifier(UDS_Server_t *srv, const uint8_t *req, uint16_t len);
+void handleReadDataByPeriodicIdentifier(UDS_Server_t *srv, const uint8_t *req, uint16_t len);
+void handleWriteDataByIdentifier(UDS_Server_t *srv, const uint8_t *req, uint16_t len);
+void handleClearDiagnosticInformation(UDS_Server_t *srv, const uint8_t *req, uint16_t len); // <== NEW
+void handleRequestDownload(UDS_Server_t *srv, const uint8_t *req, uint16_t len);
+void handleTransferData(UDS_Server_t *srv, const uint8_t *req, uint16_t len);
+void handleRequestTransferExit(UDS_Server_t *srv, const uint8_t *req, uint16_t len);
 
 // External dependencies
 bool isResetConditionOk(void);
-bool isSecurityAccessGranted(uint16_t did);
 bool isConditionOk(uint16_t did);
 bool writeToNVM(uint16_t did, uint16_t value);
-bool clearDTCFromNVM(uint32_t groupOfDTC)
-bool isGroupOfDTCSupported(uint32_t groupOfDTC);
-bool isConditionOkForClear(void);
-bool clearDTCFromNVM(uint32_t groupOfDTC);
 uint16_t ReadADCValue(void);
 void ECU_Reset(void);
 
-// Internal DTC operations (optional expose)
-bool clearDTCFromNVM(uint32_t dtc);  // <== NEW helper for service 0x14
-void handleClearDiagnosticInformation(const CAN_Message_t msg_rx);
 
 #endif /* UDS_H_ */
@@ -0,0 +1,30 @@
+/*
+ * Host build stand-in for the DTC / NVM storage module (dtc.h).
+ *
+ * Same interface the firmware uses: byte-addressed NVM with erase-to-0xFF,
+ * and a fixed region of DTC_SLOT_SIZE slots. Backed by RAM in fake_nvm.c.
+ */
+
+#ifndef DTC_H
+#define DTC_H
+
+#include <stdint.h>
+
+#define NVM_OK                 0
+#define NVM_ERROR              (-1)
+#define NVM_SIZE               0x400UL
+
+#define DTC_SLOT_SIZE          16U
+#define DTC_SLOT_COUNT         8U
+#define DTC_REGION_OFFSET      0x100UL
+
+#define DTC_ENGINE_OVERHEAT    0x012345UL
+
+int NVM_Erase(uint32_t offset, uint32_t len);
+int NVM_Read(uint32_t offset, uint8_t *data, uint32_t len);
+int NVM_Write(uint32_t offset, const uint8_t *data, uint32_t len);
+
+uint8_t DTC_GetCount(void);
+int8_t DTC_Find(uint32_t dtc);
+
+#endif /* DTC_H */
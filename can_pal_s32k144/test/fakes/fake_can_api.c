@@ -0,0 +1,70 @@
+/*
+ * @brief  Per-instance FlexCAN API model, see fake_can_api.h.
+ */
+
+#include "fake_can_api.h"
+#include <string.h>
+
+void FAKECANAPI_Init(CAN_Instance_t *can) {
+    memset(can, 0, sizeof(*can));
+    can->bitrate = CAN_NOMINAL_BITRATE;
+}
+
+void FAKECANAPI_Advance(CAN_Instance_t *can, uint32_t ticks) {
+    can->now += ticks;
+}
+
+/**
+ * @brief Sends the oldest queued frame: stamps it with the current time,
+ *        runs its TX callback and returns it in *msg.
+ * @return 0, or -1 if nothing was queued.
+ */
+int FAKECANAPI_TakeTx(CAN_Instance_t *can, CAN_Message_t *msg) {
+    uint32_t i = can->txTail % FAKECANAPI_TX_DEPTH;
+
+    if (can->txTail == can->txHead) {
+        return -1;
+    }
+    can->tx[i].msg.timestamp = can->now;
+    *msg = can->tx[i].msg;
+    can->txTail++;
+    if (can->tx[i].callback != NULL) {
+        can->tx[i].callback(msg, CAN_TX_OK, can->tx[i].context);
+    }
+    return 0;
+}
+
+int FLEXCAN_transmit_async(CAN_Instance_t *can, const CAN_Message_t *msg, uint8_t prio,
+                           CAN_TxCallback_t callback, void *context) {
+    uint32_t i = can->txHead % FAKECANAPI_TX_DEPTH;
+
+    (void)prio;
+    if (can->txHead - can->txTail >= FAKECANAPI_TX_DEPTH) {
+        return -1;
+    }
+    can->tx[i].msg = *msg;
+    can->tx[i].callback = callback;
+    can->tx[i].context = context;
+    can->txHead++;
+    return 0;
+}
+
+int FLEXCAN_transmit_msg(CAN_Instance_t *can, const CAN_Message_t *msg) {
+    return FLEXCAN_transmit_async(can, msg, TX_PRIO_DEFAULT, NULL, NULL);
+}
+
+uint32_t FLEXCAN_get_time(CAN_Instance_t *can) {
+    return can->now;
+}
+
+uint32_t FLEXCAN_ticks_to_us(CAN_Instance_t *can, uint32_t ticks) {
+    return (uint32_t)(((uint64_t)ticks * 1000000ULL) / can->bitrate);
+}
+
+uint32_t FLEXCAN_rx_pending(CAN_Instance_t *can) {
+    return can->rxPending;
+}
+
+void FLEXCAN_get_error_stats(CAN_Instance_t *can, CAN_ErrorStats_t *stats) {
+    *stats = can->errStats;
+}
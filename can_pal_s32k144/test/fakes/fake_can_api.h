@@ -0,0 +1,38 @@
+/*
+ * Host stand-in for the FlexCAN driver API (FlexCan.h) above the registers.
+ *
+ * Used where the protocol layers are under test rather than the driver: any
+ * number of instances can be created, each with its own time base, TX queue
+ * and error counters, and nothing is shared between them. Frames queued by
+ * the code under test are "sent" when the test takes them off the queue,
+ * which also runs their TX callback, as the MB interrupt would.
+ */
+
+#ifndef FAKE_CAN_API_H_
+#define FAKE_CAN_API_H_
+
+#include <stdint.h>
+#include "FlexCan.h"
+
+#define FAKECANAPI_TX_DEPTH  (TX_QUEUE_SIZE + TX_MB_COUNT)
+
+struct CAN_Instance {
+    uint32_t now;                   // CAN time in bit times
+    uint32_t bitrate;
+    struct {
+        CAN_Message_t    msg;
+        CAN_TxCallback_t callback;
+        void            *context;
+    } tx[FAKECANAPI_TX_DEPTH];
+    uint32_t txHead;
+    uint32_t txTail;
+    uint32_t rxPending;             // Reported by FLEXCAN_rx_pending()
+    CAN_ErrorStats_t errStats;
+};
+
+// ===== Function Prototypes =====
+void FAKECANAPI_Init(CAN_Instance_t *can);
+void FAKECANAPI_Advance(CAN_Instance_t *can, uint32_t ticks);
+int  FAKECANAPI_TakeTx(CAN_Instance_t *can, CAN_Message_t *msg);
+
+#endif /* FAKE_CAN_API_H_ */
@@ -0,0 +1,193 @@
+/*
+ * @brief  RAM model of the FlexCAN registers the driver touches.
+ *
+ * Frames "arriving from the bus" go into a FAKECAN_FIFO_DEPTH deep Rx FIFO
+ * whose head is presented in MB0 exactly as the hardware does: CS word with
+ * DLC, IDE and TIMESTAMP, ID word, then big-endian payload words. IFLAG1 bit
+ * 5 (frame available), 6 (warning) and 7 (overflow) follow the reference
+ * manual, including the pop on a write-1 to bit 5. TX mailboxes are completed
+ * on request and decoded back into CAN_Message_t.
+ */
+
+#include "fake_can_regs.h"
+#include <string.h>
+#include <time.h>
+
+#define FIFO_AVAILABLE  (1UL << 5)
+#define FIFO_WARNING    (1UL << 6)
+#define FIFO_OVERFLOW   (1UL << 7)
+
+CAN_Type fakeCanRegs[CAN_INSTANCE_COUNT];
+PCC_Type fakePccRegs;
+
+static struct {
+    CAN_Message_t frames[FAKECAN_FIFO_DEPTH];
+    uint16_t      stamps[FAKECAN_FIFO_DEPTH];
+    uint32_t      head;
+    uint32_t      count;
+} fifo[CAN_INSTANCE_COUNT];
+
+static uint32_t instanceOf(volatile CAN_Type *base) {
+    return (uint32_t)((CAN_Type *)base - fakeCanRegs);
+}
+
+/* Presents the FIFO head in MB0 */
+static void loadOutput(CAN_Type *base) {
+    uint32_t n = instanceOf(base);
+    const CAN_Message_t *msg = &fifo[n].frames[fifo[n].head];
+    uint32_t cs = ((uint32_t)(msg->dlc & 0xF) << 16) | fifo[n].stamps[fifo[n].head];
+
+    if (msg->flags & CAN_MSG_EXT) {
+        base->RAMn[1] = msg->canID & 0x1FFFFFFFUL;
+        cs |= 1UL << 21;
+    } else {
+        base->RAMn[1] = (msg->canID & 0x7FFUL) << 18;
+    }
+    base->RAMn[0] = cs;
+    base->RAMn[2] = __builtin_bswap32(msg->words[0]);
+    base->RAMn[3] = __builtin_bswap32(msg->words[1]);
+    base->IFLAG1 |= FIFO_AVAILABLE;
+}
+
+void FAKECAN_Reset(CAN_Type *base) {
+    memset(base, 0, sizeof(*base));
+    memset(&fifo[instanceOf(base)], 0, sizeof(fifo[0]));
+    /* Out of reset the module sits in freeze mode */
+    base->MCR = CAN_MCR_FRZACK_MASK;
+}
+
+/**
+ * @brief A frame that passed the acceptance filter has been received.
+ * @return 0 if the FIFO took it, -1 if it was lost (IFLAG1[BUF7I] set).
+ */
+int FAKECAN_Deliver(CAN_Type *base, const CAN_Message_t *msg, uint16_t stamp) {
+    uint32_t n = instanceOf(base);
+    uint32_t slot;
+
+    if (fifo[n].count == FAKECAN_FIFO_DEPTH) {
+        base->IFLAG1 |= FIFO_OVERFLOW;
+        return -1;
+    }
+    slot = (fifo[n].head + fifo[n].count) % FAKECAN_FIFO_DEPTH;
+    fifo[n].frames[slot] = *msg;
+    fifo[n].stamps[slot] = stamp;
+    fifo[n].count++;
+    if (fifo[n].count == FAKECAN_FIFO_WARN) {
+        base->IFLAG1 |= FIFO_WARNING;
+    }
+    if (fifo[n].count == 1) {
+        loadOutput(base);
+    }
+    return 0;
+}
+
+uint32_t FAKECAN_FifoLevel(CAN_Type *base) {
+    return fifo[instanceOf(base)].count;
+}
+
+void FAKECAN_ClearIflag(volatile CAN_Type *base, uint32_t mask) {
+    uint32_t n = instanceOf(base);
+    CAN_Type *regs = (CAN_Type *)base;
+
+    /* The Rx FIFO only pops while it is enabled (MCR[RFEN]) */
+    if ((mask & FIFO_AVAILABLE) && (regs->IFLAG1 & FIFO_AVAILABLE) &&
+        (regs->MCR & CAN_MCR_RFEN_MASK) && fifo[n].count != 0) {
+        regs->IFLAG1 &= ~FIFO_AVAILABLE;
+        fifo[n].head = (fifo[n].head + 1) % FAKECAN_FIFO_DEPTH;
+        fifo[n].count--;
+        if (fifo[n].count != 0) {
+            loadOutput(regs);
+        }
+        mask &= ~FIFO_AVAILABLE;
+    }
+    regs->IFLAG1 &= ~mask;
+}
+
+/* Freeze mode is entered (FRZACK set) once FRZ and HALT are both set, and left
+ * as soon as either is cleared; the module is ready again right away. */
+void FAKECAN_WriteMcr(volatile CAN_Type *base, uint32_t value) {
+    uint32_t freeze = CAN_MCR_FRZ_MASK | CAN_MCR_HALT_MASK;
+
+    value &= ~(CAN_MCR_FRZACK_MASK | CAN_MCR_NOTRDY_MASK);
+    if ((value & freeze) == freeze) {
+        value |= CAN_MCR_FRZACK_MASK | CAN_MCR_NOTRDY_MASK;
+    }
+    base->MCR = value;
+}
+
+/**
+ * @brief true if mailbox mb holds a frame waiting for arbitration (CODE 0xC).
+ */
+int FAKECAN_TxPending(CAN_Type *base, uint32_t mb) {
+    return ((base->RAMn[4 * mb] >> 24) & 0xF) == 0xC;
+}
+
+/**
+ * @brief Decodes the frame waiting in TX mailbox mb without sending it.
+ * @return 0, or -1 if the mailbox holds nothing to send.
+ */
+int FAKECAN_PeekTx(CAN_Type *base, uint32_t mb, CAN_Message_t *msg) {
+    uint32_t cs = base->RAMn[4 * mb];
+    uint32_t id = base->RAMn[4 * mb + 1];
+
+    if (!FAKECAN_TxPending(base, mb)) {
+        return -1;
+    }
+    memset(msg, 0, sizeof(*msg));
+    msg->dlc = (uint8_t)((cs >> 16) & 0xF);
+    if (cs & (1UL << 21)) {
+        msg->flags = CAN_MSG_EXT;
+        msg->canID = id & 0x1FFFFFFFUL;
+    } else {
+        msg->canID = (id >> 18) & 0x7FFUL;
+    }
+    msg->words[0] = __builtin_bswap32(base->RAMn[4 * mb + 2]);
+    msg->words[1] = __builtin_bswap32(base->RAMn[4 * mb + 3]);
+    return 0;
+}
+
+/**
+ * @brief Sends the frame in TX mailbox mb: decodes it into *sent (if not
+ *        NULL), writes back CODE INACTIVE and the TIMESTAMP, and raises its
+ *        IFLAG1 bit.
+ * @return 0, or -1 if the mailbox held nothing to send.
+ */
+int FAKECAN_CompleteTx(CAN_Type *base, uint32_t mb, uint16_t stamp, CAN_Message_t *sent) {
+    uint32_t cs = base->RAMn[4 * mb];
+    CAN_Message_t msg;
+
+    if (FAKECAN_PeekTx(base, mb, &msg) != 0) {
+        return -1;
+    }
+    if (sent != NULL) {
+        *sent = msg;
+    }
+    base->RAMn[4 * mb] = (0x8UL << 24) | (cs & 0x00FF0000UL) | stamp;
+    base->IFLAG1 |= 1UL << mb;
+    return 0;
+}
+
+/**
+ * @brief Local priority (ID word bits 31..29) of the frame in mailbox mb.
+ */
+uint8_t FAKECAN_TxPrio(CAN_Type *base, uint32_t mb) {
+    return (uint8_t)(base->RAMn[4 * mb + 1] >> 29);
+}
+
+void FAKECAN_SetTimer(CAN_Type *base, uint16_t ticks) {
+    base->TIMER = ticks;
+}
+
+/**
+ * @brief Host cycle counter: the TSC on x86, nanoseconds elsewhere.
+ */
+uint32_t FAKECAN_CycleCount(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return (uint32_t)__builtin_ia32_rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+#endif
+}
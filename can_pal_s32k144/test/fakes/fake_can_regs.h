@@ -0,0 +1,23 @@
+#ifndef FAKE_CAN_REGS_H_
+#define FAKE_CAN_REGS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdk_project_config.h"
+#include "FlexCan.h"
+
+// ===== FlexCAN register model (classic mode, Rx FIFO) =====
+#define FAKECAN_FIFO_DEPTH   6U      // Output mailbox plus five hidden entries, as on S32K144
+#define FAKECAN_FIFO_WARN    5U      // IFLAG1[BUF6I] once this many frames are held
+
+// ===== Function Prototypes =====
+void FAKECAN_Reset(CAN_Type *base);
+int  FAKECAN_Deliver(CAN_Type *base, const CAN_Message_t *msg, uint16_t stamp);
+uint32_t FAKECAN_FifoLevel(CAN_Type *base);
+int  FAKECAN_TxPending(CAN_Type *base, uint32_t mb);
+int  FAKECAN_PeekTx(CAN_Type *base, uint32_t mb, CAN_Message_t *msg);
+int  FAKECAN_CompleteTx(CAN_Type *base, uint32_t mb, uint16_t stamp, CAN_Message_t *sent);
+uint8_t FAKECAN_TxPrio(CAN_Type *base, uint32_t mb);
+void FAKECAN_SetTimer(CAN_Type *base, uint16_t ticks);
+
+#endif /* FAKE_CAN_REGS_H_ */
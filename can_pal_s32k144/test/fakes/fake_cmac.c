@@ -0,0 +1,135 @@
+/*
+ * @brief  Software AES-128 CMAC (NIST SP 800-38B, RFC 4493), the MAC the
+ *         CSEc engine computes for VERIFY_MAC. Plain table-free AES: slow,
+ *         but small and independent of the code under test.
+ */
+
+#include "fake_cmac.h"
+#include <string.h>
+
+static const uint8_t sbox[256] = {
+    0x63, 0x7C, 0x77, 0x7B, 0xF2, 0x6B, 0x6F, 0xC5, 0x30, 0x01, 0x67, 0x2B, 0xFE, 0xD7, 0xAB, 0x76,
+    0xCA, 0x82, 0xC9, 0x7D, 0xFA, 0x59, 0x47, 0xF0, 0xAD, 0xD4, 0xA2, 0xAF, 0x9C, 0xA4, 0x72, 0xC0,
+    0xB7, 0xFD, 0x93, 0x26, 0x36, 0x3F, 0xF7, 0xCC, 0x34, 0xA5, 0xE5, 0xF1, 0x71, 0xD8, 0x31, 0x15,
+    0x04, 0xC7, 0x23, 0xC3, 0x18, 0x96, 0x05, 0x9A, 0x07, 0x12, 0x80, 0xE2, 0xEB, 0x27, 0xB2, 0x75,
+    0x09, 0x83, 0x2C, 0x1A, 0x1B, 0x6E, 0x5A, 0xA0, 0x52, 0x3B, 0xD6, 0xB3, 0x29, 0xE3, 0x2F, 0x84,
+    0x53, 0xD1, 0x00, 0xED, 0x20, 0xFC, 0xB1, 0x5B, 0x6A, 0xCB, 0xBE, 0x39, 0x4A, 0x4C, 0x58, 0xCF,
+    0xD0, 0xEF, 0xAA, 0xFB, 0x43, 0x4D, 0x33, 0x85, 0x45, 0xF9, 0x02, 0x7F, 0x50, 0x3C, 0x9F, 0xA8,
+    0x51, 0xA3, 0x40, 0x8F, 0x92, 0x9D, 0x38, 0xF5, 0xBC, 0xB6, 0xDA, 0x21, 0x10, 0xFF, 0xF3, 0xD2,
+    0xCD, 0x0C, 0x13, 0xEC, 0x5F, 0x97, 0x44, 0x17, 0xC4, 0xA7, 0x7E, 0x3D, 0x64, 0x5D, 0x19, 0x73,
+    0x60, 0x81, 0x4F, 0xDC, 0x22, 0x2A, 0x90, 0x88, 0x46, 0xEE, 0xB8, 0x14, 0xDE, 0x5E, 0x0B, 0xDB,
+    0xE0, 0x32, 0x3A, 0x0A, 0x49, 0x06, 0x24, 0x5C, 0xC2, 0xD3, 0xAC, 0x62, 0x91, 0x95, 0xE4, 0x79,
+    0xE7, 0xC8, 0x37, 0x6D, 0x8D, 0xD5, 0x4E, 0xA9, 0x6C, 0x56, 0xF4, 0xEA, 0x65, 0x7A, 0xAE, 0x08,
+    0xBA, 0x78, 0x25, 0x2E, 0x1C, 0xA6, 0xB4, 0xC6, 0xE8, 0xDD, 0x74, 0x1F, 0x4B, 0xBD, 0x8B, 0x8A,
+    0x70, 0x3E, 0xB5, 0x66, 0x48, 0x03, 0xF6, 0x0E, 0x61, 0x35, 0x57, 0xB9, 0x86, 0xC1, 0x1D, 0x9E,
+    0xE1, 0xF8, 0x98, 0x11, 0x69, 0xD9, 0x8E, 0x94, 0x9B, 0x1E, 0x87, 0xE9, 0xCE, 0x55, 0x28, 0xDF,
+    0x8C, 0xA1, 0x89, 0x0D, 0xBF, 0xE6, 0x42, 0x68, 0x41, 0x99, 0x2D, 0x0F, 0xB0, 0x54, 0xBB, 0x16,
+};
+
+static uint8_t xtime(uint8_t x) {
+    return (uint8_t)((x << 1) ^ ((x & 0x80U) ? 0x1BU : 0x00U));
+}
+
+/* FIPS-197 AES-128 encryption of one block, in place */
+static void aesEncrypt(const uint8_t key[16], uint8_t block[16]) {
+    uint8_t rk[16];
+    uint8_t rcon = 0x01;
+
+    memcpy(rk, key, 16);
+    for (uint32_t i = 0; i < 16U; i++) {
+        block[i] ^= rk[i];
+    }
+
+    for (uint32_t round = 1; round <= 10U; round++) {
+        uint8_t t[16];
+
+        /* SubBytes and ShiftRows */
+        for (uint32_t c = 0; c < 4U; c++) {
+            for (uint32_t r = 0; r < 4U; r++) {
+                t[4 * c + r] = sbox[block[4 * ((c + r) & 3U) + r]];
+            }
+        }
+        /* MixColumns, skipped in the last round */
+        if (round != 10U) {
+            for (uint32_t c = 0; c < 4U; c++) {
+                uint8_t *col = &t[4 * c];
+                uint8_t all = (uint8_t)(col[0] ^ col[1] ^ col[2] ^ col[3]);
+                uint8_t first = col[0];
+
+                col[0] ^= all ^ xtime((uint8_t)(col[0] ^ col[1]));
+                col[1] ^= all ^ xtime((uint8_t)(col[1] ^ col[2]));
+                col[2] ^= all ^ xtime((uint8_t)(col[2] ^ col[3]));
+                col[3] ^= all ^ xtime((uint8_t)(col[3] ^ first));
+            }
+        }
+        /* Next round key */
+        rk[0] ^= (uint8_t)(sbox[rk[13]] ^ rcon);
+        rk[1] ^= sbox[rk[14]];
+        rk[2] ^= sbox[rk[15]];
+        rk[3] ^= sbox[rk[12]];
+        for (uint32_t i = 4; i < 16U; i++) {
+            rk[i] ^= rk[i - 4];
+        }
+        rcon = xtime(rcon);
+
+        for (uint32_t i = 0; i < 16U; i++) {
+            block[i] = t[i] ^ rk[i];
+        }
+    }
+}
+
+/* Doubling in GF(2^128), the subkey derivation of SP 800-38B */
+static void doubleBlock(const uint8_t in[16], uint8_t out[16]) {
+    uint8_t carry = (in[0] & 0x80U) ? 0x87U : 0x00U;
+
+    for (uint32_t i = 0; i < 15U; i++) {
+        out[i] = (uint8_t)((in[i] << 1) | (in[i + 1] >> 7));
+    }
+    out[15] = (uint8_t)((in[15] << 1) ^ carry);
+}
+
+/**
+ * @brief AES-128 CMAC of len bytes of msg under key.
+ */
+void FAKECMAC_Aes128(const uint8_t key[16], const uint8_t *msg, uint32_t len, uint8_t mac[16]) {
+    uint8_t k1[16];
+    uint8_t k2[16];
+    uint8_t last[16];
+    uint32_t blocks = (len + 15U) / 16U;
+
+    memset(k1, 0, sizeof(k1));
+    aesEncrypt(key, k1);
+    doubleBlock(k1, k1);
+    doubleBlock(k1, k2);
+
+    if (blocks == 0U) {
+        blocks = 1U;
+    }
+    memset(last, 0, sizeof(last));
+    if (len != 0U && len % 16U == 0U) {
+        memcpy(last, &msg[16U * (blocks - 1U)], 16);
+        for (uint32_t i = 0; i < 16U; i++) {
+            last[i] ^= k1[i];
+        }
+    } else {
+        uint32_t tail = len - 16U * (blocks - 1U);
+
+        memcpy(last, &msg[16U * (blocks - 1U)], tail);
+        last[tail] = 0x80;
+        for (uint32_t i = 0; i < 16U; i++) {
+            last[i] ^= k2[i];
+        }
+    }
+
+    memset(mac, 0, 16);
+    for (uint32_t b = 0; b + 1U < blocks; b++) {
+        for (uint32_t i = 0; i < 16U; i++) {
+            mac[i] ^= msg[16U * b + i];
+        }
+        aesEncrypt(key, mac);
+    }
+    for (uint32_t i = 0; i < 16U; i++) {
+        mac[i] ^= last[i];
+    }
+    aesEncrypt(key, mac);
+}
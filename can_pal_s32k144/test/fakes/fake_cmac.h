@@ -0,0 +1,9 @@
+#ifndef FAKE_CMAC_H_
+#define FAKE_CMAC_H_
+
+#include <stdint.h>
+
+// ===== Function Prototypes =====
+void FAKECMAC_Aes128(const uint8_t key[16], const uint8_t *msg, uint32_t len, uint8_t mac[16]);
+
+#endif /* FAKE_CMAC_H_ */
@@ -0,0 +1,184 @@
+/*
+ * @brief  Host stand-ins for the SDK peripheral drivers behind the UDS
+ *         backends (CSEc, eDMA) and the board hooks (ADC, periodic timer).
+ *         Each does the least its caller needs to run; CSEc checks MACs for
+ *         real (fake_cmac.c) against keys the test provisions. Flash has a
+ *         timed model of its own, fake_flash.c.
+ */
+
+#include "sdk_project_config.h"
+#include "csec_driver.h"
+#include "edma_driver.h"
+#include "fake_drivers.h"
+#include "fake_cmac.h"
+#include <pthread.h>
+#include <string.h>
+
+static pthread_mutex_t rndLock = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t macKeys[16][16];
+static bool macKeySet[16];
+static status_t cmdStatus = STATUS_SUCCESS;   // Reported by the next status poll
+static status_t cmdResult = STATUS_SUCCESS;   // Reported once the command is done
+static uint32_t rndState = 0x12345678UL;
+
+static volatile uint32_t fakePeriodicTicks;
+static uint16_t fakeAdc[32];
+
+// ===== CSEc =====
+void CSEC_DRV_Init(csec_state_t *state) {
+    (void)state;
+}
+
+status_t CSEC_DRV_InitRNG(void) {
+    return STATUS_SUCCESS;
+}
+
+/* xorshift32; thread-safe so servers on several threads may ask for seeds */
+status_t CSEC_DRV_GenerateRND(uint8_t *rnd) {
+    pthread_mutex_lock(&rndLock);
+    for (uint32_t i = 0; i < 16U; i++) {
+        rndState ^= rndState << 13;
+        rndState ^= rndState >> 17;
+        rndState ^= rndState << 5;
+        rnd[i] = (uint8_t)rndState;
+    }
+    pthread_mutex_unlock(&rndLock);
+    return STATUS_SUCCESS;
+}
+
+void FAKEDRV_SetMacKey(csec_key_id_t keyId, const uint8_t key[16]) {
+    memcpy(macKeys[keyId & 15U], key, 16);
+    macKeySet[keyId & 15U] = true;
+}
+
+/* CMAC computed in software; the result is reported after one busy poll,
+ * as the command runs in the background on the target. Meanwhile the FTFC
+ * shows CCIF clear, as CSEc commands run on it. */
+status_t CSEC_DRV_VerifyMACAsync(csec_key_id_t keyId, const uint8_t *msg, uint32_t msgLen,
+                                 const uint8_t *mac, uint16_t macLen, bool *verifStatus) {
+    uint8_t expected[16];
+
+    if (cmdStatus == STATUS_BUSY) {
+        return STATUS_BUSY;
+    }
+    if (!macKeySet[keyId & 15U]) {
+        cmdResult = STATUS_SEC_KEY_EMPTY;
+    } else {
+        FAKECMAC_Aes128(macKeys[keyId & 15U], msg, msgLen / 8U, expected);
+        *verifStatus = (memcmp(expected, mac, macLen / 8U) == 0);
+        cmdResult = STATUS_SUCCESS;
+    }
+    cmdStatus = STATUS_BUSY;
+    FTFC->FSTAT &= (uint8_t)~FTFC_FSTAT_CCIF_MASK;
+    return STATUS_SUCCESS;
+}
+
+status_t CSEC_DRV_GetAsyncCmdStatus(void) {
+    status_t status = cmdStatus;
+
+    cmdStatus = cmdResult;
+    FTFC->FSTAT |= FTFC_FSTAT_CCIF_MASK;
+    return status;
+}
+
+// ===== eDMA: target addresses are not host memory, transfers only complete =====
+static const edma_channel_config_t *edmaChannel;
+static FAKEDRV_DmaMode_t dmaMode = FAKEDRV_DMA_INSTANT;
+static bool dmaRunning;
+static FAKEDRV_DmaStats_t dmaStats;
+
+void FAKEDRV_SetDmaMode(FAKEDRV_DmaMode_t mode) {
+    dmaMode = mode;
+    dmaRunning = false;
+    memset(&dmaStats, 0, sizeof(dmaStats));
+}
+
+static void finishDma(edma_chn_status_t status) {
+    dmaRunning = false;
+    dmaStats.completed++;
+    if (edmaChannel != NULL && edmaChannel->callback != NULL) {
+        edmaChannel->callback(edmaChannel->callbackParam, status);
+    }
+}
+
+/**
+ * @brief Ends the transfer in flight with status, as its interrupt would.
+ * @return false if none was running.
+ */
+bool FAKEDRV_CompleteDma(edma_chn_status_t status) {
+    if (!dmaRunning) {
+        return false;
+    }
+    finishDma(status);
+    return true;
+}
+
+bool FAKEDRV_DmaRunning(void) {
+    return dmaRunning;
+}
+
+void FAKEDRV_GetDmaStats(FAKEDRV_DmaStats_t *stats) {
+    *stats = dmaStats;
+}
+
+status_t EDMA_DRV_Init(edma_state_t *edmaState, const edma_user_config_t *userConfig,
+                       edma_chn_state_t * const chnStateArray[],
+                       const edma_channel_config_t * const chnConfigArray[], uint32_t chnCount) {
+    (void)edmaState;
+    (void)userConfig;
+    (void)chnStateArray;
+    edmaChannel = (chnCount != 0U) ? chnConfigArray[0] : NULL;
+    return STATUS_SUCCESS;
+}
+
+status_t EDMA_DRV_ConfigSingleBlockTransfer(uint8_t virtualChannel, edma_transfer_type_t type,
+                                            uint32_t srcAddr, uint32_t destAddr,
+                                            edma_transfer_size_t transferSize,
+                                            uint32_t dataBufferSize) {
+    (void)virtualChannel;
+    (void)type;
+    (void)srcAddr;
+    (void)destAddr;
+    (void)transferSize;
+    (void)dataBufferSize;
+    return STATUS_SUCCESS;
+}
+
+/* Completes at once, on FAKEDRV_CompleteDma(), or with an error, by mode */
+void EDMA_DRV_TriggerSwRequest(uint8_t virtualChannel) {
+    (void)virtualChannel;
+    dmaStats.started++;
+    if (dmaRunning) {
+        dmaStats.overlapped++;
+    }
+    dmaRunning = true;
+    if (dmaMode == FAKEDRV_DMA_INSTANT) {
+        finishDma(EDMA_CHN_NORMAL);
+    } else if (dmaMode == FAKEDRV_DMA_ERROR) {
+        finishDma(EDMA_CHN_ERROR);
+    }
+}
+
+status_t EDMA_DRV_StopChannel(uint8_t virtualChannel) {
+    (void)virtualChannel;
+    dmaRunning = false;
+    dmaStats.stopped++;
+    return STATUS_SUCCESS;
+}
+
+// ===== Board =====
+void FAKEDRV_SetAdc(uint8_t channel, uint16_t value) {
+    fakeAdc[channel & 31U] = value;
+}
+
+uint16_t myADC_Read(uint8_t channel) {
+    return fakeAdc[channel & 31U];
+}
+
+void FAKEDRV_AdvancePeriodic(uint32_t ticks) {
+    fakePeriodicTicks += ticks;
+}
+
+uint32_t PERIODIC_Ticks(void) {
+    return fakePeriodicTicks;
+}
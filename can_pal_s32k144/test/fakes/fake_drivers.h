@@ -0,0 +1,31 @@
+#ifndef FAKE_DRIVERS_H_
+#define FAKE_DRIVERS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "csec_driver.h"
+#include "edma_driver.h"
+
+typedef enum {
+    FAKEDRV_DMA_INSTANT,      /* Transfers complete as they are triggered */
+    FAKEDRV_DMA_DEFERRED,     /* ... when the test calls FAKEDRV_CompleteDma() */
+    FAKEDRV_DMA_ERROR,        /* ... at once, with EDMA_CHN_ERROR */
+} FAKEDRV_DmaMode_t;
+
+typedef struct {
+    uint32_t started;
+    uint32_t completed;
+    uint32_t stopped;
+    uint32_t overlapped;      /* Triggered while the previous one was running */
+} FAKEDRV_DmaStats_t;
+
+// ===== Function Prototypes =====
+void FAKEDRV_SetMacKey(csec_key_id_t keyId, const uint8_t key[16]);  // Provisions a key slot
+void FAKEDRV_SetAdc(uint8_t channel, uint16_t value);                 // myADC_Read() result
+void FAKEDRV_AdvancePeriodic(uint32_t ticks);                         // PERIODIC_Ticks()
+void FAKEDRV_SetDmaMode(FAKEDRV_DmaMode_t mode);                      // Also clears the statistics
+bool FAKEDRV_CompleteDma(edma_chn_status_t status);
+bool FAKEDRV_DmaRunning(void);
+void FAKEDRV_GetDmaStats(FAKEDRV_DmaStats_t *stats);
+
+#endif /* FAKE_DRIVERS_H_ */
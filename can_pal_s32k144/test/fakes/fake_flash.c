@@ -0,0 +1,142 @@
+/*
+ * @brief  Timed P-Flash model, see fake_flash.h.
+ */
+
+#include "sdk_project_config.h"
+#include "flash_driver.h"
+#include "flashdl.h"
+#include "fake_flash.h"
+#include <string.h>
+
+FTFC_Type fakeFtfcRegs;
+
+static uint8_t flashMem[FLASHDL_END - FLASHDL_START];
+static flash_callback_t waitHook;
+static void (*clockAdvance)(uint32_t us);
+static FAKEFLASH_Stats_t stats;
+static uint32_t eraseAddr;
+static uint32_t eraseLeftUs;
+
+void FAKEFLASH_Reset(void) {
+    memset(flashMem, 0x00, sizeof(flashMem));
+    memset(&stats, 0, sizeof(stats));
+    memset(&fakeFtfcRegs, 0, sizeof(fakeFtfcRegs));
+    fakeFtfcRegs.FSTAT = FTFC_FSTAT_CCIF_MASK;
+    eraseLeftUs = 0;
+}
+
+void FAKEFLASH_SetClock(void (*advanceUs)(uint32_t us)) {
+    clockAdvance = advanceUs;
+}
+
+const uint8_t *FAKEFLASH_Ptr(uint32_t address) {
+    return &flashMem[address - FLASHDL_START];
+}
+
+void FAKEFLASH_GetStats(FAKEFLASH_Stats_t *out) {
+    *out = stats;
+}
+
+/* One step of a running command: time passes while the CPU polls CCIF */
+static void busyStep(uint32_t us) {
+    if (clockAdvance != NULL) {
+        clockAdvance(us);
+    }
+    for (uint32_t i = 0; i < FAKEFLASH_POLLS_PER_STEP && waitHook != NULL; i++) {
+        waitHook();
+    }
+}
+
+static void noteWait(uint32_t us) {
+    if (us > stats.longestWaitUs) {
+        stats.longestWaitUs = us;
+    }
+}
+
+/* Runs the pending erase until it completes or an ERSSUSP request is taken */
+static status_t runErase(void) {
+    uint32_t waited = 0;
+
+    fakeFtfcRegs.FCNFG &= (uint8_t)~FTFC_FCNFG_ERSSUSP_MASK;
+    fakeFtfcRegs.FSTAT = 0;
+    while (eraseLeftUs > 0U) {
+        uint32_t step = (eraseLeftUs < FAKEFLASH_STEP_US) ? eraseLeftUs : FAKEFLASH_STEP_US;
+
+        busyStep(step);
+        eraseLeftUs -= step;
+        waited += step;
+        stats.eraseUs += step;
+        if (eraseLeftUs > 0U && (fakeFtfcRegs.FCNFG & FTFC_FCNFG_ERSSUSP_MASK) != 0U) {
+            stats.suspends++;
+            noteWait(waited);
+            fakeFtfcRegs.FSTAT = FTFC_FSTAT_CCIF_MASK;
+            return STATUS_SUCCESS;
+        }
+    }
+    memset(&flashMem[eraseAddr - FLASHDL_START], 0xFF, FEATURE_FLS_PF_BLOCK_SECTOR_SIZE);
+    fakeFtfcRegs.FCNFG &= (uint8_t)~FTFC_FCNFG_ERSSUSP_MASK;
+    fakeFtfcRegs.FSTAT = FTFC_FSTAT_CCIF_MASK;
+    noteWait(waited);
+    return STATUS_SUCCESS;
+}
+
+status_t FLASH_DRV_Init(const flash_user_config_t * const pUserConf,
+                        flash_ssd_config_t * const pSSDConfig) {
+    waitHook = pUserConf->CallBack;
+    pSSDConfig->CallBack = pUserConf->CallBack;
+    return STATUS_SUCCESS;
+}
+
+status_t FLASH_DRV_EraseSector(const flash_ssd_config_t *pSSDConfig, uint32_t dest, uint32_t size) {
+    (void)pSSDConfig;
+    if ((fakeFtfcRegs.FSTAT & FTFC_FSTAT_CCIF_MASK) == 0U) {
+        return STATUS_SUCCESS;          /* Launch ignored: another command runs */
+    }
+    if (dest < FLASHDL_START || dest >= FLASHDL_END || size != FEATURE_FLS_PF_BLOCK_SECTOR_SIZE ||
+        (dest % FEATURE_FLS_PF_BLOCK_SECTOR_SIZE) != 0U) {
+        fakeFtfcRegs.FSTAT = FTFC_FSTAT_CCIF_MASK | FTFC_FSTAT_ACCERR_MASK;
+        return STATUS_ERROR;
+    }
+    eraseAddr = dest;
+    eraseLeftUs = FAKEFLASH_ERASE_US;
+    return runErase();
+}
+
+void FAKEFLASH_ResumeErase(void) {
+    if ((fakeFtfcRegs.FCNFG & FTFC_FCNFG_ERSSUSP_MASK) != 0U && eraseLeftUs > 0U) {
+        (void)runErase();
+    }
+}
+
+/* Programs whole phrases; a phrase that is not erased fails with MGSTAT0 */
+status_t FLASH_DRV_Program(const flash_ssd_config_t *pSSDConfig, uint32_t dest, uint32_t size,
+                           const uint8_t *pData) {
+    (void)pSSDConfig;
+    if ((fakeFtfcRegs.FSTAT & FTFC_FSTAT_CCIF_MASK) == 0U) {
+        return STATUS_SUCCESS;          /* Launch ignored: another command runs */
+    }
+    if (dest < FLASHDL_START || size > FLASHDL_END - dest ||
+        (dest % FEATURE_FLS_PF_BLOCK_WRITE_UNIT_SIZE) != 0U ||
+        (size % FEATURE_FLS_PF_BLOCK_WRITE_UNIT_SIZE) != 0U) {
+        fakeFtfcRegs.FSTAT = FTFC_FSTAT_CCIF_MASK | FTFC_FSTAT_ACCERR_MASK;
+        return STATUS_ERROR;
+    }
+    for (uint32_t done = 0; done < size; done += FEATURE_FLS_PF_BLOCK_WRITE_UNIT_SIZE) {
+        uint8_t *phrase = &flashMem[dest + done - FLASHDL_START];
+
+        for (uint32_t i = 0; i < FEATURE_FLS_PF_BLOCK_WRITE_UNIT_SIZE; i++) {
+            if (phrase[i] != 0xFFU) {
+                fakeFtfcRegs.FSTAT = FTFC_FSTAT_CCIF_MASK | FTFC_FSTAT_MGSTAT0_MASK;
+                return STATUS_ERROR;
+            }
+        }
+        for (uint32_t t = 0; t < FAKEFLASH_PHRASE_US; t += FAKEFLASH_STEP_US) {
+            busyStep(FAKEFLASH_STEP_US);
+        }
+        memcpy(phrase, &pData[done], FEATURE_FLS_PF_BLOCK_WRITE_UNIT_SIZE);
+        stats.programUs += FAKEFLASH_PHRASE_US;
+        noteWait(FAKEFLASH_PHRASE_US);
+    }
+    fakeFtfcRegs.FSTAT = FTFC_FSTAT_CCIF_MASK;
+    return STATUS_SUCCESS;
+}
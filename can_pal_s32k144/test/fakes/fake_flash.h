@@ -0,0 +1,33 @@
+/*
+ * Host model of the P-Flash download area and the FTFC commands flashdl.c
+ * uses. Commands take modelled time, reported through a clock callback so a
+ * simulation can run the bus meanwhile; the RAM wait hook of the flash
+ * configuration is called as often as the target's wait loop would, and a
+ * sector erase honours FCNFG[ERSSUSP].
+ */
+
+#ifndef FAKE_FLASH_H_
+#define FAKE_FLASH_H_
+
+#include <stdint.h>
+
+#define FAKEFLASH_ERASE_US   12000U  // Erase Flash Sector, typical
+#define FAKEFLASH_PHRASE_US  90U     // Program Phrase (8 bytes), typical
+#define FAKEFLASH_STEP_US    10U     // Clock granularity while a command runs
+#define FAKEFLASH_POLLS_PER_STEP  40U // Wait hook calls per step (4 polls per us)
+
+typedef struct {
+    uint32_t eraseUs;        // Time spent erasing, suspensions excluded
+    uint32_t programUs;
+    uint32_t suspends;
+    uint32_t longestWaitUs;  // Longest stretch the CPU waited on one command
+} FAKEFLASH_Stats_t;
+
+// ===== Function Prototypes =====
+void FAKEFLASH_Reset(void);                             // Area unerased (0x00), statistics cleared
+void FAKEFLASH_SetClock(void (*advanceUs)(uint32_t us)); // Called as modelled time passes
+const uint8_t *FAKEFLASH_Ptr(uint32_t address);
+void FAKEFLASH_GetStats(FAKEFLASH_Stats_t *stats);
+void FAKEFLASH_ResumeErase(void);
+
+#endif /* FAKE_FLASH_H_ */
@@ -0,0 +1,81 @@
+/*
+ * @brief  RAM model of the NVM and DTC slot storage behind dtc.h.
+ *
+ * Accesses are serialised, so servers on several threads may share it the
+ * way they share the one FlexNVM on the target.
+ */
+
+#include "fake_nvm.h"
+#include <pthread.h>
+#include <string.h>
+
+static uint8_t nvm[NVM_SIZE];
+static pthread_mutex_t nvmLock = PTHREAD_MUTEX_INITIALIZER;
+
+void FAKENVM_Reset(void) {
+    pthread_mutex_lock(&nvmLock);
+    memset(nvm, 0xFF, sizeof(nvm));
+    pthread_mutex_unlock(&nvmLock);
+}
+
+uint8_t *FAKENVM_Bytes(void) {
+    return nvm;
+}
+
+int NVM_Erase(uint32_t offset, uint32_t len) {
+    if (offset > NVM_SIZE || len > NVM_SIZE - offset) {
+        return NVM_ERROR;
+    }
+    pthread_mutex_lock(&nvmLock);
+    memset(&nvm[offset], 0xFF, len);
+    pthread_mutex_unlock(&nvmLock);
+    return NVM_OK;
+}
+
+int NVM_Read(uint32_t offset, uint8_t *data, uint32_t len) {
+    if (offset > NVM_SIZE || len > NVM_SIZE - offset) {
+        return NVM_ERROR;
+    }
+    pthread_mutex_lock(&nvmLock);
+    memcpy(data, &nvm[offset], len);
+    pthread_mutex_unlock(&nvmLock);
+    return NVM_OK;
+}
+
+/* Programming can only clear bits, as on flash */
+int NVM_Write(uint32_t offset, const uint8_t *data, uint32_t len) {
+    if (offset > NVM_SIZE || len > NVM_SIZE - offset) {
+        return NVM_ERROR;
+    }
+    pthread_mutex_lock(&nvmLock);
+    for (uint32_t i = 0; i < len; i++) {
+        nvm[offset + i] &= data[i];
+    }
+    pthread_mutex_unlock(&nvmLock);
+    return NVM_OK;
+}
+
+uint8_t DTC_GetCount(void) {
+    return DTC_SLOT_COUNT;
+}
+
+/* Slot holding dtc, else the first erased slot, else -1 */
+int8_t DTC_Find(uint32_t dtc) {
+    int8_t freeSlot = -1;
+
+    pthread_mutex_lock(&nvmLock);
+    for (uint8_t i = 0; i < DTC_SLOT_COUNT; i++) {
+        const uint8_t *slot = &nvm[DTC_REGION_OFFSET + i * DTC_SLOT_SIZE];
+        uint32_t stored = ((uint32_t)slot[0] << 16) | ((uint32_t)slot[1] << 8) | slot[2];
+
+        if (stored == dtc) {
+            pthread_mutex_unlock(&nvmLock);
+            return (int8_t)i;
+        }
+        if (freeSlot < 0 && stored == 0xFFFFFFUL) {
+            freeSlot = (int8_t)i;
+        }
+    }
+    pthread_mutex_unlock(&nvmLock);
+    return freeSlot;
+}
@@ -0,0 +1,11 @@
+#ifndef FAKE_NVM_H_
+#define FAKE_NVM_H_
+
+#include <stdint.h>
+#include "dtc.h"
+
+// ===== Function Prototypes =====
+void FAKENVM_Reset(void);           // Whole NVM erased (0xFF)
+uint8_t *FAKENVM_Bytes(void);       // NVM_SIZE bytes, for setting up and inspecting records
+
+#endif /* FAKE_NVM_H_ */
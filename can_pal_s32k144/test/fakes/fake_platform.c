@@ -0,0 +1,61 @@
+/*
+ * @brief  Host stand-ins for the SDK platform services: interrupt manager,
+ *         clock manager and the OSIF millisecond clock.
+ */
+
+#include "sdk_project_config.h"
+#include "interrupt_manager.h"
+#include "osif.h"
+#include "fake_platform.h"
+
+uint32_t fakeIrqMaskDepth;
+uint32_t fakeIrqGlobalDepth;
+S32_NVIC_Type fakeNvicRegs;
+
+static void (*irqEnableHook)(void);
+
+static volatile uint32_t fakeMs;
+
+void FAKEPLAT_SetMs(uint32_t ms) {
+    fakeMs = ms;
+}
+
+void FAKEPLAT_AdvanceMs(uint32_t ms) {
+    fakeMs += ms;
+}
+
+uint32_t OSIF_GetMilliseconds(void) {
+    return fakeMs;
+}
+
+status_t CLOCK_SYS_GetFreq(clock_names_t clockName, uint32_t *frequency) {
+    (void)clockName;
+    *frequency = FAKE_SOSC_HZ;
+    return STATUS_SUCCESS;
+}
+
+void INT_SYS_EnableIRQ(IRQn_Type irqNumber) {
+    (void)irqNumber;
+    fakeIrqMaskDepth--;
+}
+
+void INT_SYS_DisableIRQ(IRQn_Type irqNumber) {
+    (void)irqNumber;
+    fakeIrqMaskDepth++;
+}
+
+/* Unlike the SDK, nests: the hook runs when the outermost disable ends */
+void INT_SYS_EnableIRQGlobal(void) {
+    fakeIrqGlobalDepth--;
+    if (fakeIrqGlobalDepth == 0U && irqEnableHook != NULL) {
+        irqEnableHook();
+    }
+}
+
+void INT_SYS_DisableIRQGlobal(void) {
+    fakeIrqGlobalDepth++;
+}
+
+void FAKEPLAT_SetIrqEnableHook(void (*hook)(void)) {
+    irqEnableHook = hook;
+}
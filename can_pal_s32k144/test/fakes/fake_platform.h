@@ -0,0 +1,11 @@
+#ifndef FAKE_PLATFORM_H_
+#define FAKE_PLATFORM_H_
+
+#include <stdint.h>
+
+// ===== Function Prototypes =====
+void FAKEPLAT_SetMs(uint32_t ms);       // OSIF_GetMilliseconds() value
+void FAKEPLAT_AdvanceMs(uint32_t ms);
+void FAKEPLAT_SetIrqEnableHook(void (*hook)(void)); // Serves interrupts that became pending while masked
+
+#endif /* FAKE_PLATFORM_H_ */
@@ -0,0 +1,20 @@
+/*
+ * Host build stand-in for the SDK interrupt manager. Interrupt "masking" is
+ * only counted: the tests call the ISRs themselves, from the thread that
+ * plays the hardware.
+ */
+
+#ifndef INTERRUPT_MANAGER_H
+#define INTERRUPT_MANAGER_H
+
+#include "sdk_project_config.h"
+
+void INT_SYS_EnableIRQ(IRQn_Type irqNumber);
+void INT_SYS_DisableIRQ(IRQn_Type irqNumber);
+void INT_SYS_EnableIRQGlobal(void);
+void INT_SYS_DisableIRQGlobal(void);
+
+extern uint32_t fakeIrqMaskDepth;   // INT_SYS_DisableIRQ minus EnableIRQ calls
+extern uint32_t fakeIrqGlobalDepth; // Same for the global mask
+
+#endif /* INTERRUPT_MANAGER_H */
@@ -0,0 +1,68 @@
+/*
+ * Host build stand-in for board/sdk_project_config.h.
+ *
+ * Pulls the real S32K144 register layouts and feature macros, then points the
+ * peripheral base macros at RAM copies owned by the register models
+ * (fake_can_regs.c, fake_flash.c, fake_platform.c), so FlexCan.c and
+ * flashdl.c run unmodified against simulated hardware.
+ */
+
+#ifndef SDK_PROJECT_CONFIG_H_
+#define SDK_PROJECT_CONFIG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "status.h"
+#include "device_registers.h"
+
+// ===== Core intrinsics without inline ARM assembly =====
+#undef  REV_BYTES_32
+#define REV_BYTES_32(a, b)  ((b) = __builtin_bswap32(a))
+
+// ===== Peripherals backed by RAM =====
+extern CAN_Type fakeCanRegs[CAN_INSTANCE_COUNT];
+extern PCC_Type fakePccRegs;
+
+#undef  CAN0
+#undef  CAN1
+#undef  CAN2
+#undef  PCC
+#define CAN0  (&fakeCanRegs[0])
+#define CAN1  (&fakeCanRegs[1])
+#define CAN2  (&fakeCanRegs[2])
+#define PCC   (&fakePccRegs)
+
+extern FTFC_Type fakeFtfcRegs;
+extern S32_NVIC_Type fakeNvicRegs;
+
+#undef  FTFC
+#undef  S32_NVIC
+#define FTFC      (&fakeFtfcRegs)
+#define S32_NVIC  (&fakeNvicRegs)
+
+// Write-1-to-clear with Rx FIFO pop, see fake_can_regs.c
+void FAKECAN_ClearIflag(volatile CAN_Type *base, uint32_t mask);
+#define FLEXCAN_IFLAG1_CLEAR(base, mask)  FAKECAN_ClearIflag((base), (mask))
+
+// Freeze handshake: FRZACK follows FRZ and HALT, see fake_can_regs.c
+void FAKECAN_WriteMcr(volatile CAN_Type *base, uint32_t value);
+#define FLEXCAN_MCR_WRITE(base, value)    FAKECAN_WriteMcr((base), (value))
+
+// Stand-in for the DWT cycle counter used by CAN_CYCLE_STATS
+uint32_t FAKECAN_CycleCount(void);
+#define FLEXCAN_CYCLE_INIT()   do { } while (0)
+#define FLEXCAN_CYCLE_COUNT()  FAKECAN_CycleCount()
+
+// Flash commands run on a timed model, see fake_flash.c
+const uint8_t *FAKEFLASH_Ptr(uint32_t address);
+void FAKEFLASH_ResumeErase(void);
+#define FLASHDL_FLASH_PTR(address)  FAKEFLASH_Ptr(address)
+#define FLASHDL_RESUME_ERASE()      FAKEFLASH_ResumeErase()
+
+// ===== Clock manager (clock_names_t comes from the features header) =====
+#define FAKE_SOSC_HZ  8000000UL
+
+status_t CLOCK_SYS_GetFreq(clock_names_t clockName, uint32_t *frequency);
+
+#endif /* SDK_PROJECT_CONFIG_H_ */
@@ -0,0 +1,40 @@
+/*
+ * Minimal host test helpers: each test binary includes this once, runs its
+ * cases with TEST_RUN() and returns TEST_Done() as its exit status.
+ */
+
+#ifndef TEST_H_
+#define TEST_H_
+
+#include <stdio.h>
+
+static int testFailures;
+
+#define CHECK(cond) do {                                                        \
+    if (!(cond)) {                                                              \
+        printf("    %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);     \
+        testFailures++;                                                         \
+    }                                                                           \
+} while (0)
+
+#define CHECK_EQ(actual, expected) do {                                         \
+    unsigned long a_ = (unsigned long)(actual);                                 \
+    unsigned long e_ = (unsigned long)(expected);                               \
+    if (a_ != e_) {                                                             \
+        printf("    %s:%d: %s == %lu, expected %lu\n",                          \
+               __FILE__, __LINE__, #actual, a_, e_);                            \
+        testFailures++;                                                         \
+    }                                                                           \
+} while (0)
+
+#define TEST_RUN(fn) do {                                                       \
+    printf("  %s\n", #fn);                                                      \
+    fn();                                                                       \
+} while (0)
+
+static inline int TEST_Done(const char *suite) {
+    printf("%s: %s\n", suite, testFailures == 0 ? "PASS" : "FAIL");
+    return testFailures == 0 ? 0 : 1;
+}
+
+#endif /* TEST_H_ */
@@ -0,0 +1,412 @@
+/*
+ * @brief  Timed host simulation of a 0x34/0x36/0x37 download (flashdl.c).
+ *
+ * Time is simulated, in microseconds. A tester streams the image over
+ * ISO-TP at full bus speed, honouring the server's flow control; its frames
+ * land in the 6-deep FlexCAN Rx FIFO and the receive interrupt moves them to
+ * the driver's ring, which the main loop drains into UDS_OnFrame() before
+ * UDS_Tick() and FLASHDL_Poll(). A 1 ms timer interrupt runs alongside.
+ * Flash commands take their modelled time (fake_flash.c) with interrupts
+ * masked; interrupts raised meanwhile stay pending until the mask is lifted.
+ *
+ * Checked: the image lands in flash; programming runs while the next block
+ * is on the bus, so most of its time hides behind the transfer (erases run
+ * while the tester waits for a response and do add to it); and no interrupt
+ * waits long enough for the FIFO to overflow or a timer tick to be lost.
+ * No flash command is launched while a CSEc command holds the FTFC.
+ */
+
+#include "test.h"
+#include "fake_can_api.h"
+#include "fake_flash.h"
+#include "fake_platform.h"
+#include "fake_nvm.h"
+#include "interrupt_manager.h"
+#include "flashdl.h"
+#include "seca.h"
+#include "uds.h"
+#include <string.h>
+
+#define SIM_IMAGE_SIZE     (8U * FEATURE_FLS_PF_BLOCK_SECTOR_SIZE)
+#define SIM_HW_FIFO_DEPTH  6U          // FlexCAN legacy Rx FIFO
+#define SIM_MAIN_LOOP_US   20U         // Main-loop pass without flash work
+#define SIM_TIMER_US       1000U       // LPIT tick of the periodic scheduler
+#define SIM_LIMIT_US       10000000U   // Gives up after 10 s
+#define SIM_MAX_LATENCY_US 250U        // Less than one frame: the FIFO never fills
+
+// Frame on the wire at 500 kbit/s: 47 bits of overhead, about 10 % stuffing
+#define SIM_FRAME_US(dlc)  ((47U + 8U * (dlc)) * 11U / 10U * 2U)
+
+#define NVIC_BIT(irq)      (1UL << ((uint32_t)(irq) % 32U))
+#define NVIC_REG(irq)      ((uint32_t)(irq) / 32U)
+
+typedef enum {
+    TESTER_SEND_FIRST,
+    TESTER_WAIT_FC,
+    TESTER_SEND_CF,
+    TESTER_WAIT_RSP,
+    TESTER_DONE,
+    TESTER_FAILED,
+} TesterState_t;
+
+static CAN_Instance_t can;
+static uint8_t rxBuf[ISOTP_MAX_LEN];
+static UDS_Server_t srv;
+static uint8_t image[SIM_IMAGE_SIZE];
+
+static uint32_t simUs;
+
+static struct {
+    CAN_Message_t hwFifo[SIM_HW_FIFO_DEPTH];
+    uint32_t      hwCount;
+    CAN_Message_t ring[RX_RING_SIZE];
+    uint32_t      ringHead;
+    uint32_t      ringCount;
+    uint32_t      canSince;       // When the receive interrupt became pending
+    uint32_t      timerSince;
+    uint32_t      nextTimerUs;
+    uint32_t      timerLost;      // Ticks raised while the previous one was pending
+    uint32_t      overflows;      // Frames lost to a full FIFO or ring
+    uint32_t      maxLatencyUs;
+} ecu;
+
+static struct {
+    uint32_t      busyUntil;      // End of the frame on the wire
+    bool          busy;
+    CAN_Message_t frame;
+    bool          fromTester;
+    uint32_t      busyUs;         // Wire time of every frame
+} bus;
+
+static struct {
+    TesterState_t state;
+    uint8_t       req[2 + FLASHDL_BLOCK_SIZE];
+    uint16_t      len;
+    uint16_t      offset;
+    uint8_t       sn;
+    uint8_t       bs;
+    uint8_t       blockLeft;
+    uint32_t      stminUs;
+    uint32_t      readyAt;
+    uint8_t       rsp[7];
+} tester;
+
+// ===== Interrupts =====
+
+static void pend(IRQn_Type irq, uint32_t *since) {
+    if ((S32_NVIC->ISPR[NVIC_REG(irq)] & NVIC_BIT(irq)) == 0U) {
+        S32_NVIC->ISPR[NVIC_REG(irq)] |= NVIC_BIT(irq);
+        *since = simUs;
+    } else if (since == &ecu.timerSince) {
+        ecu.timerLost++;
+    }
+}
+
+static bool isPending(IRQn_Type irq) {
+    return (S32_NVIC->ISPR[NVIC_REG(irq)] & NVIC_BIT(irq)) != 0U;
+}
+
+static void noteLatency(uint32_t since) {
+    if (simUs - since > ecu.maxLatencyUs) {
+        ecu.maxLatencyUs = simUs - since;
+    }
+}
+
+/* Runs the pending handlers, as the core does once PRIMASK is cleared */
+static void serveIrqs(void) {
+    if (fakeIrqGlobalDepth != 0U) {
+        return;
+    }
+    if (isPending(CAN0_ORed_0_15_MB_IRQn)) {
+        S32_NVIC->ISPR[NVIC_REG(CAN0_ORed_0_15_MB_IRQn)] &= ~NVIC_BIT(CAN0_ORed_0_15_MB_IRQn);
+        noteLatency(ecu.canSince);
+        for (uint32_t i = 0; i < ecu.hwCount; i++) {
+            if (ecu.ringCount == RX_RING_SIZE) {
+                ecu.overflows++;
+                continue;
+            }
+            ecu.ring[(ecu.ringHead + ecu.ringCount) % RX_RING_SIZE] = ecu.hwFifo[i];
+            ecu.ringCount++;
+        }
+        ecu.hwCount = 0;
+        can.rxPending = ecu.ringCount;
+    }
+    if (isPending(LPIT0_Ch0_IRQn)) {
+        S32_NVIC->ISPR[NVIC_REG(LPIT0_Ch0_IRQn)] &= ~NVIC_BIT(LPIT0_Ch0_IRQn);
+        noteLatency(ecu.timerSince);
+    }
+}
+
+// ===== Tester =====
+
+static void testerStart(const uint8_t *req, uint16_t len) {
+    memcpy(tester.req, req, len);
+    tester.len = len;
+    tester.offset = 0;
+    tester.sn = 1;
+    tester.readyAt = simUs;
+    tester.state = TESTER_SEND_FIRST;
+}
+
+/* Next frame the tester puts on the wire, if one is due */
+static bool testerFrame(CAN_Message_t *msg) {
+    uint16_t n;
+
+    if ((tester.state != TESTER_SEND_FIRST && tester.state != TESTER_SEND_CF) ||
+        simUs < tester.readyAt) {
+        return false;
+    }
+    memset(msg, 0, sizeof(*msg));
+    msg->canID = srv.link.rxId;
+
+    if (tester.state == TESTER_SEND_FIRST && tester.len <= 7U) {
+        msg->data[0] = (uint8_t)tester.len;
+        memcpy(&msg->data[1], tester.req, tester.len);
+        msg->dlc = (uint8_t)(tester.len + 1U);
+        tester.state = TESTER_WAIT_RSP;
+        return true;
+    }
+    if (tester.state == TESTER_SEND_FIRST) {
+        msg->data[0] = (uint8_t)(0x10U | (tester.len >> 8));
+        msg->data[1] = (uint8_t)tester.len;
+        memcpy(&msg->data[2], tester.req, 6);
+        msg->dlc = 8;
+        tester.offset = 6;
+        tester.state = TESTER_WAIT_FC;
+        return true;
+    }
+
+    n = (uint16_t)(tester.len - tester.offset);
+    if (n > 7U) n = 7U;
+    msg->data[0] = (uint8_t)(0x20U | tester.sn);
+    memcpy(&msg->data[1], &tester.req[tester.offset], n);
+    msg->dlc = (uint8_t)(n + 1U);
+    tester.offset = (uint16_t)(tester.offset + n);
+    tester.sn = (uint8_t)((tester.sn + 1U) & 0x0FU);
+    if (tester.offset >= tester.len) {
+        tester.state = TESTER_WAIT_RSP;
+    } else if (tester.bs != 0U && --tester.blockLeft == 0U) {
+        tester.state = TESTER_WAIT_FC;
+    } else {
+        tester.readyAt = simUs + SIM_FRAME_US(msg->dlc) + tester.stminUs;
+    }
+    return true;
+}
+
+/* A frame from the server has been received by the tester */
+static void testerReceive(const CAN_Message_t *msg) {
+    uint8_t pci = msg->data[0];
+
+    if (tester.state == TESTER_WAIT_FC && (pci & 0xF0U) == 0x30U) {
+        if (pci == 0x30U) {
+            tester.bs = msg->data[1];
+            tester.blockLeft = msg->data[1];
+            tester.stminUs = (msg->data[2] <= 0x7FU) ? msg->data[2] * 1000U : 100U;
+            tester.readyAt = simUs;     /* The first CF of a block waits no STmin */
+            tester.state = TESTER_SEND_CF;
+        } else if (pci != 0x31U) {
+            tester.state = TESTER_FAILED;
+        }
+        return;
+    }
+    if (tester.state != TESTER_WAIT_RSP || (pci & 0xF0U) != 0x00U || pci == 0U || pci > 7U) {
+        return;
+    }
+    if (pci == 3U && msg->data[1] == 0x7FU && msg->data[3] == NRC_RESPONSE_PENDING) {
+        return;
+    }
+    memcpy(tester.rsp, &msg->data[1], pci);
+    tester.state = TESTER_DONE;
+}
+
+// ===== Bus and time =====
+
+/* Ends the frame on the wire and starts the next one; the tester wins arbitration */
+static void busStep(void) {
+    if (bus.busy && simUs >= bus.busyUntil) {
+        bus.busy = false;
+        if (!bus.fromTester) {
+            testerReceive(&bus.frame);
+        } else if (ecu.hwCount == SIM_HW_FIFO_DEPTH) {
+            ecu.overflows++;
+        } else {
+            ecu.hwFifo[ecu.hwCount++] = bus.frame;
+            pend(CAN0_ORed_0_15_MB_IRQn, &ecu.canSince);
+        }
+    }
+    if (bus.busy) {
+        return;
+    }
+    if (testerFrame(&bus.frame)) {
+        bus.fromTester = true;
+    } else if (fakeIrqGlobalDepth == 0U && FAKECANAPI_TakeTx(&can, &bus.frame) == 0) {
+        /* TakeTx runs the TX-complete handler, so only while interrupts are open */
+        bus.fromTester = false;
+    } else {
+        return;
+    }
+    bus.busy = true;
+    bus.busyUntil = simUs + SIM_FRAME_US(bus.frame.dlc);
+    bus.busyUs += SIM_FRAME_US(bus.frame.dlc);
+}
+
+/* Moves simulated time on by us, one microsecond at a time */
+static void simAdvance(uint32_t us) {
+    for (uint32_t i = 0; i < us; i++) {
+        simUs++;
+        can.now = (uint32_t)(((uint64_t)simUs * can.bitrate) / 1000000U);
+        if (simUs >= ecu.nextTimerUs) {
+            ecu.nextTimerUs += SIM_TIMER_US;
+            pend(LPIT0_Ch0_IRQn, &ecu.timerSince);
+        }
+        busStep();
+        serveIrqs();
+    }
+}
+
+/* One pass of the main loop in main.c */
+static void mainLoopPass(void) {
+    for (uint32_t i = 0; i < RX_BATCH_MAX && ecu.ringCount != 0U; i++) {
+        CAN_Message_t msg = ecu.ring[ecu.ringHead];
+
+        ecu.ringHead = (ecu.ringHead + 1U) % RX_RING_SIZE;
+        ecu.ringCount--;
+        can.rxPending = ecu.ringCount;
+        UDS_OnFrame(&srv, &msg);
+    }
+    UDS_Tick(&srv);
+    FLASHDL_Poll();
+    simAdvance(SIM_MAIN_LOOP_US);
+}
+
+/**
+ * @brief Runs one request until its final (single frame) response is in tester.rsp.
+ * @return false on a flow control overflow or timeout.
+ */
+static bool exchange(const uint8_t *req, uint16_t len) {
+    testerStart(req, len);
+    while (tester.state != TESTER_DONE && tester.state != TESTER_FAILED && simUs < SIM_LIMIT_US) {
+        mainLoopPass();
+    }
+    return tester.state == TESTER_DONE;
+}
+
+static void setup(void) {
+    memset(&ecu, 0, sizeof(ecu));
+    memset(&bus, 0, sizeof(bus));
+    memset(&tester, 0, sizeof(tester));
+    memset(&fakeNvicRegs, 0, sizeof(fakeNvicRegs));
+    simUs = 0;
+    ecu.nextTimerUs = SIM_TIMER_US;
+
+    FAKENVM_Reset();
+    FAKEFLASH_Reset();
+    FAKEFLASH_SetClock(simAdvance);
+    FAKEPLAT_SetIrqEnableHook(serveIrqs);
+    S32_NVIC->ISER[NVIC_REG(CAN0_ORed_0_15_MB_IRQn)] |= NVIC_BIT(CAN0_ORed_0_15_MB_IRQn);
+    S32_NVIC->ISER[NVIC_REG(LPIT0_Ch0_IRQn)] |= NVIC_BIT(LPIT0_Ch0_IRQn);
+    FLASHDL_Init();
+
+    FAKECANAPI_Init(&can);
+    srv = (UDS_Server_t)UDS_SERVER_INIT(&can, RX_MSG_ID, TX_MSG_ID_UDS, rxBuf);
+    srv.session = UDS_SESSION_PROGRAMMING;
+    srv.securityLevel = SECURITY_LEVEL_ENGINE;
+
+    for (uint32_t i = 0; i < SIM_IMAGE_SIZE; i++) {
+        image[i] = (uint8_t)(i * 7U + (i >> 8));
+    }
+}
+
+static void test_download_overlaps_bus_and_flash(void) {
+    uint8_t req[2 + FLASHDL_BLOCK_SIZE] = { 0x34, 0x00, 0x44 };
+    FAKEFLASH_Stats_t flash;
+    uint32_t start;
+    uint32_t elapsedUs;
+    uint32_t serialUs;
+    uint16_t block;
+    uint8_t seq = 1;
+
+    setup();
+    for (uint32_t i = 0; i < 4; i++) {
+        req[3 + i] = (uint8_t)(FLASHDL_START >> (24 - 8 * i));
+        req[7 + i] = (uint8_t)(SIM_IMAGE_SIZE >> (24 - 8 * i));
+    }
+    start = simUs;
+    CHECK(exchange(req, 11));
+    CHECK_EQ(tester.rsp[0], 0x74);
+    block = (uint16_t)(((tester.rsp[2] << 8) | tester.rsp[3]) - 2U);
+    CHECK_EQ(block, FLASHDL_BLOCK_SIZE);
+
+    for (uint32_t offset = 0; offset < SIM_IMAGE_SIZE && tester.rsp[0] != 0x7F; offset += block) {
+        req[0] = 0x36;
+        req[1] = seq;
+        memcpy(&req[2], &image[offset], block);
+        CHECK(exchange(req, (uint16_t)(2U + block)));
+        CHECK_EQ(tester.rsp[0], 0x76);
+        CHECK_EQ(tester.rsp[1], seq);
+        seq++;
+    }
+    req[0] = 0x37;
+    CHECK(exchange(req, 1));
+    CHECK_EQ(tester.rsp[0], 0x77);
+
+    FAKEFLASH_GetStats(&flash);
+    elapsedUs = simUs - start;
+    serialUs = bus.busyUs + flash.eraseUs + flash.programUs;
+    printf("    %u bytes in %.1f ms (%.1f kB/s); bus %.1f ms, erase %.1f ms, program %.1f ms, "
+           "one after the other %.1f ms\n",
+           SIM_IMAGE_SIZE, elapsedUs / 1000.0, SIM_IMAGE_SIZE * 1000.0 / elapsedUs,
+           bus.busyUs / 1000.0, flash.eraseUs / 1000.0, flash.programUs / 1000.0, serialUs / 1000.0);
+    printf("    %u erase suspends, longest masked wait %u us, worst interrupt latency %u us\n",
+           flash.suspends, flash.longestWaitUs, ecu.maxLatencyUs);
+
+    CHECK(memcmp(FAKEFLASH_Ptr(FLASHDL_START), image, SIM_IMAGE_SIZE) == 0);
+    /* At least half of the programming time overlaps the transfer */
+    CHECK(elapsedUs < bus.busyUs + flash.eraseUs + flash.programUs / 2U);
+    CHECK(flash.suspends > 0U);
+    CHECK(ecu.maxLatencyUs <= SIM_MAX_LATENCY_US);
+    CHECK_EQ(ecu.overflows, 0);
+    CHECK_EQ(ecu.timerLost, 0);
+}
+
+static void finishVerify(void) {
+    while (SECA_PollVerify() == SECA_VERIFY_PENDING) {
+    }
+}
+
+static void test_flash_waits_for_csec(void) {
+    static const uint8_t seed[SECA_SEED_LEN];
+    static const uint8_t key[SECA_KEY_LEN];
+    FAKEFLASH_Stats_t flash;
+
+    setup();
+    SECA_Init();
+    CHECK_EQ(FLASHDL_Begin(FLASHDL_START, 16), 0);
+
+    /* A key check is running: the erase waits for it */
+    CHECK_EQ(SECA_StartVerify(seed, key), 0);
+    CHECK_EQ(FLASHDL_EraseStep(FLASHDL_START + 16U), 1);
+    FAKEFLASH_GetStats(&flash);
+    CHECK_EQ(flash.eraseUs, 0);
+    finishVerify();
+    CHECK_EQ(FLASHDL_EraseStep(FLASHDL_START + 16U), 0);
+
+    /* And so does programming */
+    CHECK_EQ(FLASHDL_Push(image, 16), 0);
+    CHECK_EQ(SECA_StartVerify(seed, key), 0);
+    FLASHDL_Poll();
+    CHECK(FLASHDL_Busy());
+    CHECK(!FLASHDL_Failed());
+    finishVerify();
+    FLASHDL_Poll();
+    CHECK(!FLASHDL_Busy());
+    CHECK(!FLASHDL_Failed());
+    CHECK(memcmp(FAKEFLASH_Ptr(FLASHDL_START), image, 16) == 0);
+    FLASHDL_End();
+}
+
+int main(void) {
+    TEST_RUN(test_download_overlaps_bus_and_flash);
+    TEST_RUN(test_flash_waits_for_csec);
+    return TEST_Done("test_flashdl_sim");
+}
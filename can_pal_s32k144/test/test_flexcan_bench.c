@@ -0,0 +1,142 @@
+/*
+ * @brief  Cycles-per-frame benchmark of the FlexCAN mailbox copies.
+ *
+ * Built with CAN_CYCLE_STATS=1, so the driver times its own mailbox reads
+ * and writes with FLEXCAN_CYCLE_COUNT() (the TSC here, DWT CYCCNT on the
+ * target, read back with FLEXCAN_get_cycle_stats() from a debugger or a DID).
+ * The shift/mask byte copy the driver used before REV word copies runs over
+ * the same mailbox RAM as a reference. Host numbers only rank the two; the
+ * target figures come from the same counters under DWT.
+ */
+
+#include "test.h"
+#include "fake_can_regs.h"
+#include "FlexCan.h"
+#include <stdio.h>
+#include <string.h>
+
+#define BENCH_FRAMES    200000U
+
+void CAN0_ORed_0_15_MB_IRQHandler(void);
+
+static void makeFrame(CAN_Message_t *msg, uint32_t seq, uint8_t dlc) {
+    memset(msg, 0, sizeof(*msg));
+    msg->canID = RX_MSG_ID;
+    msg->dlc = dlc;
+    for (uint8_t i = 0; i < dlc; i++) {
+        msg->data[i] = (uint8_t)(seq + i);
+    }
+}
+
+/* The per-byte mailbox read FlexCan.c did before the word copy */
+__attribute__((noinline))
+static void byteCopyRx(const volatile uint32_t *ram, CAN_Message_t *msg) {
+    uint32_t dataWord0 = ram[2];
+    uint32_t dataWord1 = ram[3];
+
+    msg->canID = (ram[1] >> 18) & 0x7FF;
+    msg->dlc = (ram[0] >> 16) & 0xF;
+    msg->data[0] = (dataWord0 >> 24) & 0xFF;
+    msg->data[1] = (dataWord0 >> 16) & 0xFF;
+    msg->data[2] = (dataWord0 >> 8)  & 0xFF;
+    msg->data[3] = (dataWord0 >> 0)  & 0xFF;
+    msg->data[4] = (dataWord1 >> 24) & 0xFF;
+    msg->data[5] = (dataWord1 >> 16) & 0xFF;
+    msg->data[6] = (dataWord1 >> 8)  & 0xFF;
+    msg->data[7] = (dataWord1 >> 0)  & 0xFF;
+}
+
+static void report(const char *what, uint32_t frames, uint32_t cycles, uint32_t maxCycles) {
+    printf("    %-28s %7u frames %8.1f cycles/frame (max %u)\n", what, frames,
+           frames ? (double)cycles / frames : 0.0, maxCycles);
+}
+
+static void benchRx(uint8_t dlc) {
+    CAN_CycleStats_t stats;
+    CAN_Message_t msg;
+    CAN_Message_t got;
+    uint32_t refCycles = 0;
+    uint32_t refMax = 0;
+    uint32_t bad = 0;
+    char label[32];
+
+    FAKECAN_Reset(CAN0);
+    FLEXCAN_init(CAN0_INST);
+    for (uint32_t seq = 0; seq < BENCH_FRAMES; seq++) {
+        makeFrame(&msg, seq, dlc);
+        CHECK_EQ(FAKECAN_Deliver(CAN0, &msg, 0), 0);
+
+        uint32_t start = FAKECAN_CycleCount();
+        byteCopyRx(&CAN0->RAMn[0], &got);
+        uint32_t cycles = FAKECAN_CycleCount() - start;
+        refCycles += cycles;
+        refMax = cycles > refMax ? cycles : refMax;
+
+        CAN0_ORed_0_15_MB_IRQHandler();
+        if (FLEXCAN_receive_msg(CAN0_INST, &got) != 1 || got.dlc != dlc ||
+            memcmp(got.data, msg.data, dlc) != 0) {
+            bad++;
+        }
+    }
+    FLEXCAN_get_cycle_stats(CAN0_INST, &stats);
+    CHECK_EQ(bad, 0);
+    CHECK_EQ(stats.rxFrames, BENCH_FRAMES);
+
+    snprintf(label, sizeof(label), "RX word copy, %u bytes", dlc);
+    report(label, stats.rxFrames, stats.rxCycles, stats.rxMaxCycles);
+    snprintf(label, sizeof(label), "RX byte copy (ref), %u bytes", dlc);
+    report(label, BENCH_FRAMES, refCycles, refMax);
+}
+
+static void benchTx(uint8_t dlc) {
+    CAN_CycleStats_t stats;
+    CAN_Message_t msg;
+    CAN_Message_t sent;
+    uint32_t bad = 0;
+    char label[32];
+
+    FAKECAN_Reset(CAN0);
+    FLEXCAN_init(CAN0_INST);
+    for (uint32_t seq = 0; seq < BENCH_FRAMES; seq++) {
+        makeFrame(&msg, seq, dlc);
+        msg.canID = TX_MSG_ID;
+        CHECK_EQ(FLEXCAN_transmit_async(CAN0_INST, &msg, TX_PRIO_DEFAULT, NULL, NULL), 0);
+        if (FAKECAN_CompleteTx(CAN0, RX_FIFO_TX_MB_INDEX, 0, &sent) != 0 ||
+            sent.dlc != dlc || memcmp(sent.data, msg.data, dlc) != 0) {
+            bad++;
+        }
+        CAN0_ORed_0_15_MB_IRQHandler();
+    }
+    FLEXCAN_get_cycle_stats(CAN0_INST, &stats);
+    CHECK_EQ(bad, 0);
+    CHECK_EQ(stats.txFrames, BENCH_FRAMES);
+
+    snprintf(label, sizeof(label), "TX word copy, %u bytes", dlc);
+    report(label, stats.txFrames, stats.txCycles, stats.txMaxCycles);
+}
+
+static void test_rx_cycles_per_frame(void) {
+    benchRx(8);
+    benchRx(3);
+}
+
+static void test_tx_cycles_per_frame(void) {
+    benchTx(8);
+    benchTx(3);
+}
+
+/* Reading the counters clears them */
+static void test_cycle_stats_reset_on_read(void) {
+    CAN_CycleStats_t stats;
+
+    FLEXCAN_get_cycle_stats(CAN0_INST, &stats);
+    CHECK_EQ(stats.rxFrames + stats.txFrames, 0);
+    CHECK_EQ(stats.rxCycles + stats.txCycles, 0);
+}
+
+int main(void) {
+    TEST_RUN(test_rx_cycles_per_frame);
+    TEST_RUN(test_tx_cycles_per_frame);
+    TEST_RUN(test_cycle_stats_reset_on_read);
+    return TEST_Done("test_flexcan_bench");
+}
@@ -0,0 +1,224 @@
+/*
+ * @brief  Simulated dual-bus host test of the per-instance FlexCAN driver.
+ *
+ * Built with CAN1_ENABLE=1: CAN0 runs the 500 kbit/s powertrain bus with the
+ * default UDS filters, CAN1 a 250 kbit/s body bus with its own filter set.
+ * Both buses are fully loaded at the same time, frames arriving in their own
+ * bit-time rhythm, while the main loop drains both rings and sends on both.
+ * Nothing may cross from one instance into the other: configuration, RX
+ * rings, TX mailboxes and completion callbacks.
+ */
+
+#include "test.h"
+#include "fake_can_regs.h"
+#include "FlexCan.h"
+#include <string.h>
+
+#define FRAME_BITS      111U    // 8-byte standard frame plus interframe space
+#define PT_BITRATE      500000UL
+#define BODY_BITRATE    250000UL
+#define SIM_US          200000U // 200 ms of bus time
+#define BODY_ID         0x320U
+#define BODY_TX_ID      0x321U
+
+void CAN0_ORed_0_15_MB_IRQHandler(void);
+void CAN1_ORed_0_15_MB_IRQHandler(void);
+
+typedef struct {
+    uint32_t sent;
+    uint32_t received;
+    uint32_t foreign;       // Frames carrying the other bus's marker
+    uint32_t outOfOrder;
+    uint32_t nextSeq;
+    uint32_t txDone;
+    uint32_t txWrongBus;
+} BusLog_t;
+
+static BusLog_t ptLog;
+static BusLog_t bodyLog;
+
+static void makeFrame(CAN_Message_t *msg, uint32_t id, uint8_t bus, uint32_t seq) {
+    memset(msg, 0, sizeof(*msg));
+    msg->canID = id;
+    msg->dlc = 8;
+    msg->data[0] = bus;
+    msg->data[1] = (uint8_t)(seq >> 16);
+    msg->data[2] = (uint8_t)(seq >> 8);
+    msg->data[3] = (uint8_t)seq;
+}
+
+static uint32_t frameSeq(const CAN_Message_t *msg) {
+    return ((uint32_t)msg->data[1] << 16) | ((uint32_t)msg->data[2] << 8) | msg->data[3];
+}
+
+static void drain(CAN_Instance_t *can, uint8_t bus, BusLog_t *log) {
+    CAN_Message_t msgs[RX_BATCH_MAX];
+    uint32_t n = FLEXCAN_receive_batch(can, msgs, RX_BATCH_MAX);
+
+    for (uint32_t i = 0; i < n; i++) {
+        if (msgs[i].data[0] != bus) {
+            log->foreign++;
+            continue;
+        }
+        if (frameSeq(&msgs[i]) != log->nextSeq) {
+            log->outOfOrder++;
+        }
+        log->nextSeq = frameSeq(&msgs[i]) + 1;
+        log->received++;
+    }
+}
+
+static void onTxDone(const CAN_Message_t *msg, int status, void *context) {
+    BusLog_t *log = context;
+
+    log->txDone++;
+    if (msg->data[0] != (log == &ptLog ? 0 : 1)) {
+        log->txWrongBus++;
+    }
+}
+
+/* Sends whatever the bus has armed in its pool, as the controller would */
+static void completeArmed(CAN_Type *base, void (*isr)(void)) {
+    int any = 0;
+
+    for (uint32_t mb = RX_FIFO_TX_MB_INDEX; mb < RX_FIFO_TX_MB_INDEX + TX_MB_COUNT; mb++) {
+        if (FAKECAN_TxPending(base, mb)) {
+            FAKECAN_CompleteTx(base, mb, 0, NULL);
+            any = 1;
+        }
+    }
+    if (any) {
+        isr();
+    }
+}
+
+static void setupBuses(void) {
+    static const CAN_RxFilter_t bodyFilters[] = {
+        { BODY_ID, 0x7F0, 0 },
+    };
+
+    FAKECAN_Reset(CAN0);
+    FAKECAN_Reset(CAN1);
+    FLEXCAN_init(CAN0_INST);
+    FLEXCAN_init(CAN1_INST);
+    CHECK_EQ(FLEXCAN_set_bitrate(CAN1_INST, BODY_BITRATE, CAN_NOMINAL_SAMPLE_POINT), 0);
+    CHECK_EQ(FLEXCAN_set_rx_filters(CAN1_INST, bodyFilters, 1), 0);
+    memset(&ptLog, 0, sizeof(ptLog));
+    memset(&bodyLog, 0, sizeof(bodyLog));
+}
+
+/* Reconfiguring CAN1 leaves CAN0's timing and filter table untouched */
+static void test_configuration_is_per_instance(void) {
+    uint32_t ctrl1;
+    uint32_t cbt;
+    uint32_t table[4 * 4];
+
+    FAKECAN_Reset(CAN0);
+    FAKECAN_Reset(CAN1);
+    FLEXCAN_init(CAN0_INST);
+    ctrl1 = CAN0->CTRL1;
+    cbt = CAN0->CBT;
+    memcpy(table, (const void *)&CAN0->RAMn[4 * 6], sizeof(table));
+
+    setupBuses();
+    CHECK_EQ(CAN0->CTRL1, ctrl1);
+    CHECK_EQ(CAN0->CBT, cbt);
+    CHECK(memcmp(table, (const void *)&CAN0->RAMn[4 * 6], sizeof(table)) == 0);
+    CHECK(CAN1->CTRL1 != ctrl1 || CAN1->CBT != cbt);
+    CHECK_EQ(FLEXCAN_ticks_to_us(CAN0_INST, 1000), 2000);
+    CHECK_EQ(FLEXCAN_ticks_to_us(CAN1_INST, 1000), 4000);
+}
+
+/*
+ * Both buses at 100 % load for SIM_US, one main-loop pass per millisecond
+ * that drains both rings and queues one response on each bus.
+ */
+static void test_full_load_on_both_buses(void) {
+    uint32_t ptFrameUs = FRAME_BITS * 1000000UL / PT_BITRATE;
+    uint32_t bodyFrameUs = FRAME_BITS * 1000000UL / BODY_BITRATE;
+    uint32_t ptTx = 0;
+    uint32_t bodyTx = 0;
+    CAN_RxStats_t ptStats;
+    CAN_RxStats_t bodyStats;
+    CAN_Message_t msg;
+
+    setupBuses();
+    for (uint32_t us = 1; us <= SIM_US; us++) {
+        if (us % ptFrameUs == 0) {
+            makeFrame(&msg, RX_MSG_ID, 0, ptLog.sent++);
+            FAKECAN_Deliver(CAN0, &msg, (uint16_t)us);
+            CAN0_ORed_0_15_MB_IRQHandler();
+        }
+        if (us % bodyFrameUs == 0) {
+            makeFrame(&msg, BODY_ID, 1, bodyLog.sent++);
+            FAKECAN_Deliver(CAN1, &msg, (uint16_t)us);
+            CAN1_ORed_0_15_MB_IRQHandler();
+        }
+        if (us % ptFrameUs == ptFrameUs / 2) {
+            completeArmed(CAN0, CAN0_ORed_0_15_MB_IRQHandler);
+        }
+        if (us % bodyFrameUs == bodyFrameUs / 2) {
+            completeArmed(CAN1, CAN1_ORed_0_15_MB_IRQHandler);
+        }
+        if (us % 1000U == 0) {
+            drain(CAN0_INST, 0, &ptLog);
+            drain(CAN1_INST, 1, &bodyLog);
+            makeFrame(&msg, TX_MSG_ID, 0, ptTx);
+            ptTx += FLEXCAN_transmit_async(CAN0_INST, &msg, TX_PRIO_DEFAULT, onTxDone, &ptLog) == 0;
+            makeFrame(&msg, BODY_TX_ID, 1, bodyTx);
+            bodyTx += FLEXCAN_transmit_async(CAN1_INST, &msg, TX_PRIO_DEFAULT, onTxDone, &bodyLog) == 0;
+        }
+    }
+    for (uint32_t i = 0; i < TX_QUEUE_SIZE + TX_MB_COUNT; i++) {
+        completeArmed(CAN0, CAN0_ORed_0_15_MB_IRQHandler);
+        completeArmed(CAN1, CAN1_ORed_0_15_MB_IRQHandler);
+    }
+    drain(CAN0_INST, 0, &ptLog);
+    drain(CAN1_INST, 1, &bodyLog);
+
+    FLEXCAN_get_rx_stats(CAN0_INST, &ptStats);
+    FLEXCAN_get_rx_stats(CAN1_INST, &bodyStats);
+    CHECK(ptLog.sent > 2 * bodyLog.sent - 2);
+    CHECK_EQ(ptLog.received, ptLog.sent);
+    CHECK_EQ(bodyLog.received, bodyLog.sent);
+    CHECK_EQ(ptLog.foreign + bodyLog.foreign, 0);
+    CHECK_EQ(ptLog.outOfOrder + bodyLog.outOfOrder, 0);
+    CHECK_EQ(ptStats.rxFrames, ptLog.sent);
+    CHECK_EQ(bodyStats.rxFrames, bodyLog.sent);
+    CHECK_EQ(ptStats.ringOverruns + bodyStats.ringOverruns, 0);
+    CHECK_EQ(ptStats.fifoOverflows + bodyStats.fifoOverflows, 0);
+
+    CHECK_EQ(ptLog.txDone, ptTx);
+    CHECK_EQ(bodyLog.txDone, bodyTx);
+    CHECK_EQ(ptLog.txWrongBus + bodyLog.txWrongBus, 0);
+    CHECK_EQ(ptTx, SIM_US / 1000U);
+}
+
+/* A frame queued on CAN1 only ever shows up in CAN1's mailboxes */
+static void test_tx_stays_on_its_bus(void) {
+    CAN_Message_t msg;
+    CAN_Message_t armed;
+
+    setupBuses();
+    makeFrame(&msg, BODY_TX_ID, 1, 7);
+    CHECK_EQ(FLEXCAN_transmit_async(CAN1_INST, &msg, TX_PRIO_DEFAULT, onTxDone, &bodyLog), 0);
+    for (uint32_t mb = 0; mb < 16; mb++) {
+        CHECK(!FAKECAN_TxPending(CAN0, mb));
+    }
+    CHECK_EQ(FAKECAN_PeekTx(CAN1, RX_FIFO_TX_MB_INDEX, &armed), 0);
+    CHECK_EQ(armed.canID, BODY_TX_ID);
+
+    /* CAN0's interrupt must not complete CAN1's frame */
+    CAN0_ORed_0_15_MB_IRQHandler();
+    CHECK_EQ(bodyLog.txDone, 0);
+    completeArmed(CAN1, CAN1_ORed_0_15_MB_IRQHandler);
+    CHECK_EQ(bodyLog.txDone, 1);
+    CHECK_EQ(ptLog.txDone, 0);
+}
+
+int main(void) {
+    TEST_RUN(test_configuration_is_per_instance);
+    TEST_RUN(test_full_load_on_both_buses);
+    TEST_RUN(test_tx_stays_on_its_bus);
+    return TEST_Done("test_flexcan_dual");
+}
@@ -0,0 +1,269 @@
+/*
+ * @brief  Host flood test of the interrupt-driven FlexCAN receive path.
+ *
+ * The bus, the Rx FIFO and the MB interrupt are simulated bit time by bit
+ * time at 500 kbit/s. Frames are the shortest 8-byte data frames (111 bit
+ * times with interframe space, no stuff bits), sent back to back: 100 % bus
+ * load, one frame every 222 us. Each payload carries a sequence number, so
+ * the main-loop side checks that nothing is lost, duplicated or reordered
+ * between the ISR and FLEXCAN_receive_batch().
+ */
+
+#include "test.h"
+#include "fake_can_regs.h"
+#include "FlexCan.h"
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+#define FRAME_BITS      111U    // SOF..EOF of an 8-byte standard frame plus 3 bits IFS
+#define BITS_PER_MS     500U
+
+void CAN0_ORed_0_15_MB_IRQHandler(void);
+
+typedef struct {
+    uint32_t frames;        // Frames sent back to back
+    uint32_t loopBits;      // Main-loop period
+    uint32_t stallEvery;    // Every n-th iteration also takes stallBits (0 = never)
+    uint32_t stallBits;
+    uint32_t isrMaskEvery;  // MB interrupt masked for isrMaskBits every isrMaskEvery bits
+    uint32_t isrMaskBits;
+} Scenario_t;
+
+typedef struct {
+    uint32_t sent;
+    uint32_t received;
+    uint32_t lostInFifo;    // Refused by the full hardware FIFO
+    uint32_t outOfOrder;
+    CAN_RxStats_t stats;
+} Outcome_t;
+
+static void makeFrame(CAN_Message_t *msg, uint32_t seq) {
+    memset(msg, 0, sizeof(*msg));
+    if (seq & 1U) {
+        msg->canID = 0x18DA00F1UL + (seq & 0xFFU);
+        msg->flags = CAN_MSG_EXT;
+    } else {
+        msg->canID = RX_MSG_ID;
+    }
+    msg->dlc = 8;
+    msg->data[0] = (uint8_t)(seq >> 24);
+    msg->data[1] = (uint8_t)(seq >> 16);
+    msg->data[2] = (uint8_t)(seq >> 8);
+    msg->data[3] = (uint8_t)seq;
+    msg->data[4] = 0xA5;
+    msg->data[7] = 0x5A;
+}
+
+static uint32_t frameSeq(const CAN_Message_t *msg) {
+    return ((uint32_t)msg->data[0] << 24) | ((uint32_t)msg->data[1] << 16) |
+           ((uint32_t)msg->data[2] << 8) | msg->data[3];
+}
+
+/* Checks one received frame against the sequence seen so far */
+static void consume(const CAN_Message_t *msg, uint32_t *expected, Outcome_t *out) {
+    uint32_t seq = frameSeq(msg);
+    CAN_Message_t ref;
+
+    makeFrame(&ref, seq);
+    if (seq < *expected || msg->canID != ref.canID || msg->flags != ref.flags ||
+        msg->dlc != 8 || memcmp(msg->data, ref.data, 8) != 0) {
+        out->outOfOrder++;
+    }
+    *expected = seq + 1;
+    out->received++;
+}
+
+static void setupCan0(void) {
+    FAKECAN_Reset(CAN0);
+    FLEXCAN_init(CAN0_INST);
+}
+
+static void runScenario(const Scenario_t *sc, Outcome_t *out) {
+    CAN_Message_t batch[RX_BATCH_MAX];
+    uint32_t expected = 0;
+    uint32_t nextLoop = 0;
+    uint32_t iteration = 0;
+    uint32_t t;
+
+    memset(out, 0, sizeof(*out));
+    setupCan0();
+
+    for (t = 0; out->sent < sc->frames || FLEXCAN_rx_pending(CAN0_INST) != 0 ||
+                FAKECAN_FifoLevel(CAN0) != 0; t++) {
+        bool isrMasked = sc->isrMaskEvery != 0 && (t % sc->isrMaskEvery) < sc->isrMaskBits;
+
+        FAKECAN_SetTimer(CAN0, (uint16_t)t);
+
+        /* End of frame: the FIFO stores it, or loses it when full */
+        if (out->sent < sc->frames && t % FRAME_BITS == FRAME_BITS - 1U) {
+            CAN_Message_t msg;
+
+            makeFrame(&msg, out->sent++);
+            if (FAKECAN_Deliver(CAN0, &msg, (uint16_t)t) != 0) {
+                out->lostInFifo++;
+            }
+        }
+
+        if (!isrMasked && (CAN0->IFLAG1 & CAN0->IMASK1) != 0) {
+            CAN0_ORed_0_15_MB_IRQHandler();
+        }
+
+        if (t >= nextLoop) {
+            uint32_t n = FLEXCAN_receive_batch(CAN0_INST, batch, RX_BATCH_MAX);
+
+            for (uint32_t i = 0; i < n; i++) {
+                consume(&batch[i], &expected, out);
+            }
+            iteration++;
+            nextLoop = t + sc->loopBits;
+            if (sc->stallEvery != 0 && iteration % sc->stallEvery == 0) {
+                nextLoop += sc->stallBits;
+            }
+        }
+    }
+    FLEXCAN_get_rx_stats(CAN0_INST, &out->stats);
+}
+
+/*
+ * 100 % load with a 1 ms main loop and a 5 ms stall every 50 iterations,
+ * e.g. an NVM erase: 6 ms without draining is 27 frames, inside the 32-frame
+ * ring. Nothing may be lost.
+ */
+static void test_full_load_no_loss(void) {
+    Scenario_t sc = { 20000, 1 * BITS_PER_MS, 50, 5 * BITS_PER_MS, 0, 0 };
+    Outcome_t out;
+
+    runScenario(&sc, &out);
+    CHECK_EQ(out.received, 20000);
+    CHECK_EQ(out.outOfOrder, 0);
+    CHECK_EQ(out.lostInFifo, 0);
+    CHECK_EQ(out.stats.rxFrames, 20000);
+    CHECK_EQ(out.stats.ringOverruns, 0);
+    CHECK_EQ(out.stats.fifoOverflows, 0);
+}
+
+/*
+ * The MB interrupt held off for 1 ms (another ISR, a critical section):
+ * 4.5 frames, absorbed by the 6-deep FIFO.
+ */
+static void test_isr_latency_absorbed_by_fifo(void) {
+    Scenario_t sc = { 20000, 1 * BITS_PER_MS, 0, 0, 10 * BITS_PER_MS, 1 * BITS_PER_MS };
+    Outcome_t out;
+
+    runScenario(&sc, &out);
+    CHECK_EQ(out.received, 20000);
+    CHECK_EQ(out.outOfOrder, 0);
+    CHECK_EQ(out.lostInFifo, 0);
+    CHECK_EQ(out.stats.ringOverruns, 0);
+    CHECK_EQ(out.stats.fifoOverflows, 0);
+}
+
+/*
+ * A main-loop stall longer than the ring covers drops frames in the ISR;
+ * every one of them must show up in ringOverruns, and the survivors must
+ * still arrive in order.
+ */
+static void test_ring_overrun_is_counted(void) {
+    Scenario_t sc = { 5000, 1 * BITS_PER_MS, 100, 20 * BITS_PER_MS, 0, 0 };
+    Outcome_t out;
+
+    runScenario(&sc, &out);
+    CHECK(out.stats.ringOverruns > 0);
+    CHECK_EQ(out.received + out.stats.ringOverruns, out.sent);
+    CHECK_EQ(out.stats.rxFrames, out.received);
+    CHECK_EQ(out.outOfOrder, 0);
+    CHECK_EQ(out.lostInFifo, 0);
+}
+
+/*
+ * The MB interrupt masked for 3 ms overflows the hardware FIFO: the loss is
+ * in hardware, reported through the FIFO overflow flag.
+ */
+static void test_fifo_overflow_is_reported(void) {
+    Scenario_t sc = { 5000, 1 * BITS_PER_MS, 0, 0, 20 * BITS_PER_MS, 3 * BITS_PER_MS };
+    Outcome_t out;
+
+    runScenario(&sc, &out);
+    CHECK(out.lostInFifo > 0);
+    CHECK(out.stats.fifoOverflows > 0);
+    CHECK(out.stats.fifoWarnings > 0);
+    CHECK_EQ(out.received + out.lostInFifo, out.sent);
+    CHECK_EQ(out.outOfOrder, 0);
+}
+
+// ===== SPSC ring under real concurrency =====
+#define THREADED_FRAMES  1000000UL
+
+static volatile int producerDone;
+
+/*
+ * Plays bus and MB interrupt: delivers a frame, then runs the ISR for it.
+ * Like a bus that is slower than the main loop, it backs off while the ring
+ * is nearly full, so every frame crosses the ring while both sides run.
+ */
+static void *producer(void *arg) {
+    uint32_t *sent = arg;
+    CAN_Message_t msg;
+
+    for (uint32_t seq = 0; seq < THREADED_FRAMES; seq++) {
+        while (FLEXCAN_rx_pending(CAN0_INST) >= RX_RING_SIZE - RX_BATCH_MAX) {
+            sched_yield();
+        }
+        makeFrame(&msg, seq);
+        (void)FAKECAN_Deliver(CAN0, &msg, (uint16_t)seq);
+        CAN0_ORed_0_15_MB_IRQHandler();
+        (*sent)++;
+    }
+    __atomic_store_n(&producerDone, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/*
+ * The ISR and the main loop on two threads with no locking at all: every
+ * frame must arrive intact and in order.
+ */
+static void test_threaded_spsc_ring(void) {
+    CAN_Message_t batch[RX_BATCH_MAX];
+    pthread_t thread;
+    uint32_t sent = 0;
+    uint32_t expected = 0;
+    Outcome_t out;
+
+    memset(&out, 0, sizeof(out));
+    setupCan0();
+    producerDone = 0;
+    pthread_create(&thread, NULL, producer, &sent);
+
+    for (;;) {
+        int done = __atomic_load_n(&producerDone, __ATOMIC_ACQUIRE);
+        uint32_t n = FLEXCAN_receive_batch(CAN0_INST, batch, RX_BATCH_MAX);
+
+        for (uint32_t i = 0; i < n; i++) {
+            consume(&batch[i], &expected, &out);
+        }
+        if (n == 0) {
+            if (done) {
+                break;
+            }
+            sched_yield();
+        }
+    }
+    pthread_join(thread, NULL);
+
+    FLEXCAN_get_rx_stats(CAN0_INST, &out.stats);
+    CHECK_EQ(sent, THREADED_FRAMES);
+    CHECK_EQ(out.received, THREADED_FRAMES);
+    CHECK_EQ(out.outOfOrder, 0);
+    CHECK_EQ(out.stats.rxFrames, THREADED_FRAMES);
+    CHECK_EQ(out.stats.ringOverruns, 0);
+}
+
+int main(void) {
+    TEST_RUN(test_full_load_no_loss);
+    TEST_RUN(test_isr_latency_absorbed_by_fifo);
+    TEST_RUN(test_ring_overrun_is_counted);
+    TEST_RUN(test_fifo_overflow_is_reported);
+    TEST_RUN(test_threaded_spsc_ring);
+    return TEST_Done("test_flexcan_rx");
+}
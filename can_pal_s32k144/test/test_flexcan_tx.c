@@ -0,0 +1,178 @@
+/*
+ * @brief  Host tests of the FlexCAN TX mailbox pool and software queue.
+ *
+ * Frames are queued with FLEXCAN_transmit_async(); the register model shows
+ * which pool mailboxes are armed, and "sends" them on request, after which
+ * the MB interrupt refills the pool from the queue.
+ */
+
+#include "test.h"
+#include "fake_can_regs.h"
+#include "FlexCan.h"
+#include <string.h>
+
+#define POOL_FIRST_MB   RX_FIFO_TX_MB_INDEX
+#define ISOTP_ID        0x768U
+#define PERIODIC_ID     0x668U
+#define EXT_ID          0x18DAF110UL
+
+void CAN0_ORed_0_15_MB_IRQHandler(void);
+
+static void setupCan0(void) {
+    FAKECAN_Reset(CAN0);
+    FLEXCAN_init(CAN0_INST);
+}
+
+static void queue(uint32_t id, uint8_t flags, uint8_t seq, uint8_t prio) {
+    CAN_Message_t msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.canID = id;
+    msg.flags = flags;
+    msg.dlc = 8;
+    msg.data[0] = seq;
+    CHECK_EQ(FLEXCAN_transmit_async(CAN0_INST, &msg, prio, NULL, NULL), 0);
+}
+
+/* Pool mailbox holding a frame with this ID, or -1 */
+static int findArmed(uint32_t id, uint8_t flags, CAN_Message_t *msg) {
+    for (uint32_t mb = POOL_FIRST_MB; mb < POOL_FIRST_MB + TX_MB_COUNT; mb++) {
+        if (FAKECAN_PeekTx(CAN0, mb, msg) == 0 && msg->canID == id &&
+            (msg->flags & CAN_MSG_EXT) == (flags & CAN_MSG_EXT)) {
+            return (int)mb;
+        }
+    }
+    return -1;
+}
+
+static uint32_t armedCount(void) {
+    uint32_t n = 0;
+
+    for (uint32_t mb = POOL_FIRST_MB; mb < POOL_FIRST_MB + TX_MB_COUNT; mb++) {
+        n += FAKECAN_TxPending(CAN0, mb) ? 1U : 0U;
+    }
+    return n;
+}
+
+/* Sends mailbox mb on the bus and runs the completion interrupt */
+static void send(int mb) {
+    CHECK_EQ(FAKECAN_CompleteTx(CAN0, (uint32_t)mb, 0, NULL), 0);
+    CAN0_ORed_0_15_MB_IRQHandler();
+}
+
+/*
+ * A segmented response queued ahead of other traffic: only one of its frames
+ * may be armed, and the periodic and extended frames behind it must get the
+ * free mailboxes right away instead of waiting for the whole stream.
+ */
+static void test_blocked_id_does_not_stall_queue(void) {
+    CAN_Message_t msg;
+
+    setupCan0();
+    for (uint8_t seq = 0; seq < 6; seq++) {
+        queue(ISOTP_ID, 0, seq, TX_PRIO_DEFAULT);
+    }
+    queue(PERIODIC_ID, 0, 0, 6);
+    queue(EXT_ID, CAN_MSG_EXT, 0, TX_PRIO_DEFAULT);
+
+    CHECK_EQ(armedCount(), 3);
+    CHECK(findArmed(ISOTP_ID, 0, &msg) >= 0);
+    CHECK_EQ(msg.data[0], 0);
+    CHECK(findArmed(PERIODIC_ID, 0, &msg) >= 0);
+    CHECK(findArmed(EXT_ID, CAN_MSG_EXT, &msg) >= 0);
+}
+
+/*
+ * Frames of one ID leave strictly in queue order, one at a time, while
+ * other IDs overtake them.
+ */
+static void test_per_id_order_is_kept(void) {
+    CAN_Message_t msg;
+    int mb;
+
+    setupCan0();
+    for (uint8_t seq = 0; seq < 6; seq++) {
+        queue(ISOTP_ID, 0, seq, TX_PRIO_DEFAULT);
+    }
+    queue(PERIODIC_ID, 0, 0, 6);
+    queue(PERIODIC_ID, 0, 1, 6);
+
+    for (uint8_t seq = 0; seq < 6; seq++) {
+        mb = findArmed(ISOTP_ID, 0, &msg);
+        CHECK(mb >= 0);
+        if (mb < 0) {
+            return;
+        }
+        CHECK_EQ(msg.data[0], seq);
+
+        /* Never two frames of the same ID armed together */
+        for (uint32_t other = POOL_FIRST_MB; other < POOL_FIRST_MB + TX_MB_COUNT; other++) {
+            CAN_Message_t o;
+            if ((int)other != mb && FAKECAN_PeekTx(CAN0, other, &o) == 0) {
+                CHECK(o.canID != ISOTP_ID);
+            }
+        }
+        if (seq == 0) {
+            mb = findArmed(PERIODIC_ID, 0, &msg);
+            CHECK(mb >= 0);
+            CHECK_EQ(msg.data[0], 0);
+            send(mb);
+            CHECK(findArmed(PERIODIC_ID, 0, &msg) >= 0);
+            CHECK_EQ(msg.data[0], 1);
+        }
+        send(findArmed(ISOTP_ID, 0, &msg));
+    }
+    CHECK_EQ(findArmed(ISOTP_ID, 0, &msg), -1);
+}
+
+/*
+ * With the pool full, a completion hands the freed mailbox to the first
+ * queued frame whose ID is not in flight, even if it is not the oldest.
+ */
+static void test_freed_mailbox_goes_to_unblocked_frame(void) {
+    CAN_Message_t msg;
+
+    setupCan0();
+    queue(0x100, 0, 0, TX_PRIO_DEFAULT);
+    queue(0x200, 0, 0, TX_PRIO_DEFAULT);
+    queue(0x300, 0, 0, TX_PRIO_DEFAULT);
+    queue(0x400, 0, 0, TX_PRIO_DEFAULT);
+    queue(0x100, 0, 1, TX_PRIO_DEFAULT);    /* Oldest waiting, but 0x100 is in flight */
+    queue(0x500, 0, 0, TX_PRIO_DEFAULT);
+    CHECK_EQ(armedCount(), TX_MB_COUNT);
+
+    send(findArmed(0x300, 0, &msg));
+    CHECK(findArmed(0x500, 0, &msg) >= 0);
+    CHECK_EQ(findArmed(0x100, 0, &msg) >= 0 ? msg.data[0] : 0xFF, 0);
+
+    send(findArmed(0x100, 0, &msg));
+    CHECK(findArmed(0x100, 0, &msg) >= 0);
+    CHECK_EQ(msg.data[0], 1);
+}
+
+/*
+ * An out-of-range standard ID must not spill into the IDE-adjacent bits or
+ * the local priority field of the mailbox ID word.
+ */
+static void test_std_id_is_masked(void) {
+    CAN_Message_t msg;
+    int mb;
+
+    setupCan0();
+    queue(0xFFFU, 0, 0, 4);
+    mb = findArmed(0x7FFU, 0, &msg);
+    CHECK(mb >= 0);
+    if (mb < 0) {
+        return;
+    }
+    CHECK_EQ(FAKECAN_TxPrio(CAN0, (uint32_t)mb), 4);
+    CHECK_EQ(msg.flags & CAN_MSG_EXT, 0);
+}
+
+int main(void) {
+    TEST_RUN(test_blocked_id_does_not_stall_queue);
+    TEST_RUN(test_per_id_order_is_kept);
+    TEST_RUN(test_freed_mailbox_goes_to_unblocked_frame);
+    TEST_RUN(test_std_id_is_masked);
+    return TEST_Done("test_flexcan_tx");
+}
@@ -0,0 +1,366 @@
+/*
+ * @brief  Host tests of ISO-TP request reassembly (isotp.c).
+ *
+ * The link runs on the real FlexCAN driver over the register model: Flow
+ * Control frames are read back from the TX mailboxes, time is the fake TIMER
+ * register (500 ticks per ms at 500 kbit/s), and RX ring occupancy, which
+ * sizes BS and STmin, is produced by delivering frames the main loop has not
+ * drained yet.
+ */
+
+#include "test.h"
+#include "fake_can_regs.h"
+#include "FlexCan.h"
+#include "isotp.h"
+#include <string.h>
+
+#define TICKS_PER_MS    500U
+#define RX_BUF_SIZE     256U
+
+void CAN0_ORed_0_15_MB_IRQHandler(void);
+
+static uint8_t rxBuf[RX_BUF_SIZE];
+static ISOTP_Link_t link;
+static uint16_t timerNow;
+
+static void setup(void) {
+    FAKECAN_Reset(CAN0);
+    FLEXCAN_init(CAN0_INST);
+    timerNow = 0;
+    FAKECAN_SetTimer(CAN0, 0);
+
+    memset(&link, 0, sizeof(link));
+    link.can = CAN0_INST;
+    link.txId = TX_MSG_ID;
+    link.rxId = RX_MSG_ID;
+    link.funcId = RX_FUNC_MSG_ID;
+    link.rxBuf = rxBuf;
+    link.rxBufSize = RX_BUF_SIZE;
+    memset(rxBuf, 0, sizeof(rxBuf));
+}
+
+/* Moves time on in steps the 16-bit timer extension can follow, ticking the link */
+static void advanceMs(uint32_t ms) {
+    while (ms != 0) {
+        uint32_t step = ms > 10U ? 10U : ms;
+
+        timerNow = (uint16_t)(timerNow + step * TICKS_PER_MS);
+        FAKECAN_SetTimer(CAN0, timerNow);
+        ISOTP_Tick(&link);
+        ms -= step;
+    }
+}
+
+/* Sends the oldest frame armed on TX_MSG_ID and returns it in *fc */
+static int takeFlowControl(CAN_Message_t *fc) {
+    for (uint32_t mb = RX_FIFO_TX_MB_INDEX; mb < RX_FIFO_TX_MB_INDEX + TX_MB_COUNT; mb++) {
+        if (FAKECAN_PeekTx(CAN0, mb, fc) == 0 && fc->canID == TX_MSG_ID) {
+            FAKECAN_CompleteTx(CAN0, mb, timerNow, NULL);
+            CAN0_ORed_0_15_MB_IRQHandler();
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static uint8_t patternByte(uint16_t i) {
+    return (uint8_t)(i * 7U + 3U);
+}
+
+static int offer(uint32_t id, const uint8_t *bytes, uint8_t dlc, const uint8_t **pdu, uint16_t *pduLen) {
+    CAN_Message_t msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.canID = id;
+    msg.dlc = dlc;
+    memcpy(msg.data, bytes, dlc);
+    return ISOTP_OnFrame(&link, &msg, pdu, pduLen);
+}
+
+static int offerFirstFrame(uint16_t len, const uint8_t **pdu, uint16_t *pduLen) {
+    uint8_t ff[8];
+
+    ff[0] = (uint8_t)((ISOTP_PCI_FF << 4) | (len >> 8));
+    ff[1] = (uint8_t)len;
+    for (uint16_t i = 0; i < 6; i++) {
+        ff[2 + i] = patternByte(i);
+    }
+    return offer(RX_MSG_ID, ff, 8, pdu, pduLen);
+}
+
+/* CF number n (1-based) of a len-byte request, sequence number sn */
+static int offerConsecutive(uint16_t len, uint16_t n, uint8_t sn, const uint8_t **pdu, uint16_t *pduLen) {
+    uint8_t cf[8];
+    uint16_t offset = (uint16_t)(6U + 7U * (n - 1U));
+    uint16_t count = (uint16_t)((uint16_t)(len - offset) > 7U ? 7U : (uint16_t)(len - offset));
+
+    cf[0] = (uint8_t)((ISOTP_PCI_CF << 4) | (sn & 0x0F));
+    for (uint16_t i = 0; i < count; i++) {
+        cf[1 + i] = patternByte((uint16_t)(offset + i));
+    }
+    return offer(RX_MSG_ID, cf, (uint8_t)(count + 1U), pdu, pduLen);
+}
+
+/* Leaves n frames in the driver's RX ring, as an unread burst would */
+static void occupyRing(uint32_t n) {
+    CAN_Message_t msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.canID = 0x123;
+    msg.dlc = 8;
+    for (uint32_t i = 0; i < n; i++) {
+        FAKECAN_Deliver(CAN0, &msg, timerNow);
+        CAN0_ORed_0_15_MB_IRQHandler();
+    }
+}
+
+/* A 20-byte request: FF, FC.CTS, two CFs, then one pointer into rxBuf */
+static void test_reassembles_segmented_request(void) {
+    const uint8_t *pdu = NULL;
+    uint16_t pduLen = 0;
+    CAN_Message_t fc;
+
+    setup();
+    CHECK_EQ(offerFirstFrame(20, &pdu, &pduLen), 0);
+    CHECK_EQ(link.rxState, ISOTP_RX_RECEIVING);
+    CHECK_EQ(takeFlowControl(&fc), 0);
+    CHECK_EQ(fc.dlc, 3);
+    CHECK_EQ(fc.data[0], (ISOTP_PCI_FC << 4) | ISOTP_FS_CTS);
+    CHECK_EQ(fc.data[1], 0);    /* Whole request fits: no further FC */
+    CHECK_EQ(fc.data[2], 0);
+
+    CHECK_EQ(offerConsecutive(20, 1, 1, &pdu, &pduLen), 0);
+    CHECK_EQ(offerConsecutive(20, 2, 2, &pdu, &pduLen), 1);
+    CHECK(pdu == rxBuf);
+    CHECK_EQ(pduLen, 20);
+    for (uint16_t i = 0; i < 20; i++) {
+        CHECK_EQ(rxBuf[i], patternByte(i));
+    }
+    CHECK_EQ(link.rxState, ISOTP_RX_IDLE);
+    CHECK_EQ(takeFlowControl(&fc), -1);
+}
+
+/*
+ * The block size is half the free ring slots, and STmin throttles the sender
+ * once the ring is over half full. A new FC follows every block, and the
+ * sequence number wraps from 15 to 0.
+ */
+static void test_flow_control_follows_ring_space(void) {
+    const uint8_t *pdu = NULL;
+    uint16_t pduLen = 0;
+    CAN_Message_t fc;
+    uint16_t len = 200;                     /* 28 CFs */
+    uint16_t cfCount = (uint16_t)((len - 6U + 6U) / 7U);
+    uint32_t fcCount = 1;
+    CAN_Message_t drained[RX_RING_SIZE];
+    uint8_t blockLeft;
+    int done = 0;
+
+    setup();
+    occupyRing(20);                         /* 12 free: BS 6, STmin 1 ms */
+    CHECK_EQ(offerFirstFrame(len, &pdu, &pduLen), 0);
+    CHECK_EQ(takeFlowControl(&fc), 0);
+    CHECK_EQ(fc.data[0], (ISOTP_PCI_FC << 4) | ISOTP_FS_CTS);
+    CHECK_EQ(fc.data[1], 6);
+    CHECK_EQ(fc.data[2], ISOTP_RX_STMIN_BUSY);
+
+    /* The main loop catches up: later blocks get half the whole ring */
+    CHECK_EQ(FLEXCAN_receive_batch(CAN0_INST, drained, RX_RING_SIZE), 20);
+
+    blockLeft = fc.data[1];
+    for (uint16_t n = 1; n <= cfCount && !done; n++) {
+        done = offerConsecutive(len, n, (uint8_t)n, &pdu, &pduLen);
+        if (!done && blockLeft != 0 && --blockLeft == 0) {
+            uint16_t cfLeft = (uint16_t)(cfCount - n);
+
+            CHECK_EQ(takeFlowControl(&fc), 0);
+            CHECK_EQ(fc.data[1], cfLeft > RX_RING_SIZE / 2U ? RX_RING_SIZE / 2U : 0U);
+            CHECK_EQ(fc.data[2], 0);
+            blockLeft = fc.data[1];
+            fcCount++;
+        } else {
+            CHECK_EQ(takeFlowControl(&fc), -1);
+        }
+    }
+    CHECK_EQ(done, 1);
+    CHECK_EQ(fcCount, 3);           /* After CF 6 (BS 16) and CF 22 (BS 0) */
+    CHECK_EQ(pduLen, len);
+    CHECK_EQ(memcmp(pdu, rxBuf, len), 0);
+    CHECK_EQ(rxBuf[len - 1U], patternByte((uint16_t)(len - 1U)));
+}
+
+/* A request longer than rxBuf is refused with FC.OVFLW and nothing is kept */
+static void test_oversized_request_gets_overflow(void) {
+    const uint8_t *pdu = NULL;
+    uint16_t pduLen = 0;
+    CAN_Message_t fc;
+
+    setup();
+    CHECK_EQ(offerFirstFrame(RX_BUF_SIZE + 1U, &pdu, &pduLen), 0);
+    CHECK_EQ(takeFlowControl(&fc), 0);
+    CHECK_EQ(fc.data[0], (ISOTP_PCI_FC << 4) | ISOTP_FS_OVFLW);
+    CHECK_EQ(link.rxState, ISOTP_RX_IDLE);
+    CHECK_EQ(offerConsecutive(RX_BUF_SIZE + 1U, 1, 1, &pdu, &pduLen), 0);
+    CHECK_EQ(rxBuf[0], 0);
+}
+
+/* A CF out of sequence aborts the reception; later CFs are ignored */
+static void test_wrong_sequence_number_aborts(void) {
+    const uint8_t *pdu = NULL;
+    uint16_t pduLen = 0;
+    CAN_Message_t fc;
+
+    setup();
+    CHECK_EQ(offerFirstFrame(20, &pdu, &pduLen), 0);
+    CHECK_EQ(takeFlowControl(&fc), 0);
+    CHECK_EQ(offerConsecutive(20, 1, 2, &pdu, &pduLen), 0);
+    CHECK_EQ(link.rxState, ISOTP_RX_IDLE);
+    CHECK_EQ(offerConsecutive(20, 1, 1, &pdu, &pduLen), 0);
+    CHECK_EQ(offerConsecutive(20, 2, 2, &pdu, &pduLen), 0);
+}
+
+/* N_Cr: reception is dropped once no CF has arrived for ISOTP_N_CR_MS */
+static void test_n_cr_timeout(void) {
+    const uint8_t *pdu = NULL;
+    uint16_t pduLen = 0;
+    CAN_Message_t fc;
+
+    setup();
+    CHECK_EQ(offerFirstFrame(30, &pdu, &pduLen), 0);
+    CHECK_EQ(takeFlowControl(&fc), 0);
+    advanceMs(ISOTP_N_CR_MS - 10U);
+    CHECK_EQ(offerConsecutive(30, 1, 1, &pdu, &pduLen), 0);
+    CHECK_EQ(link.rxState, ISOTP_RX_RECEIVING);     /* CF restarted N_Cr */
+
+    advanceMs(ISOTP_N_CR_MS - 10U);
+    CHECK_EQ(link.rxState, ISOTP_RX_RECEIVING);
+    advanceMs(10U);
+    CHECK_EQ(link.rxState, ISOTP_RX_IDLE);
+    CHECK_EQ(offerConsecutive(30, 2, 2, &pdu, &pduLen), 0);
+}
+
+/* Single Frames come back in place; a new SF ends a reassembly in progress */
+static void test_single_frame_in_place(void) {
+    static const uint8_t sf[] = { 0x02, 0x10, 0x03 };
+    const uint8_t *pdu = NULL;
+    uint16_t pduLen = 0;
+    CAN_Message_t msg;
+    CAN_Message_t fc;
+
+    setup();
+    CHECK_EQ(offerFirstFrame(20, &pdu, &pduLen), 0);
+    CHECK_EQ(takeFlowControl(&fc), 0);
+
+    memset(&msg, 0, sizeof(msg));
+    msg.canID = RX_MSG_ID;
+    msg.dlc = sizeof(sf);
+    memcpy(msg.data, sf, sizeof(sf));
+    CHECK_EQ(ISOTP_OnFrame(&link, &msg, &pdu, &pduLen), 1);
+    CHECK(pdu == &msg.data[1]);
+    CHECK_EQ(pduLen, 2);
+    CHECK_EQ(link.rxState, ISOTP_RX_IDLE);
+
+    /* SF_DL larger than the frame is ignored */
+    msg.dlc = 2;
+    CHECK_EQ(ISOTP_OnFrame(&link, &msg, &pdu, &pduLen), 0);
+}
+
+/*
+ * Functional requests are Single Frames only and never touch the physical
+ * reassembly running beside them.
+ */
+static void test_functional_frames_leave_reassembly_alone(void) {
+    static const uint8_t tp[] = { 0x02, 0x3E, 0x80 };
+    const uint8_t *pdu = NULL;
+    uint16_t pduLen = 0;
+    CAN_Message_t msg;
+    CAN_Message_t fc;
+    uint8_t ff[8] = { 0x10, 0x20, 0, 0, 0, 0, 0, 0 };
+
+    setup();
+    CHECK_EQ(offerFirstFrame(20, &pdu, &pduLen), 0);
+    CHECK_EQ(takeFlowControl(&fc), 0);
+    CHECK_EQ(offerConsecutive(20, 1, 1, &pdu, &pduLen), 0);
+
+    memset(&msg, 0, sizeof(msg));
+    msg.canID = RX_FUNC_MSG_ID;
+    msg.dlc = sizeof(tp);
+    memcpy(msg.data, tp, sizeof(tp));
+    CHECK_EQ(ISOTP_OnFunctionalFrame(&link, &msg, &pdu, &pduLen), 1);
+    CHECK(pdu == &msg.data[1]);
+    CHECK_EQ(pduLen, 2);
+
+    /* A functional FF is not accepted by either entry point */
+    memset(&msg, 0, sizeof(msg));
+    msg.canID = RX_FUNC_MSG_ID;
+    msg.dlc = 8;
+    memcpy(msg.data, ff, sizeof(ff));
+    CHECK_EQ(ISOTP_OnFunctionalFrame(&link, &msg, &pdu, &pduLen), 0);
+    CHECK_EQ(ISOTP_OnFrame(&link, &msg, &pdu, &pduLen), 0);
+    CHECK_EQ(takeFlowControl(&fc), -1);
+
+    CHECK_EQ(link.rxState, ISOTP_RX_RECEIVING);
+    CHECK_EQ(offerConsecutive(20, 2, 2, &pdu, &pduLen), 1);
+    CHECK_EQ(pduLen, 20);
+    CHECK_EQ(rxBuf[19], patternByte(19));
+}
+
+/* Sends every armed frame that is not ours, until the TX queue is empty */
+static void drainOtherTx(void) {
+    CAN_Message_t msg;
+    int sent;
+
+    do {
+        sent = 0;
+        for (uint32_t mb = RX_FIFO_TX_MB_INDEX; mb < RX_FIFO_TX_MB_INDEX + TX_MB_COUNT; mb++) {
+            if (FAKECAN_PeekTx(CAN0, mb, &msg) == 0 && msg.canID != TX_MSG_ID) {
+                FAKECAN_CompleteTx(CAN0, mb, timerNow, NULL);
+                CAN0_ORed_0_15_MB_IRQHandler();
+                sent = 1;
+            }
+        }
+    } while (sent);
+}
+
+/* An FC the full TX queue refused goes out from ISOTP_Tick() once there is room */
+static void test_flow_control_is_retried(void) {
+    const uint8_t *pdu = NULL;
+    uint16_t pduLen = 0;
+    CAN_Message_t msg;
+    CAN_Message_t fc;
+
+    setup();
+    memset(&msg, 0, sizeof(msg));
+    msg.canID = 0x321;
+    msg.dlc = 8;
+    while (FLEXCAN_transmit_msg(CAN0_INST, &msg) == 0) {
+    }
+
+    CHECK_EQ(offerFirstFrame(20, &pdu, &pduLen), 0);
+    CHECK_EQ(link.rxState, ISOTP_RX_RECEIVING);
+    advanceMs(1);
+    CHECK_EQ(takeFlowControl(&fc), -1);
+
+    drainOtherTx();
+    advanceMs(1);
+    CHECK_EQ(takeFlowControl(&fc), 0);
+    CHECK_EQ(fc.data[0], (ISOTP_PCI_FC << 4) | ISOTP_FS_CTS);
+    advanceMs(1);
+    CHECK_EQ(takeFlowControl(&fc), -1);      /* Sent once */
+
+    CHECK_EQ(offerConsecutive(20, 1, 1, &pdu, &pduLen), 0);
+    CHECK_EQ(offerConsecutive(20, 2, 2, &pdu, &pduLen), 1);
+    CHECK_EQ(pduLen, 20);
+}
+
+int main(void) {
+    TEST_RUN(test_reassembles_segmented_request);
+    TEST_RUN(test_flow_control_follows_ring_space);
+    TEST_RUN(test_oversized_request_gets_overflow);
+    TEST_RUN(test_wrong_sequence_number_aborts);
+    TEST_RUN(test_n_cr_timeout);
+    TEST_RUN(test_single_frame_in_place);
+    TEST_RUN(test_functional_frames_leave_reassembly_alone);
+    TEST_RUN(test_flow_control_is_retried);
+    return TEST_Done("test_isotp_rx");
+}
@@ -0,0 +1,171 @@
+/*
+ * @brief  Host tests of 0x23 ReadMemoryByAddress (memrd.c, uds.c).
+ *
+ * The eDMA model completes transfers when the test says so, so a staging
+ * window can stay in flight across main-loop passes: the server must keep
+ * running meanwhile and respond once the data is there, and an eDMA error
+ * must never be replaced by a CPU copy. A second server shares the one
+ * memory stream and must not take it over mid-response.
+ */
+
+#include "test.h"
+#include "uds_tester.h"
+#include "fake_drivers.h"
+#include "fake_nvm.h"
+#include "memrd.h"
+#include <string.h>
+
+#define DMA_PASSES   40U     // Passes a deferred transfer runs, longer than a window's 16 CFs
+#define STREAM_SIZE  512U    // Five staging windows
+
+static Tester_t tester;
+static Tester_t other;
+static int      otherResult;    // Length of other's answer to its 0x23, 0 = not sent yet
+static uint8_t  otherRsp[TESTER_RSP_MAX];
+static uint32_t dmaPasses;
+static uint32_t dmaFailAfter;   // Transfers completed normally before the rest fail
+
+/* Completes each deferred transfer DMA_PASSES passes after it started */
+static void runDma(Tester_t *t) {
+    FAKEDRV_DmaStats_t stats;
+
+    (void)t;
+    if (!FAKEDRV_DmaRunning() || ++dmaPasses < DMA_PASSES) {
+        return;
+    }
+    dmaPasses = 0;
+    FAKEDRV_GetDmaStats(&stats);
+    (void)FAKEDRV_CompleteDma(stats.completed < dmaFailAfter ? EDMA_CHN_NORMAL : EDMA_CHN_ERROR);
+}
+
+static void setup(FAKEDRV_DmaMode_t mode) {
+    FAKENVM_Reset();
+    FAKEDRV_SetDmaMode(mode);
+    MEMRD_Init();
+    TESTER_Init(&tester);
+    tester.srv.session = UDS_SESSION_EXTENDED;
+    tester.srv.securityLevel = SECURITY_LEVEL_ENGINE;
+    dmaPasses = 0;
+    dmaFailAfter = UINT32_MAX;
+}
+
+/* 0x23 with 4-byte address and size, from t */
+static int readMemoryFrom(Tester_t *t, uint32_t address, uint32_t size, uint8_t *rsp) {
+    uint8_t req[10] = { 0x23, 0x44 };
+
+    for (uint32_t i = 0; i < 4; i++) {
+        req[2 + i] = (uint8_t)(address >> (24 - 8 * i));
+        req[6 + i] = (uint8_t)(size >> (24 - 8 * i));
+    }
+    return TESTER_Exchange(t, req, sizeof(req), rsp, TESTER_RSP_MAX);
+}
+
+static int readMemory(uint32_t address, uint32_t size, uint8_t *rsp) {
+    return readMemoryFrom(&tester, address, size, rsp);
+}
+
+/* Halfway through the first server's response the other server reads too */
+static void readFromOther(Tester_t *t) {
+    static uint32_t frames;
+
+    if (otherResult == 0 && ++frames == STREAM_SIZE / 7U / 2U) {
+        frames = 0;
+        otherResult = readMemoryFrom(&other, 0x2000, STREAM_SIZE, otherRsp);
+    }
+    runDma(t);
+}
+
+static int isNrc(const uint8_t *rsp, int n, uint8_t nrc) {
+    return n == 3 && rsp[0] == 0x7F && rsp[1] == 0x23 && rsp[2] == nrc;
+}
+
+static void test_flash_config_field_is_not_readable(void) {
+    static uint8_t rsp[TESTER_RSP_MAX];
+
+    setup(FAKEDRV_DMA_INSTANT);
+    CHECK(isNrc(rsp, readMemory(0x3F8, 16, rsp), NRC_REQUEST_OUT_OF_RANGE));
+    CHECK(isNrc(rsp, readMemory(0x40C, 1, rsp), NRC_REQUEST_OUT_OF_RANGE));
+    CHECK_EQ(readMemory(0x3F0, 16, rsp), 17);
+    CHECK_EQ(readMemory(0x410, 16, rsp), 17);
+    CHECK_EQ(rsp[0], 0x63);
+}
+
+static void test_protected_range_is_not_readable(void) {
+    static uint8_t rsp[TESTER_RSP_MAX];
+
+    setup(FAKEDRV_DMA_INSTANT);
+    MEMRD_Protect((const void *)(uintptr_t)0x20001000UL, 16);
+    CHECK(isNrc(rsp, readMemory(0x20000FF0UL, 0x20, rsp), NRC_REQUEST_OUT_OF_RANGE));
+    CHECK(isNrc(rsp, readMemory(0x20001008UL, 0x20, rsp), NRC_REQUEST_OUT_OF_RANGE));
+    CHECK(isNrc(rsp, readMemory(0x20000F00UL, 0x400, rsp), NRC_REQUEST_OUT_OF_RANGE));
+    CHECK_EQ(readMemory(0x20000FF0UL, 0x10, rsp), 17);
+    CHECK_EQ(readMemory(0x20001010UL, 0x10, rsp), 17);
+}
+
+static void test_response_waits_for_the_dma(void) {
+    static uint8_t rsp[TESTER_RSP_MAX];
+    FAKEDRV_DmaStats_t stats;
+
+    setup(FAKEDRV_DMA_DEFERRED);
+    tester.onPass = runDma;
+    CHECK_EQ(readMemory(0x1000, STREAM_SIZE, rsp), 1 + STREAM_SIZE);
+    CHECK_EQ(rsp[0], 0x63);
+
+    /* Every window staged once, one at a time, none abandoned for a CPU copy */
+    FAKEDRV_GetDmaStats(&stats);
+    CHECK_EQ(stats.started, (STREAM_SIZE + MEMRD_STAGE_SIZE - 1U) / MEMRD_STAGE_SIZE);
+    CHECK_EQ(stats.completed, stats.started);
+    CHECK_EQ(stats.stopped, 0);
+    CHECK_EQ(stats.overlapped, 0);
+}
+
+static void test_dma_error_is_reported(void) {
+    static uint8_t rsp[TESTER_RSP_MAX];
+    static const uint8_t testerPresent[2] = { 0x3E, 0x00 };
+
+    setup(FAKEDRV_DMA_ERROR);
+    CHECK(isNrc(rsp, readMemory(0x1000, STREAM_SIZE, rsp), NRC_CONDITIONS_NOT_CORRECT));
+
+    /* Past the first window the response has begun: the transfer ends early */
+    setup(FAKEDRV_DMA_DEFERRED);
+    tester.onPass = runDma;
+    dmaFailAfter = 1;
+    CHECK_EQ(readMemory(0x1000, STREAM_SIZE, rsp), -1);
+    CHECK_EQ(TESTER_Exchange(&tester, testerPresent, sizeof(testerPresent), rsp, TESTER_RSP_MAX), 2);
+    CHECK_EQ(rsp[0], 0x7E);
+}
+
+static void test_stream_is_not_taken_over(void) {
+    static uint8_t rsp[TESTER_RSP_MAX];
+    FAKEDRV_DmaStats_t stats;
+
+    setup(FAKEDRV_DMA_DEFERRED);
+    TESTER_Init(&other);
+    other.srv.session = UDS_SESSION_EXTENDED;
+    other.srv.securityLevel = SECURITY_LEVEL_ENGINE;
+    other.onPass = runDma;
+    otherResult = 0;
+    tester.onPass = runDma;
+    tester.onResponseFrame = readFromOther;
+
+    CHECK_EQ(readMemory(0x1000, STREAM_SIZE, rsp), 1 + STREAM_SIZE);
+    CHECK(isNrc(otherRsp, otherResult, NRC_BUSY_REPEAT_REQUEST));
+    FAKEDRV_GetDmaStats(&stats);
+    CHECK_EQ(stats.stopped, 0);
+    CHECK_EQ(stats.started, (STREAM_SIZE + MEMRD_STAGE_SIZE - 1U) / MEMRD_STAGE_SIZE);
+
+    /* Released on the pass after the last frame */
+    tester.onResponseFrame = NULL;
+    TESTER_Pass(&tester);
+    CHECK_EQ(readMemoryFrom(&other, 0x2000, STREAM_SIZE, otherRsp), 1 + STREAM_SIZE);
+    CHECK_EQ(otherRsp[0], 0x63);
+}
+
+int main(void) {
+    TEST_RUN(test_flash_config_field_is_not_readable);
+    TEST_RUN(test_protected_range_is_not_readable);
+    TEST_RUN(test_response_waits_for_the_dma);
+    TEST_RUN(test_dma_error_is_reported);
+    TEST_RUN(test_stream_is_not_taken_over);
+    return TEST_Done("test_memrd");
+}
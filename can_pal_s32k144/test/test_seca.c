@@ -0,0 +1,254 @@
+/*
+ * @brief  Host tests of SecurityAccess (0x27) over seca.c.
+ *
+ * The CSEc model checks keys with a software AES-128 CMAC, which is first
+ * held against the RFC 4493 vectors. The tester then unlocks the server the
+ * way a real tester would: request a seed, CMAC it with the provisioned key,
+ * send the MAC back. NVM and the millisecond clock are the host models, so
+ * the attempt counter can be carried across SECA_Init() and the lockout
+ * delay can be run out. The CMAC check takes one main-loop pass, during
+ * which the tests change what the key was sent under.
+ */
+
+#include "test.h"
+#include "uds_tester.h"
+#include "fake_cmac.h"
+#include "fake_drivers.h"
+#include "fake_nvm.h"
+#include "fake_platform.h"
+#include "seca.h"
+#include "flashdl.h"
+#include <string.h>
+
+static const uint8_t rfcKey[16] = {
+    0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C,
+};
+
+static Tester_t tester;
+static uint8_t  sessionDuringCheck;   // Session forced while the key is checked, 0 = leave it
+static bool     seedDuringCheck;      // A new seed is requested while the key is checked
+
+static void setup(void) {
+    FAKENVM_Reset();
+    FAKEPLAT_SetMs(0);
+    FAKEDRV_SetMacKey(SECA_KEY_SLOT, rfcKey);
+    SECA_Init();
+    TESTER_Init(&tester);
+    sessionDuringCheck = 0;
+    seedDuringCheck = false;
+}
+
+/* Simulated power cycle: NVM is kept, RAM state is not */
+static void powerCycle(void) {
+    SECA_Init();
+    TESTER_Init(&tester);
+}
+
+static void enterExtended(void) {
+    static const uint8_t req[] = { 0x10, UDS_SESSION_EXTENDED };
+    uint8_t rsp[8];
+
+    CHECK_EQ(TESTER_Exchange(&tester, req, sizeof(req), rsp, sizeof(rsp)), 6);
+}
+
+/* requestSeed then sendKey; key is the CMAC of the seed under macKey.
+ * @return Response SID of the sendKey, or the NRC of whichever step failed. */
+static uint8_t unlock(const uint8_t macKey[16]) {
+    static const uint8_t seedReq[] = { 0x27, 0x01 };
+    uint8_t keyReq[2 + SECA_KEY_LEN] = { 0x27, 0x02 };
+    uint8_t rsp[32];
+    int n;
+
+    n = TESTER_Exchange(&tester, seedReq, sizeof(seedReq), rsp, sizeof(rsp));
+    if (n == 3) {
+        return rsp[2];
+    }
+    CHECK_EQ(n, 2 + SECA_SEED_LEN);
+    FAKECMAC_Aes128(macKey, &rsp[2], SECA_SEED_LEN, &keyReq[2]);
+
+    n = TESTER_Exchange(&tester, keyReq, sizeof(keyReq), rsp, sizeof(rsp));
+    return (n == 3) ? rsp[2] : rsp[0];
+}
+
+static void test_cmac_matches_rfc4493(void) {
+    static const uint8_t msg[64] = {
+        0x6B, 0xC1, 0xBE, 0xE2, 0x2E, 0x40, 0x9F, 0x96, 0xE9, 0x3D, 0x7E, 0x11, 0x73, 0x93, 0x17, 0x2A,
+        0xAE, 0x2D, 0x8A, 0x57, 0x1E, 0x03, 0xAC, 0x9C, 0x9E, 0xB7, 0x6F, 0xAC, 0x45, 0xAF, 0x8E, 0x51,
+        0x30, 0xC8, 0x1C, 0x46, 0xA3, 0x5C, 0xE4, 0x11, 0xE5, 0xFB, 0xC1, 0x19, 0x1A, 0x0A, 0x52, 0xEF,
+        0xF6, 0x9F, 0x24, 0x45, 0xDF, 0x4F, 0x9B, 0x17, 0xAD, 0x2B, 0x41, 0x7B, 0xE6, 0x6C, 0x37, 0x10,
+    };
+    static const struct {
+        uint32_t len;
+        uint8_t  mac[16];
+    } vectors[] = {
+        { 0,  { 0xBB, 0x1D, 0x69, 0x29, 0xE9, 0x59, 0x37, 0x28,
+                0x7F, 0xA3, 0x7D, 0x12, 0x9B, 0x75, 0x67, 0x46 } },
+        { 16, { 0x07, 0x0A, 0x16, 0xB4, 0x6B, 0x4D, 0x41, 0x44,
+                0xF7, 0x9B, 0xDD, 0x9D, 0xD0, 0x4A, 0x28, 0x7C } },
+        { 40, { 0xDF, 0xA6, 0x67, 0x47, 0xDE, 0x9A, 0xE6, 0x30,
+                0x30, 0xCA, 0x32, 0x61, 0x14, 0x97, 0xC8, 0x27 } },
+        { 64, { 0x51, 0xF0, 0xBE, 0xBF, 0x7E, 0x3B, 0x9D, 0x92,
+                0xFC, 0x49, 0x74, 0x17, 0x79, 0x36, 0x3C, 0xFE } },
+    };
+    uint8_t mac[16];
+
+    for (uint32_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+        FAKECMAC_Aes128(rfcKey, msg, vectors[i].len, mac);
+        CHECK(memcmp(mac, vectors[i].mac, sizeof(mac)) == 0);
+    }
+}
+
+static void test_valid_key_unlocks(void) {
+    setup();
+    enterExtended();
+    CHECK_EQ(unlock(rfcKey), 0x67);
+    CHECK_EQ(tester.srv.securityLevel, SECURITY_LEVEL_ENGINE);
+}
+
+static void test_invalid_key_is_rejected(void) {
+    static const uint8_t wrongKey[16] = { 0x01 };
+
+    setup();
+    enterExtended();
+    CHECK_EQ(unlock(wrongKey), NRC_INVALID_KEY);
+    CHECK_EQ(tester.srv.securityLevel, SECURITY_LEVEL_NONE);
+    /* The seed was used up by the failed sendKey */
+    CHECK_EQ(unlock(rfcKey), 0x67);
+}
+
+static void test_lockout_after_max_attempts(void) {
+    static const uint8_t wrongKey[16] = { 0x01 };
+
+    setup();
+    enterExtended();
+    CHECK_EQ(unlock(wrongKey), NRC_INVALID_KEY);
+    CHECK_EQ(unlock(wrongKey), NRC_INVALID_KEY);
+    CHECK_EQ(unlock(wrongKey), NRC_EXCEEDED_NUMBER_OF_ATTEMPTS);
+    CHECK_EQ(unlock(rfcKey), NRC_TIME_DELAY_NOT_EXPIRED);
+
+    FAKEPLAT_AdvanceMs(SECA_DELAY_MS - 1U);
+    CHECK_EQ(unlock(rfcKey), NRC_TIME_DELAY_NOT_EXPIRED);
+    FAKEPLAT_AdvanceMs(1U);
+    CHECK_EQ(unlock(rfcKey), 0x67);
+}
+
+static void test_attempts_survive_power_cycle(void) {
+    static const uint8_t wrongKey[16] = { 0x01 };
+
+    setup();
+    enterExtended();
+    CHECK_EQ(unlock(wrongKey), NRC_INVALID_KEY);
+    CHECK_EQ(unlock(wrongKey), NRC_INVALID_KEY);
+
+    powerCycle();
+    enterExtended();
+    CHECK_EQ(unlock(wrongKey), NRC_EXCEEDED_NUMBER_OF_ATTEMPTS);
+
+    /* Locked out at power-up too, until the delay has run again */
+    powerCycle();
+    enterExtended();
+    CHECK_EQ(unlock(rfcKey), NRC_TIME_DELAY_NOT_EXPIRED);
+    FAKEPLAT_AdvanceMs(SECA_DELAY_MS);
+    CHECK_EQ(unlock(rfcKey), 0x67);
+
+    /* Success clears the stored counter */
+    powerCycle();
+    enterExtended();
+    CHECK_EQ(unlock(rfcKey), 0x67);
+}
+
+/* Functional Single Frame, as a tester broadcasting to all ECUs sends it */
+static void sendFunctional(Tester_t *t, const uint8_t *req, uint8_t len) {
+    CAN_Message_t msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.canID = t->srv.link.funcId;
+    msg.dlc = (uint8_t)(len + 1U);
+    msg.data[0] = len;
+    memcpy(&msg.data[1], req, len);
+    UDS_OnFrame(&t->srv, &msg);
+}
+
+/* Runs once the sendKey job is waiting for CSEc */
+static void duringKeyCheck(Tester_t *t) {
+    static const uint8_t defaultSession[] = { 0x10, UDS_SESSION_DEFAULT };
+
+    if (t->srv.job == NULL) {
+        return;
+    }
+    t->onPass = NULL;
+    if (sessionDuringCheck != 0) {
+        t->srv.session = sessionDuringCheck;
+    } else if (seedDuringCheck) {
+        t->srv.secSeedLevel = SECURITY_LEVEL_ENGINE;
+    } else {
+        sendFunctional(t, defaultSession, sizeof(defaultSession));
+    }
+}
+
+static void test_functional_state_change_waits_for_the_key_check(void) {
+    static const uint8_t defaultSession[] = { 0x10, UDS_SESSION_DEFAULT };
+    CAN_Message_t msg;
+
+    setup();
+    enterExtended();
+    tester.onPass = duringKeyCheck;
+    CHECK_EQ(unlock(rfcKey), NRC_BUSY_REPEAT_REQUEST);
+    CHECK_EQ(tester.srv.session, UDS_SESSION_EXTENDED);
+
+    /* The sendKey answer follows the 0x21 to the functional 0x10 */
+    CHECK_EQ(FAKECANAPI_TakeTx(&tester.can, &msg), 0);
+    CHECK_EQ(msg.data[1], 0x67);
+    CHECK_EQ(tester.srv.securityLevel, SECURITY_LEVEL_ENGINE);
+
+    /* Idle again: the same request is served */
+    sendFunctional(&tester, defaultSession, sizeof(defaultSession));
+    CHECK_EQ(FAKECANAPI_TakeTx(&tester.can, &msg), 0);
+    CHECK_EQ(msg.data[1], 0x50);
+    CHECK_EQ(tester.srv.session, UDS_SESSION_DEFAULT);
+}
+
+static void test_key_is_void_after_session_change(void) {
+    setup();
+    enterExtended();
+    sessionDuringCheck = UDS_SESSION_DEFAULT;
+    tester.onPass = duringKeyCheck;
+    CHECK_EQ(unlock(rfcKey), NRC_CONDITIONS_NOT_CORRECT);
+    CHECK_EQ(tester.srv.securityLevel, SECURITY_LEVEL_NONE);
+}
+
+static void test_key_is_void_after_new_seed(void) {
+    setup();
+    enterExtended();
+    seedDuringCheck = true;
+    tester.onPass = duringKeyCheck;
+    CHECK_EQ(unlock(rfcKey), NRC_REQUEST_SEQUENCE_ERROR);
+    CHECK_EQ(tester.srv.securityLevel, SECURITY_LEVEL_NONE);
+}
+
+static void test_key_check_waits_for_download(void) {
+    static const uint8_t block[8] = { 0x5A };
+
+    setup();
+    enterExtended();
+    CHECK_EQ(FLASHDL_Begin(FLASHDL_START, sizeof(block)), 0);
+    CHECK_EQ(FLASHDL_Push(block, sizeof(block)), 0);
+    CHECK_EQ(unlock(rfcKey), NRC_CONDITIONS_NOT_CORRECT);
+    CHECK_EQ(tester.srv.securityLevel, SECURITY_LEVEL_NONE);
+
+    FLASHDL_End();
+    CHECK_EQ(unlock(rfcKey), 0x67);
+}
+
+int main(void) {
+    TEST_RUN(test_cmac_matches_rfc4493);
+    TEST_RUN(test_valid_key_unlocks);
+    TEST_RUN(test_invalid_key_is_rejected);
+    TEST_RUN(test_lockout_after_max_attempts);
+    TEST_RUN(test_attempts_survive_power_cycle);
+    TEST_RUN(test_functional_state_change_waits_for_the_key_check);
+    TEST_RUN(test_key_is_void_after_session_change);
+    TEST_RUN(test_key_is_void_after_new_seed);
+    TEST_RUN(test_key_check_waits_for_download);
+    return TEST_Done("test_seca");
+}
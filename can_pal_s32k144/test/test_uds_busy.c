@@ -0,0 +1,118 @@
+/*
+ * @brief  Host tests of a server that cannot answer right away (uds.c).
+ *
+ * A request that arrives while a response is still being segmented gets
+ * NRC 0x21 once the last frame is out, not silence. A response that finds
+ * the CAN TX queue full, which periodic frames share, is sent from
+ * UDS_Tick() as soon as there is room instead of being lost. Periodic
+ * frames that fell due during a main-loop stall do not take the queue over.
+ */
+
+#include "test.h"
+#include "uds_tester.h"
+#include "fake_nvm.h"
+#include "fake_drivers.h"
+#include <string.h>
+
+#define STREAMED_LEN  95     // 0x22 of 0xFD00, 0xF192, 0xFD00: segmented
+
+static const uint8_t readDids[] = { 0x22, 0xFD, 0x00, 0xF1, 0x92, 0xFD, 0x00 };
+
+static Tester_t tester;
+
+static void setup(void) {
+    FAKENVM_Reset();
+    TESTER_Init(&tester);
+}
+
+/* Physical Single Frame that reaches the server between two of its frames */
+static void interrupt(Tester_t *t) {
+    static const uint8_t testerPresent[] = { 0x02, 0x3E, 0x00 };
+    CAN_Message_t msg;
+
+    t->onResponseFrame = NULL;
+    memset(&msg, 0, sizeof(msg));
+    msg.canID = t->srv.link.rxId;
+    msg.dlc = sizeof(testerPresent);
+    memcpy(msg.data, testerPresent, sizeof(testerPresent));
+    UDS_OnFrame(&t->srv, &msg);
+}
+
+/* Other traffic takes every TX queue entry */
+static void fillTxQueue(Tester_t *t) {
+    CAN_Message_t msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.canID = t->srv.periodicId;
+    msg.dlc = 8;
+    while (FLEXCAN_transmit_msg(&t->can, &msg) == 0) {
+    }
+}
+
+static void test_request_while_busy_gets_busy_nrc(void) {
+    uint8_t rsp[TESTER_RSP_MAX];
+    CAN_Message_t msg;
+
+    setup();
+    tester.onResponseFrame = interrupt;
+    CHECK_EQ(TESTER_Exchange(&tester, readDids, sizeof(readDids), rsp, sizeof(rsp)), STREAMED_LEN);
+
+    /* The segmented response was not cut short; the 0x21 follows it */
+    TESTER_Pass(&tester);
+    CHECK_EQ(FAKECANAPI_TakeTx(&tester.can, &msg), 0);
+    CHECK_EQ(msg.data[0], 0x03);
+    CHECK_EQ(msg.data[1], 0x7F);
+    CHECK_EQ(msg.data[2], 0x3E);
+    CHECK_EQ(msg.data[3], NRC_BUSY_REPEAT_REQUEST);
+}
+
+static void test_response_waits_for_tx_room(void) {
+    static const uint8_t testerPresent[] = { 0x3E, 0x00 };
+    uint8_t rsp[TESTER_RSP_MAX];
+
+    setup();
+    fillTxQueue(&tester);
+    CHECK_EQ(TESTER_Exchange(&tester, testerPresent, sizeof(testerPresent), rsp, sizeof(rsp)), 2);
+    CHECK_EQ(rsp[0], 0x7E);
+    CHECK_EQ(tester.strayFrames, FAKECANAPI_TX_DEPTH);
+
+    tester.strayFrames = 0;
+    fillTxQueue(&tester);
+    CHECK_EQ(TESTER_Exchange(&tester, readDids, sizeof(readDids), rsp, sizeof(rsp)), STREAMED_LEN);
+    CHECK_EQ(rsp[0], 0x62);
+    CHECK_EQ(tester.strayFrames, FAKECANAPI_TX_DEPTH);
+}
+
+/* A 3 s stall with one fast and one slow periodic DID: each goes out once */
+static void test_stall_sends_each_periodic_did_once(void) {
+    static const uint8_t fast[] = { 0x2A, UDS_PERIODIC_FAST, (uint8_t)DID_PERIODIC_ENGINE };
+    static const uint8_t slow[] = { 0x2A, UDS_PERIODIC_SLOW, (uint8_t)DID_PERIODIC_CAN };
+    uint8_t rsp[TESTER_RSP_MAX];
+    CAN_Message_t msg;
+    uint32_t engine = 0;
+    uint32_t canState = 0;
+
+    setup();
+    CHECK_EQ(TESTER_Exchange(&tester, fast, sizeof(fast), rsp, sizeof(rsp)), 1);
+    CHECK_EQ(TESTER_Exchange(&tester, slow, sizeof(slow), rsp, sizeof(rsp)), 1);
+    UDS_Tick(&tester.srv);
+    while (FAKECANAPI_TakeTx(&tester.can, &msg) == 0) {
+    }
+
+    FAKEDRV_AdvancePeriodic(3000U / PERIODIC_TICK_MS);
+    UDS_Tick(&tester.srv);
+    while (FAKECANAPI_TakeTx(&tester.can, &msg) == 0) {
+        CHECK_EQ(msg.canID, tester.srv.periodicId);
+        engine += (msg.data[0] == (uint8_t)DID_PERIODIC_ENGINE) ? 1U : 0U;
+        canState += (msg.data[0] == (uint8_t)DID_PERIODIC_CAN) ? 1U : 0U;
+    }
+    CHECK_EQ(engine, 1);
+    CHECK_EQ(canState, 1);
+}
+
+int main(void) {
+    TEST_RUN(test_request_while_busy_gets_busy_nrc);
+    TEST_RUN(test_response_waits_for_tx_room);
+    TEST_RUN(test_stall_sends_each_periodic_did_once);
+    return TEST_Done("test_uds_busy");
+}
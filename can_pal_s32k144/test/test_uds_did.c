@@ -0,0 +1,156 @@
+/*
+ * @brief  Host tests of 0x22 ReadDataByIdentifier record sampling (uds.c).
+ *
+ * The CAN error counters behind DID 0xFD00 change after every response
+ * frame, as they would under bus errors while a long response is being
+ * segmented. Each record must still carry counters from a single moment.
+ * A second server shares the 0x2C definitions and must not change one
+ * while the first is still streaming it. Definitions are stored through the
+ * flash controller, so none changes while a download has data to program.
+ */
+
+#include "test.h"
+#include "uds_tester.h"
+#include "fake_nvm.h"
+#include "flashdl.h"
+#include <string.h>
+
+#define STATS_RECORD_LEN  43U
+#define STATS_U32_COUNT   10U
+
+static Tester_t tester;
+static Tester_t other;
+static uint8_t  changeNrc[3];   // Last byte of other's answers to the 0x2C requests
+
+/* Every counter moves to the same new value */
+static void bumpErrorStats(Tester_t *t) {
+    CAN_ErrorStats_t *s = &t->can.errStats;
+    uint32_t next = s->busOffCount + 1U;
+
+    s->tec = (uint8_t)next;
+    s->errorPassiveCount = next;
+    s->busOffCount = next;
+    s->busOffRecoveries = next;
+    s->stuffErrors = next;
+    s->formErrors = next;
+    s->crcErrors = next;
+    s->ackErrors = next;
+    s->bit0Errors = next;
+    s->bit1Errors = next;
+    s->txTimeouts = next;
+}
+
+static uint32_t getU32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/* true if all counters of the record at p (after the DID) are one sample */
+static int isConsistent(const uint8_t *p) {
+    uint32_t first = getU32(&p[3]);
+
+    if (p[1] != (uint8_t)first) {
+        return 0;
+    }
+    for (uint32_t i = 1; i < STATS_U32_COUNT; i++) {
+        if (getU32(&p[3 + 4 * i]) != first) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void setup(void) {
+    FAKENVM_Reset();
+    TESTER_Init(&tester);
+    tester.onResponseFrame = bumpErrorStats;
+}
+
+static void test_buffered_response_is_one_snapshot(void) {
+    static const uint8_t req[] = { 0x22, 0xFD, 0x00 };
+    uint8_t rsp[TESTER_RSP_MAX];
+
+    setup();
+    CHECK_EQ(TESTER_Exchange(&tester, req, sizeof(req), rsp, sizeof(rsp)), 3 + STATS_RECORD_LEN);
+    CHECK(isConsistent(&rsp[3]));
+}
+
+static void test_streamed_records_are_each_one_snapshot(void) {
+    static const uint8_t req[] = { 0x22, 0xFD, 0x00, 0xF1, 0x92, 0xFD, 0x00 };
+    uint8_t rsp[TESTER_RSP_MAX];
+    const uint8_t *second = &rsp[1 + 2 + STATS_RECORD_LEN + 4 + 2];
+
+    /* 93 bytes do not fit rspBuf: records are read while frames are built */
+    setup();
+    CHECK_EQ(TESTER_Exchange(&tester, req, sizeof(req), rsp, sizeof(rsp)),
+             1 + 2 * (2 + STATS_RECORD_LEN) + 4);
+    CHECK_EQ(rsp[1], 0xFD);
+    CHECK(isConsistent(&rsp[3]));
+    CHECK_EQ(second[-2], 0xFD);
+    CHECK(isConsistent(second));
+    /* The second record was sampled frames later than the first */
+    CHECK(getU32(&second[3]) > getU32(&rsp[6]));
+}
+
+/* On the first response frame, the other server tries to change 0xF300 */
+static void changeDddid(Tester_t *t) {
+    static const uint8_t clearOne[] = { 0x2C, 0x03, 0xF3, 0x00 };
+    static const uint8_t clearAll[] = { 0x2C, 0x03 };
+    static const uint8_t append[] = { 0x2C, 0x01, 0xF3, 0x00, 0xFD, 0x00, 0x01, 0x04 };
+    uint8_t rsp[TESTER_RSP_MAX];
+
+    t->onResponseFrame = NULL;
+    if (TESTER_Exchange(&other, clearOne, sizeof(clearOne), rsp, sizeof(rsp)) == 3) changeNrc[0] = rsp[2];
+    if (TESTER_Exchange(&other, clearAll, sizeof(clearAll), rsp, sizeof(rsp)) == 3) changeNrc[1] = rsp[2];
+    if (TESTER_Exchange(&other, append, sizeof(append), rsp, sizeof(rsp)) == 3) changeNrc[2] = rsp[2];
+}
+
+static void test_streamed_dddid_is_not_changed(void) {
+    static const uint8_t define[] = { 0x2C, 0x01, 0xF3, 0x00, 0xFD, 0x00, 0x01, STATS_RECORD_LEN };
+    static const uint8_t read[] = { 0x22, 0xF3, 0x00, 0xFD, 0x00 };
+    static const uint8_t clearOne[] = { 0x2C, 0x03, 0xF3, 0x00 };
+    uint8_t rsp[TESTER_RSP_MAX];
+
+    setup();
+    TESTER_Init(&other);
+    memset(changeNrc, 0, sizeof(changeNrc));
+    CHECK_EQ(TESTER_Exchange(&tester, define, sizeof(define), rsp, sizeof(rsp)), 4);
+    CHECK_EQ(rsp[0], 0x6C);
+
+    tester.onResponseFrame = changeDddid;
+    CHECK_EQ(TESTER_Exchange(&tester, read, sizeof(read), rsp, sizeof(rsp)),
+             1 + 2 * (2 + STATS_RECORD_LEN));
+    CHECK_EQ(changeNrc[0], NRC_CONDITIONS_NOT_CORRECT);
+    CHECK_EQ(changeNrc[1], NRC_CONDITIONS_NOT_CORRECT);
+    CHECK_EQ(changeNrc[2], NRC_CONDITIONS_NOT_CORRECT);
+    CHECK_EQ(rsp[1], 0xF3);
+    CHECK(isConsistent(&rsp[3]));
+
+    /* Released on the pass after the last frame */
+    TESTER_Pass(&tester);
+    CHECK_EQ(TESTER_Exchange(&other, clearOne, sizeof(clearOne), rsp, sizeof(rsp)), 4);
+    CHECK_EQ(rsp[0], 0x6C);
+}
+
+static void test_dddid_waits_for_download(void) {
+    static const uint8_t define[] = { 0x2C, 0x01, 0xF3, 0x00, 0xFD, 0x00, 0x01, 0x04 };
+    static const uint8_t block[8] = { 0x5A };
+    uint8_t rsp[TESTER_RSP_MAX];
+
+    setup();
+    CHECK_EQ(FLASHDL_Begin(FLASHDL_START, sizeof(block)), 0);
+    CHECK_EQ(FLASHDL_Push(block, sizeof(block)), 0);
+    CHECK_EQ(TESTER_Exchange(&tester, define, sizeof(define), rsp, sizeof(rsp)), 3);
+    CHECK_EQ(rsp[2], NRC_CONDITIONS_NOT_CORRECT);
+
+    FLASHDL_End();
+    CHECK_EQ(TESTER_Exchange(&tester, define, sizeof(define), rsp, sizeof(rsp)), 4);
+    CHECK_EQ(rsp[0], 0x6C);
+}
+
+int main(void) {
+    TEST_RUN(test_buffered_response_is_one_snapshot);
+    TEST_RUN(test_streamed_records_are_each_one_snapshot);
+    TEST_RUN(test_streamed_dddid_is_not_changed);
+    TEST_RUN(test_dddid_waits_for_download);
+    return TEST_Done("test_uds_did");
+}
@@ -0,0 +1,82 @@
+/*
+ * @brief  Host tests of 0x19 ReadDTCInformation lists (uds.c, dtcidx.c).
+ *
+ * DTC records are placed in the NVM model and indexed with DTCIDX_Load(),
+ * as at start-up; the lists are then read through the tester.
+ */
+
+#include "test.h"
+#include "uds_tester.h"
+#include "dtcidx.h"
+#include "fake_nvm.h"
+#include <string.h>
+
+#define STATUS_TEST_FAILED  0x01U
+#define STATUS_CONFIRMED    0x08U
+
+static Tester_t tester;
+
+static void setup(uint8_t status) {
+    uint8_t *slot = &FAKENVM_Bytes()[DTC_REGION_OFFSET];
+
+    FAKENVM_Reset();
+    slot[DTC_SLOT_DTC_OFS] = (uint8_t)(DTC_ENGINE_OVERHEAT >> 16);
+    slot[DTC_SLOT_DTC_OFS + 1] = (uint8_t)(DTC_ENGINE_OVERHEAT >> 8);
+    slot[DTC_SLOT_DTC_OFS + 2] = (uint8_t)DTC_ENGINE_OVERHEAT;
+    slot[DTC_SLOT_STATUS_OFS] = status;
+    DTCIDX_Load();
+    TESTER_Init(&tester);
+}
+
+static int request(const uint8_t *req, uint16_t len, uint8_t *rsp) {
+    return TESTER_Exchange(&tester, req, len, rsp, TESTER_RSP_MAX);
+}
+
+static void test_list_by_mask(void) {
+    static const uint8_t confirmed[] = { 0x19, 0x02, STATUS_CONFIRMED };
+    static const uint8_t pending[] = { 0x19, 0x02, 0x04 };
+    static const uint8_t expected[] = { 0x59, 0x02, 0xFF, 0x01, 0x23, 0x45,
+                                        STATUS_CONFIRMED | STATUS_TEST_FAILED };
+    uint8_t rsp[TESTER_RSP_MAX];
+
+    setup(STATUS_CONFIRMED | STATUS_TEST_FAILED);
+    CHECK_EQ(request(confirmed, sizeof(confirmed), rsp), sizeof(expected));
+    CHECK(memcmp(rsp, expected, sizeof(expected)) == 0);
+
+    /* No DTC matches: header only */
+    CHECK_EQ(request(pending, sizeof(pending), rsp), 3);
+    CHECK_EQ(rsp[0], 0x59);
+}
+
+static void test_count_and_list_agree(void) {
+    static const uint8_t count[] = { 0x19, 0x01, STATUS_CONFIRMED };
+    static const uint8_t list[] = { 0x19, 0x02, STATUS_CONFIRMED };
+    uint8_t rsp[TESTER_RSP_MAX];
+    uint16_t n;
+
+    setup(STATUS_CONFIRMED);
+    CHECK_EQ(request(count, sizeof(count), rsp), 6);
+    n = (uint16_t)((rsp[4] << 8) | rsp[5]);
+    CHECK_EQ(n, 1);
+    CHECK_EQ(request(list, sizeof(list), rsp), 3U + 4U * n);
+}
+
+static void test_supported_lists_stored_and_unstored(void) {
+    static const uint8_t req[] = { 0x19, 0x0A };
+    uint8_t rsp[TESTER_RSP_MAX];
+
+    /* Erased NVM: the DTC is supported but reported with status 0 */
+    FAKENVM_Reset();
+    DTCIDX_Load();
+    TESTER_Init(&tester);
+    CHECK_EQ(request(req, sizeof(req), rsp), 3 + 4 * DTCIDX_Count());
+    CHECK_EQ(rsp[3], 0x01);
+    CHECK_EQ(rsp[6], 0x00);
+}
+
+int main(void) {
+    TEST_RUN(test_list_by_mask);
+    TEST_RUN(test_count_and_list_agree);
+    TEST_RUN(test_supported_lists_stored_and_unstored);
+    return TEST_Done("test_uds_dtc");
+}
@@ -0,0 +1,133 @@
+/*
+ * @brief  Many UDS server instances driven concurrently from several threads.
+ *
+ * Every server has its own CAN instance (FlexCAN API model) with its own
+ * error counters, and every thread owns a group of servers. Each round a
+ * server gets a session change, a segmented 0x22 whose answer carries its
+ * own CAN counters, a session-gated 0x23 and a TesterPresent. Any state one
+ * server left in shared memory would show up as a wrong session, a
+ * foreign counter or a stray frame in another server's answers. The run
+ * also reports the request throughput.
+ */
+
+#include "test.h"
+#include "uds_tester.h"
+#include "fake_nvm.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define THREADS             4U
+#define SERVERS_PER_THREAD  16U
+#define ROUNDS              2000U
+#define SERVER_COUNT        (THREADS * SERVERS_PER_THREAD)
+
+typedef struct {
+    uint32_t first;         // Index of the thread's first server
+    uint32_t requests;
+    uint32_t failures;
+} Worker_t;
+
+static Tester_t testers[SERVER_COUNT];
+
+static uint32_t getU32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/* One round on server k; returns the number of wrong answers */
+static uint32_t runRound(Tester_t *t, uint32_t k, uint32_t round) {
+    static const uint8_t readDids[] = { 0x22, 0xF1, 0x90, 0xFD, 0x00, 0xF1, 0x91, 0xF1, 0x92 };
+    static const uint8_t readMem[] = { 0x23, 0x14, 0x20, 0x00, 0x00, 0x00, 0x04 };
+    static const uint8_t testerPresent[] = { 0x3E, 0x00 };
+    uint8_t session = ((k + round) & 1U) ? UDS_SESSION_EXTENDED : UDS_SESSION_DEFAULT;
+    uint8_t sessionReq[2] = { 0x10, session };
+    uint8_t rsp[TESTER_RSP_MAX];
+    uint32_t bad = 0;
+    int n;
+
+    n = TESTER_Exchange(t, sessionReq, sizeof(sessionReq), rsp, sizeof(rsp));
+    bad += (n != 6 || rsp[0] != 0x50 || rsp[1] != session);
+
+    /* 9-byte request (FF + CF), 57-byte response: FD00 carries this server's counters */
+    n = TESTER_Exchange(t, readDids, sizeof(readDids), rsp, sizeof(rsp));
+    bad += (n != 1 + 4 + 45 + 3 + 4);
+    if (n == 1 + 4 + 45 + 3 + 4) {
+        const uint8_t *fd00 = &rsp[1 + 4 + 2];
+
+        bad += (rsp[0] != 0x62 || rsp[5] != 0xFD || rsp[6] != 0x00);
+        bad += (fd00[1] != (uint8_t)k || fd00[2] != (uint8_t)(k ^ 0xFFU));
+        bad += (getU32(&fd00[7]) != k * 7U + round);    /* busOffCount */
+    }
+
+    /* Gated by session, then security: the answer shows this server's session */
+    n = TESTER_Exchange(t, readMem, sizeof(readMem), rsp, sizeof(rsp));
+    bad += (n != 3 || rsp[0] != 0x7F || rsp[1] != 0x23 ||
+            rsp[2] != (session == UDS_SESSION_EXTENDED ? NRC_SECURITY_ACCESS_DENIED
+                                                       : NRC_SERVICE_NOT_SUPPORTED_IN_SESSION));
+
+    n = TESTER_Exchange(t, testerPresent, sizeof(testerPresent), rsp, sizeof(rsp));
+    bad += (n != 2 || rsp[0] != 0x7E);
+
+    bad += (t->srv.session != session);
+    bad += (t->strayFrames != 0);
+    return bad;
+}
+
+static void *worker(void *arg) {
+    Worker_t *w = arg;
+
+    for (uint32_t round = 0; round < ROUNDS; round++) {
+        for (uint32_t i = 0; i < SERVERS_PER_THREAD; i++) {
+            uint32_t k = w->first + i;
+            Tester_t *t = &testers[k];
+
+            /* Counters only this server's CAN instance reports */
+            t->can.errStats.tec = (uint8_t)k;
+            t->can.errStats.rec = (uint8_t)(k ^ 0xFFU);
+            t->can.errStats.busOffCount = k * 7U + round;
+
+            w->failures += runRound(t, k, round);
+            w->requests += 4U;
+        }
+    }
+    return NULL;
+}
+
+static void test_servers_share_no_state(void) {
+    pthread_t threads[THREADS];
+    Worker_t workers[THREADS];
+    struct timespec start;
+    struct timespec end;
+    uint32_t requests = 0;
+    uint32_t failures = 0;
+    double seconds;
+
+    FAKENVM_Reset();
+    for (uint32_t k = 0; k < SERVER_COUNT; k++) {
+        TESTER_Init(&testers[k]);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t i = 0; i < THREADS; i++) {
+        workers[i] = (Worker_t){ .first = i * SERVERS_PER_THREAD };
+        CHECK_EQ(pthread_create(&threads[i], NULL, worker, &workers[i]), 0);
+    }
+    for (uint32_t i = 0; i < THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        requests += workers[i].requests;
+        failures += workers[i].failures;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+
+    CHECK_EQ(failures, 0);
+    CHECK_EQ(requests, SERVER_COUNT * ROUNDS * 4U);
+    printf("    %u servers on %u threads: %u requests in %.3f s, %.0f requests/s\n",
+           SERVER_COUNT, THREADS, requests, seconds, requests / seconds);
+}
+
+int main(void) {
+    TEST_RUN(test_servers_share_no_state);
+    return TEST_Done("test_uds_threads");
+}
@@ -0,0 +1,159 @@
+/*
+ * @brief  ISO-TP client side of the host UDS tests, see uds_tester.h.
+ *
+ * The tester sends unpadded frames, answers every First Frame with FC.CTS
+ * (BS 0, STmin 0) and waits out NRC 0x78. All traffic goes through the
+ * server's own CAN instance, so testers on different threads never touch
+ * the same data.
+ */
+
+#include "uds_tester.h"
+#include <string.h>
+
+void TESTER_Init(Tester_t *t) {
+    memset(t, 0, sizeof(*t));
+    FAKECANAPI_Init(&t->can);
+    t->srv = (UDS_Server_t)UDS_SERVER_INIT(&t->can, RX_MSG_ID, TX_MSG_ID_UDS, t->rxBuf);
+}
+
+/* One frame from the tester; the ECU main loop runs once while it is on the bus */
+static void deliver(Tester_t *t, const uint8_t *bytes, uint8_t dlc) {
+    CAN_Message_t msg;
+
+    TESTER_Pass(t);
+    memset(&msg, 0, sizeof(msg));
+    msg.canID = t->srv.link.rxId;
+    msg.dlc = dlc;
+    msg.timestamp = t->can.now;
+    memcpy(msg.data, bytes, dlc);
+    UDS_OnFrame(&t->srv, &msg);
+}
+
+/**
+ * @brief One main-loop pass of the ECU: CAN time moves on, then UDS_Tick().
+ */
+void TESTER_Pass(Tester_t *t) {
+    FAKECANAPI_Advance(&t->can, TESTER_TICK_BITS);
+    UDS_Tick(&t->srv);
+    if (t->onPass != NULL) {
+        t->onPass(t);
+    }
+}
+
+/* Next frame the server put on the bus, driving the main loop meanwhile */
+static int nextFrame(Tester_t *t, CAN_Message_t *msg) {
+    for (uint32_t pass = 0; pass < TESTER_MAX_PASSES; pass++) {
+        if (FAKECANAPI_TakeTx(&t->can, msg) == 0) {
+            if (msg->canID == t->srv.link.txId) {
+                if (t->onResponseFrame != NULL) {
+                    t->onResponseFrame(t);
+                }
+                return 0;
+            }
+            t->strayFrames++;
+            continue;
+        }
+        TESTER_Pass(t);
+    }
+    return -1;
+}
+
+static int sendRequest(Tester_t *t, const uint8_t *req, uint16_t len) {
+    uint8_t frame[8];
+    CAN_Message_t fc;
+    uint16_t offset;
+    uint8_t sn = 1;
+    uint8_t blockLeft;
+
+    if (len <= 7U) {
+        frame[0] = (uint8_t)len;
+        memcpy(&frame[1], req, len);
+        deliver(t, frame, (uint8_t)(len + 1U));
+        return 0;
+    }
+
+    frame[0] = (uint8_t)(0x10U | (len >> 8));
+    frame[1] = (uint8_t)len;
+    memcpy(&frame[2], req, 6);
+    deliver(t, frame, 8);
+    offset = 6;
+
+    while (offset < len) {
+        if (nextFrame(t, &fc) != 0 || (fc.data[0] & 0xF0U) != 0x30U) {
+            return -1;
+        }
+        if (fc.data[0] != 0x30U) {
+            return -1;                  /* WAIT or OVFLW: not expected here */
+        }
+        blockLeft = fc.data[1];
+        do {
+            uint16_t n = (uint16_t)((uint16_t)(len - offset) > 7U ? 7U : (uint16_t)(len - offset));
+
+            frame[0] = (uint8_t)(0x20U | sn);
+            memcpy(&frame[1], &req[offset], n);
+            deliver(t, frame, (uint8_t)(n + 1U));
+            offset = (uint16_t)(offset + n);
+            sn = (uint8_t)((sn + 1U) & 0x0FU);
+        } while (offset < len && (fc.data[1] == 0U || --blockLeft != 0U));
+    }
+    return 0;
+}
+
+/* Reassembles one response PDU; returns its length or -1 */
+static int receivePdu(Tester_t *t, uint8_t *rsp, uint16_t rspMax) {
+    static const uint8_t fcCts[3] = { 0x30, 0x00, 0x00 };
+    CAN_Message_t msg;
+    uint16_t len;
+    uint16_t offset;
+    uint8_t sn = 1;
+
+    if (nextFrame(t, &msg) != 0) {
+        return -1;
+    }
+    if ((msg.data[0] & 0xF0U) == 0x00U) {
+        len = msg.data[0] & 0x0FU;
+        if (len == 0U || len > rspMax || msg.dlc < len + 1U) {
+            return -1;
+        }
+        memcpy(rsp, &msg.data[1], len);
+        return len;
+    }
+    if ((msg.data[0] & 0xF0U) != 0x10U) {
+        return -1;
+    }
+    len = (uint16_t)(((msg.data[0] & 0x0FU) << 8) | msg.data[1]);
+    if (len > rspMax) {
+        return -1;
+    }
+    memcpy(rsp, &msg.data[2], 6);
+    offset = 6;
+    deliver(t, fcCts, sizeof(fcCts));
+
+    while (offset < len) {
+        uint16_t n = (uint16_t)((uint16_t)(len - offset) > 7U ? 7U : (uint16_t)(len - offset));
+
+        if (nextFrame(t, &msg) != 0 || msg.data[0] != (0x20U | sn) || msg.dlc < n + 1U) {
+            return -1;
+        }
+        memcpy(&rsp[offset], &msg.data[1], n);
+        offset = (uint16_t)(offset + n);
+        sn = (uint8_t)((sn + 1U) & 0x0FU);
+    }
+    return len;
+}
+
+/**
+ * @brief Sends req and returns the final response in rsp, skipping NRC 0x78.
+ * @return Response length, or -1 on a transport error or timeout.
+ */
+int TESTER_Exchange(Tester_t *t, const uint8_t *req, uint16_t len, uint8_t *rsp, uint16_t rspMax) {
+    int n;
+
+    if (sendRequest(t, req, len) != 0) {
+        return -1;
+    }
+    do {
+        n = receivePdu(t, rsp, rspMax);
+    } while (n == 3 && rsp[0] == 0x7F && rsp[2] == NRC_RESPONSE_PENDING);
+    return n;
+}
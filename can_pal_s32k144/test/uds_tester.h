@@ -0,0 +1,33 @@
+/*
+ * @brief  Diagnostic tester for host tests: one UDS server on its own
+ *         FlexCAN API model instance, and a client speaking ISO-TP to it.
+ */
+
+#ifndef UDS_TESTER_H_
+#define UDS_TESTER_H_
+
+#include <stdint.h>
+#include "fake_can_api.h"
+#include "uds.h"
+
+#define TESTER_TICK_BITS     50U     // CAN time per main-loop pass, 100 us at 500 kbit/s
+#define TESTER_MAX_PASSES    200000U // Main-loop passes before an exchange gives up
+#define TESTER_RSP_MAX       ISOTP_MAX_LEN
+
+typedef struct Tester Tester_t;
+
+struct Tester {
+    CAN_Instance_t can;
+    UDS_Server_t   srv;
+    uint8_t        rxBuf[ISOTP_MAX_LEN];
+    uint32_t       strayFrames;     // Frames on the bus that belong to no exchange
+    void         (*onResponseFrame)(Tester_t *t); // Optional, runs after each response frame
+    void         (*onPass)(Tester_t *t);          // Optional, runs after each main-loop pass
+};
+
+// ===== Function Prototypes =====
+void TESTER_Init(Tester_t *t);
+void TESTER_Pass(Tester_t *t);
+int  TESTER_Exchange(Tester_t *t, const uint8_t *req, uint16_t len, uint8_t *rsp, uint16_t rspMax);
+
+#endif /* UDS_TESTER_H_ */